@@ -0,0 +1,318 @@
+// Converts every .map file under a folder into a mesh, like gridmap2mesh, on
+// every core at once. The meshes go in the same place under another folder.
+// Biggest maps go first, so one big map doesn't end up running on its own at
+// the end.
+// Prints "map;vertices;polygons;seconds;peak heap MiB" to stderr as each map
+// is done (stdout has the Fade2D license on it).
+// With --check, each mesh is also checked against its map like meshcover
+// does, and isn't written if it doesn't cover exactly the traversable cells.
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <cerrno>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "triangulate.h"
+#include "merger.h"
+#include "coverage.h"
+#include "binmesh.h"
+#include "textmesh.h"
+#include "parallel.h"
+#include "stats.h"
+
+#define FORMAT_VERSION 2
+
+
+using namespace std;
+
+// Merge the triangles like meshmerger does (with its default options).
+bool merge_triangles = false;
+// Output the binary format (spec/mesh/3.txt) instead of text.
+bool binary = false;
+// Only convert maps which don't have a mesh yet.
+bool missing_only = false;
+// Check that each mesh covers its map, like meshcover.
+bool check_coverage = false;
+int threads = 0;
+
+struct MapFile
+{
+    // Relative to the map folder, without the .map.
+    string name;
+    long long size;
+};
+
+// Adds every .map file in folder/relative (and below it) to maps.
+void find_maps(const string& folder, const string& relative,
+               vector<MapFile>& maps)
+{
+    const string path = folder + "/" + relative;
+    DIR* dir = opendir(path.c_str());
+    if (dir == nullptr)
+    {
+        cerr << "Unable to open " << path << endl;
+        exit(1);
+    }
+    vector<string> names;
+    while (dirent* entry = readdir(dir))
+    {
+        const string name = entry->d_name;
+        if (name != "." && name != "..")
+        {
+            names.push_back(name);
+        }
+    }
+    closedir(dir);
+    sort(names.begin(), names.end());
+
+    for (const string& name : names)
+    {
+        const string file = relative.empty() ? name : relative + "/" + name;
+        struct stat info;
+        if (stat((folder + "/" + file).c_str(), &info) != 0)
+        {
+            continue;
+        }
+        if (S_ISDIR(info.st_mode))
+        {
+            find_maps(folder, file, maps);
+        }
+        else if (file.size() > 4 && file.compare(file.size() - 4, 4,
+                                                 ".map") == 0)
+        {
+            maps.push_back({file.substr(0, file.size() - 4), info.st_size});
+        }
+    }
+}
+
+// mkdir -p for the folder the file is in.
+void make_folders(const string& file)
+{
+    for (size_t i = file.find('/', 1); i != string::npos;
+         i = file.find('/', i + 1))
+    {
+        if (mkdir(file.substr(0, i).c_str(), 0777) != 0 && errno != EEXIST)
+        {
+            return;
+        }
+    }
+}
+
+// Fade2D doesn't say it can triangulate on more than one thread at once, so
+// only one map is triangulated at a time. Everything else runs in parallel.
+mutex fade_lock;
+
+bool convert(const string& map_file, const string& mesh_file,
+             meshutils::NavMesh& mesh, string& error)
+{
+    meshutils::GridMap map;
+    {
+        ifstream infile(map_file);
+        if (!infile.is_open())
+        {
+            error = "Unable to open " + map_file;
+            return false;
+        }
+        meshutils::PolyMap polymap;
+        {
+            meshutils::StatsPhase phase("read");
+            if (!meshutils::read_gridmap(infile, map, error))
+            {
+                return false;
+            }
+        }
+        {
+            meshutils::StatsPhase phase("trace");
+            meshutils::trace_polygons(map, polymap);
+        }
+        // Don't hold onto the map while waiting for Fade2D, unless it's
+        // needed for the check.
+        if (!check_coverage)
+        {
+            map = meshutils::GridMap();
+        }
+        lock_guard<mutex> guard(fade_lock);
+        meshutils::StatsPhase phase("triangulate");
+        if (!fadeutils::triangulate(polymap, mesh, error))
+        {
+            return false;
+        }
+    }
+    if (merge_triangles && !meshutils::merge_mesh(mesh,
+                                                  meshutils::MergeOptions(),
+                                                  mesh, nullptr, error))
+    {
+        return false;
+    }
+    if (check_coverage)
+    {
+        meshutils::StatsPhase phase("check");
+        meshutils::CoverageReport report;
+        // This thread is already one of many.
+        if (!meshutils::compare_coverage(map, mesh, 1, 1, report))
+        {
+            error = "Mesh doesn't cover the map (" +
+                    to_string(report.problems()) + " problems, starting " +
+                    "with " + report.messages[0] + ")";
+            return false;
+        }
+    }
+
+    make_folders(mesh_file);
+    meshutils::StatsPhase phase("write");
+    ofstream outfile(mesh_file, ios::binary);
+    if (!outfile.is_open())
+    {
+        error = "Unable to open " + mesh_file;
+        return false;
+    }
+    if (binary)
+    {
+        if (!meshutils::write_binary_mesh(mesh, outfile, error))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        // This thread is already one of many.
+        meshutils::write_text_mesh(mesh, FORMAT_VERSION, 1, outfile);
+    }
+    if (!outfile)
+    {
+        error = "Unable to write " + mesh_file;
+        return false;
+    }
+    return true;
+}
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--merge] [--binary] [--missing] [--check] "
+         << "[--threads=N] [--stats=json] [--chrome-trace=FILE] "
+         << "<map folder> <mesh folder>" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    vector<string> folders;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg == "--merge")
+        {
+            merge_triangles = true;
+        }
+        else if (arg == "--binary")
+        {
+            binary = true;
+        }
+        else if (arg == "--missing")
+        {
+            missing_only = true;
+        }
+        else if (arg == "--check")
+        {
+            check_coverage = true;
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (meshutils::parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (arg.compare(0, 2, "--") != 0 && folders.size() < 2)
+        {
+            folders.push_back(arg);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (folders.size() != 2)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const string& map_folder = folders[0];
+    const string& mesh_folder = folders[1];
+
+    vector<MapFile> maps;
+    find_maps(map_folder, "", maps);
+    if (missing_only)
+    {
+        vector<MapFile> missing;
+        for (const MapFile& map : maps)
+        {
+            struct stat info;
+            if (stat((mesh_folder + "/" + map.name + ".mesh").c_str(),
+                     &info) != 0)
+            {
+                missing.push_back(map);
+            }
+        }
+        maps.swap(missing);
+    }
+    // Biggest first.
+    stable_sort(maps.begin(), maps.end(),
+                [](const MapFile& a, const MapFile& b)
+    {
+        return a.size > b.size;
+    });
+    vector<int> jobs(maps.size());
+    for (int i = 0; i < (int) maps.size(); i++)
+    {
+        jobs[i] = i;
+    }
+
+    mutex print_lock;
+    int failures = 0;
+    cerr << "map;vertices;polygons;seconds;peak heap MiB" << endl;
+    // Always, for the peak heap of each map.
+    meshutils::count_heap();
+    const auto start = chrono::steady_clock::now();
+    meshutils::work_stealing_for(jobs, threads, [&](int i)
+    {
+        const auto map_start = chrono::steady_clock::now();
+        // So we can tell how much memory each map takes.
+        meshutils::ThreadHeap& heap = meshutils::thread_heap();
+        const long long heap_start = heap.bytes;
+        heap.peak = heap.bytes;
+        string error;
+        meshutils::NavMesh mesh;
+        const bool ok = convert(map_folder + "/" + maps[i].name + ".map",
+                                mesh_folder + "/" + maps[i].name + ".mesh",
+                                mesh, error);
+        const chrono::duration<double> seconds =
+            chrono::steady_clock::now() - map_start;
+        const double peak_mib = (heap.peak - heap_start) / 1048576.0;
+
+        lock_guard<mutex> guard(print_lock);
+        if (!ok)
+        {
+            cerr << maps[i].name << ": " << error << endl;
+            failures++;
+            return;
+        }
+        cerr << maps[i].name << ";" << mesh.num_vertices() << ";"
+             << mesh.num_polygons() << ";" << seconds.count() << ";"
+             << peak_mib << endl;
+    });
+    const chrono::duration<double> seconds =
+        chrono::steady_clock::now() - start;
+    cerr << "converted " << maps.size() - failures << " of " << maps.size()
+         << " maps in " << seconds.count() << " seconds" << endl;
+    string error;
+    if (!meshutils::write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
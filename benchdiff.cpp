@@ -0,0 +1,359 @@
+// Compares two meshbench (or Polyanya scenario runner) result files, such as
+// the results for two meshes of the same map, to find the queries whose
+// paths have different lengths, like find_discrep.py but much faster.
+// Takes the two files as arguments. Rows are matched up by their index
+// column. Each query whose length differs by more than --tolerance=X times
+// the length (default 1e-6) is printed as "index;length a;length b" to
+// stdout, and how the files compare overall is printed to stderr.
+// Exits with 1 if any query differs or is missing from the second file.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "binmesh.h"
+#include "parallel.h"
+#include "stats.h"
+#include "textmesh.h"
+using namespace std;
+using namespace meshutils;
+
+// How many rows each thread parses or compares at a time.
+const int CHUNK_SIZE = 16384;
+
+double tolerance = 1e-6;
+int threads = 0;
+
+// The columns used from each row. index and length have to be there (and
+// realcost is used as the length if there's no length, as find_discrep.py
+// does), and the rest are left as 0 if they aren't.
+enum Field { INDEX, MICRO, EXPANDED, LENGTH, REALCOST, NUM_FIELDS };
+const char* const FIELD_NAMES[NUM_FIELDS] = {
+    "index", "micro", "expanded", "length", "realcost"
+};
+
+struct Row
+{
+    double field[NUM_FIELDS];
+};
+
+// What each chunk of rows found, to be added up.
+struct Totals
+{
+    int matched;
+    int missing;
+    int mismatched_realcost;
+    vector<int> different;
+    // Only over queries both files found paths for.
+    double length_a, length_b;
+    double micro_a, micro_b;
+    double expanded_a, expanded_b;
+
+    Totals()
+        : matched(0), missing(0), mismatched_realcost(0), length_a(0),
+          length_b(0), micro_a(0), micro_b(0), expanded_a(0), expanded_b(0)
+    {
+    }
+};
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--tolerance=X] [--threads=N] "
+         << "[--stats=json] [--chrome-trace=FILE] <results a> <results b>"
+         << endl;
+}
+
+// Which field each column of the header is, or -1, up to the last one used.
+vector<int> find_columns(const char* line, const char* end)
+{
+    const char* newline = static_cast<const char*>(
+        memchr(line, '\n', end - line));
+    const string header(line, newline ? newline : end);
+    vector<int> columns;
+    size_t begin = 0;
+    while (begin <= header.size())
+    {
+        size_t stop = header.find(';', begin);
+        if (stop == string::npos)
+        {
+            stop = header.size();
+        }
+        string name = header.substr(begin, stop - begin);
+        name.erase(name.find_last_not_of(" \t\r") + 1);
+        columns.push_back(-1);
+        for (int f = 0; f < NUM_FIELDS; f++)
+        {
+            if (name == FIELD_NAMES[f])
+            {
+                columns.back() = f;
+            }
+        }
+        begin = stop + 1;
+    }
+    if (find(columns.begin(), columns.end(), LENGTH) == columns.end())
+    {
+        replace(columns.begin(), columns.end(), (int) REALCOST, (int) LENGTH);
+    }
+    while (!columns.empty() && columns.back() == -1)
+    {
+        columns.pop_back();
+    }
+    return columns;
+}
+
+// Parses the row starting at pos, returning false if a field it needs is
+// missing or isn't a number.
+bool parse_row(const char* pos, const char* end, const vector<int>& columns,
+               Row& row)
+{
+    row = Row();
+    for (size_t c = 0; c < columns.size(); c++)
+    {
+        if (c > 0)
+        {
+            while (pos < end && *pos != ';' && *pos != '\n')
+            {
+                pos++;
+            }
+            if (pos == end || *pos == '\n')
+            {
+                return false;
+            }
+            pos++;
+        }
+        if (columns[c] != -1)
+        {
+            char* after;
+            row.field[columns[c]] = strtod(pos, &after);
+            if (after == pos)
+            {
+                return false;
+            }
+        }
+    }
+    const double index = row.field[INDEX];
+    return index >= 0 && index == (int) index;
+}
+
+// Reads every row of a result file, in parallel.
+bool read_results(const string& filename, vector<Row>& rows,
+                  bool& has_realcost, string& error)
+{
+    void* data;
+    size_t size;
+    if (!map_file(filename, data, size, error))
+    {
+        error += " (" + filename + ")";
+        return false;
+    }
+    const char* begin = static_cast<const char*>(data);
+    const char* end = begin + size;
+    const vector<const char*> lines = find_lines(begin, end, threads);
+    const vector<int> columns = lines.empty()
+                                ? vector<int>()
+                                : find_columns(lines[0], end);
+    if (count(columns.begin(), columns.end(), INDEX) == 0 ||
+        count(columns.begin(), columns.end(), LENGTH) == 0)
+    {
+        munmap(data, size);
+        error = "No index or length column in " + filename;
+        return false;
+    }
+    has_realcost = count(columns.begin(), columns.end(), REALCOST) != 0;
+
+    const int n = lines.size() - 1;
+    rows.resize(n);
+    const int chunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    vector<int> bad(chunks, -1);
+    parallel_for(chunks, threads, [&](int chunk)
+    {
+        const int stop = min(n, (chunk + 1) * CHUNK_SIZE);
+        for (int i = chunk * CHUNK_SIZE; i < stop; i++)
+        {
+            if (!parse_row(lines[i+1], end, columns, rows[i]))
+            {
+                bad[chunk] = i;
+                return;
+            }
+        }
+    });
+    munmap(data, size);
+    for (int i : bad)
+    {
+        if (i != -1)
+        {
+            error = "Invalid row on line " + to_string(i + 2) + " of " +
+                    filename;
+            return false;
+        }
+    }
+    return true;
+}
+
+string format(const char* spec, double x)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), spec, x);
+    return buffer;
+}
+
+// b / a, or "-" if there's nothing to divide by (no query found a path in
+// both files).
+string format_ratio(double b, double a)
+{
+    return a > 0 ? format("%g", b / a) : "-";
+}
+
+bool same_length(double a, double b)
+{
+    return fabs(a - b) <= tolerance * max(1.0, max(fabs(a), fabs(b)));
+}
+
+int main(int argc, char* argv[])
+{
+    vector<string> filenames;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 12, "--tolerance=") == 0)
+        {
+            tolerance = atof(arg.c_str() + 12);
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (arg.compare(0, 2, "--") != 0 && filenames.size() < 2)
+        {
+            filenames.push_back(arg);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filenames.size() != 2 || !(tolerance >= 0))
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    string error;
+    vector<Row> a, b;
+    bool realcost_a, realcost_b;
+    {
+        StatsPhase phase("read");
+        if (!read_results(filenames[0], a, realcost_a, error) ||
+            !read_results(filenames[1], b, realcost_b, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+    }
+    // Where each index is in b.
+    int max_index = -1;
+    for (const Row& row : b)
+    {
+        max_index = max(max_index, (int) row.field[INDEX]);
+    }
+    vector<int> where(max_index + 1, -1);
+    for (int i = 0; i < (int) b.size(); i++)
+    {
+        where[(int) b[i].field[INDEX]] = i;
+    }
+
+    const int n = a.size();
+    const int chunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    vector<Totals> found(chunks);
+    parallel_for(chunks, threads, [&](int chunk)
+    {
+        StatsPhase phase("compare");
+        Totals& t = found[chunk];
+        const int stop = min(n, (chunk + 1) * CHUNK_SIZE);
+        for (int i = chunk * CHUNK_SIZE; i < stop; i++)
+        {
+            const double* x = a[i].field;
+            const int index = x[INDEX];
+            if (index > max_index || where[index] == -1)
+            {
+                t.missing++;
+                continue;
+            }
+            const double* y = b[where[index]].field;
+            t.matched++;
+            // Different scenarios would make every other number useless.
+            t.mismatched_realcost += realcost_a && realcost_b &&
+                                     !same_length(x[REALCOST], y[REALCOST]);
+            if (!same_length(x[LENGTH], y[LENGTH]))
+            {
+                t.different.push_back(i);
+            }
+            if (x[LENGTH] >= 0 && y[LENGTH] >= 0)
+            {
+                t.length_a += x[LENGTH];
+                t.length_b += y[LENGTH];
+                t.micro_a += x[MICRO];
+                t.micro_b += y[MICRO];
+                t.expanded_a += x[EXPANDED];
+                t.expanded_b += y[EXPANDED];
+            }
+        }
+    });
+
+    Totals total;
+    int different = 0;
+    cout << "index;length a;length b" << "\n";
+    for (const Totals& t : found)
+    {
+        total.matched += t.matched;
+        total.missing += t.missing;
+        total.mismatched_realcost += t.mismatched_realcost;
+        total.length_a += t.length_a;
+        total.length_b += t.length_b;
+        total.micro_a += t.micro_a;
+        total.micro_b += t.micro_b;
+        total.expanded_a += t.expanded_a;
+        total.expanded_b += t.expanded_b;
+        for (int i : t.different)
+        {
+            const double* x = a[i].field;
+            const double* y = b[where[(int) x[INDEX]]].field;
+            cout << (int) x[INDEX] << ";" << format("%.10g", x[LENGTH]) << ";"
+                 << format("%.10g", y[LENGTH]) << "\n";
+        }
+        different += t.different.size();
+    }
+    if (total.mismatched_realcost > 0)
+    {
+        cerr << total.mismatched_realcost << " queries have different "
+             << "realcosts, so the files may be for different scenarios"
+             << endl;
+    }
+    // Ratios are b over a, so below 1 means b is shorter, faster or
+    // expands fewer nodes.
+    cerr << "rows;matched;missing;different;length ratio;time ratio;"
+         << "expanded ratio" << endl;
+    cerr << n << ";" << total.matched << ";" << total.missing << ";"
+         << different << ";"
+         << format_ratio(total.length_b, total.length_a) << ";"
+         << format_ratio(total.micro_b, total.micro_a) << ";"
+         << format_ratio(total.expanded_b, total.expanded_a) << endl;
+    if (total.matched == 0)
+    {
+        cerr << "No queries matched" << endl;
+    }
+    if (!write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return different == 0 && total.missing == 0 && total.matched != 0 ? 0 : 1;
+}
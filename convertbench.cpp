@@ -0,0 +1,435 @@
+// Times each phase of each converter on grid maps, so we can tell where the
+// time goes and catch changes which make them slower.
+// For each map (scaled up by each of --scales=K,... so every cell becomes KxK
+// cells, default 1), this does what gridmap2poly, gridmap2rects, poly2mesh,
+// meshmerger, meshpacker (with each format) and meshunpacker do, in memory,
+// --repeat=N times (default 3). The "pack" format only works with integer
+// coordinates, so --v1 packs the rects mesh instead of the triangles.
+// Polymaps (.poly files, like the ones polygen makes) can be given too, and
+// start at poly2mesh.
+// Prints "map;scale;cells;tool;phase;seconds" for the fastest run of each
+// phase, and a "total" for each tool, to --output=FILE (or stderr, as stdout
+// has the Fade2D license on it).
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include "triangulate.h"
+#include "merger.h"
+#include "rects.h"
+#include "textmesh.h"
+#include "pack.h"
+#include "compress.h"
+#include "edgebreaker.h"
+#include "timing.h"
+#include "stats.h"
+
+#define FORMAT_VERSION 2
+
+using namespace std;
+using namespace GEOM_FADE2D;
+
+int repeat = 3;
+vector<int> scales(1, 1);
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--repeat=N] [--scales=K,...] "
+         << "[--output=FILE] [--stats=json] [--chrome-trace=FILE] "
+         << "<map files>" << endl;
+}
+
+void fail(const string& message)
+{
+    cerr << message << endl;
+    exit(1);
+}
+
+// The map as text, with every cell made into scale x scale cells.
+string scale_map(const meshutils::GridMap& map, int scale)
+{
+    ostringstream out;
+    out << "type octile\nheight " << map.height * scale << "\nwidth "
+        << map.width * scale << "\nmap\n";
+    string row;
+    for (int y = 0; y < map.height; y++)
+    {
+        row.clear();
+        for (int x = 0; x < map.width; x++)
+        {
+            row.append(scale, map.traversable[y][x] ? '.' : '@');
+        }
+        for (int i = 0; i < scale; i++)
+        {
+            out << row << "\n";
+        }
+    }
+    return out.str();
+}
+
+// Runs fn repeat times, and prints the fastest time of each of its phases.
+// fn should do the same phases each time.
+void run(const string& map, int scale, long long cells, const string& tool,
+         const function<void(meshutils::PhaseTimes&)>& fn, ostream& out)
+{
+    meshutils::PhaseTimes best;
+    for (int r = 0; r < repeat; r++)
+    {
+        meshutils::PhaseTimes times;
+        fn(times);
+        times.stop();
+        if (r == 0)
+        {
+            best = times;
+            continue;
+        }
+        for (size_t i = 0; i < best.phases.size(); i++)
+        {
+            best.phases[i].second = min(best.phases[i].second,
+                                        times.phases[i].second);
+        }
+    }
+    best.phases.push_back(make_pair("total", best.total()));
+    for (const pair<string, double>& phase : best.phases)
+    {
+        out << map << ";" << scale << ";" << cells << ";" << tool << ";"
+            << phase.first << ";" << phase.second << endl;
+    }
+}
+
+bool is_polymap(const string& filename)
+{
+    return filename.size() >= 5 &&
+           filename.compare(filename.size() - 5, 5, ".poly") == 0;
+}
+
+// Reads a polymap's text, and counts its points.
+string read_polymap(const string& filename, long long& points)
+{
+    ifstream infile(filename);
+    if (!infile.is_open())
+    {
+        fail("Unable to open " + filename);
+    }
+    ostringstream text;
+    text << infile.rdbuf();
+    istringstream in(text.str());
+    string header;
+    int version, polygons;
+    in >> header >> version >> polygons;
+    points = 0;
+    for (int i = 0; i < polygons && in; i++)
+    {
+        int n;
+        double x;
+        in >> n;
+        points += n;
+        for (int j = 0; j < 2 * n; j++)
+        {
+            in >> x;
+        }
+    }
+    if (header != "poly" || !in)
+    {
+        fail(filename + ": not a polymap");
+    }
+    return text.str();
+}
+
+void bench(const string& filename, int scale, ostream& out)
+{
+    const string name = filename.substr(filename.find_last_of('/') + 1);
+    string error;
+    // What each tool outputs, for the tools after it.
+    string polymap_text;
+    string mesh_text;
+    string rects_text;
+    long long cells;
+    if (is_polymap(filename))
+    {
+        // Polymaps (from polygen, say) start at poly2mesh, and the points
+        // go in the cells column.
+        polymap_text = read_polymap(filename, cells);
+    }
+    else
+    {
+        ifstream infile(filename);
+        if (!infile.is_open())
+        {
+            fail("Unable to open " + filename);
+        }
+        meshutils::GridMap original;
+        if (!meshutils::read_gridmap(infile, original, error))
+        {
+            fail(filename + ": " + error);
+        }
+        const string map_text = scale_map(original, scale);
+        cells = (long long) original.width * original.height * scale * scale;
+        original = meshutils::GridMap();
+
+        meshutils::GridMap map;
+        run(name, scale, cells, "gridmap2poly",
+            [&](meshutils::PhaseTimes& times)
+        {
+            times.start("read");
+            istringstream in(map_text);
+            if (!meshutils::read_gridmap(in, map, error))
+            {
+                fail(filename + ": " + error);
+            }
+            meshutils::PolyMap polymap;
+            meshutils::trace_polygons(map, polymap, &times);
+            times.start("print");
+            ostringstream printed;
+            meshutils::write_polymap(polymap, printed);
+            polymap_text = printed.str();
+        }, out);
+
+        run(name, scale, cells, "gridmap2rects",
+            [&](meshutils::PhaseTimes& times)
+        {
+            meshutils::NavMesh mesh;
+            meshutils::make_rect_mesh(map, mesh, &times);
+            times.start("print");
+            ostringstream printed;
+            meshutils::write_text_mesh(mesh, FORMAT_VERSION, 0, printed);
+            rects_text = printed.str();
+        }, out);
+    }
+
+    run(name, scale, cells, "poly2mesh", [&](meshutils::PhaseTimes& times)
+    {
+        times.start("read_polys");
+        istringstream in(polymap_text);
+        vector<fadeutils::Polygon>* polygons = fadeutils::read_polys(in);
+        times.start("create_traversable_zone");
+        Fade_2D dt;
+        Zone2* traversable = fadeutils::create_traversable_zone(*polygons,
+                                                                dt);
+        times.start("make_mesh");
+        meshutils::NavMesh mesh;
+        fadeutils::make_mesh(dt, traversable, FORMAT_VERSION, mesh);
+        times.start("print");
+        ostringstream printed;
+        meshutils::write_text_mesh(mesh, FORMAT_VERSION, 0, printed);
+        mesh_text = printed.str();
+        times.stop();
+        delete polygons;
+    }, out);
+
+    run(name, scale, cells, "meshmerger", [&](meshutils::PhaseTimes& times)
+    {
+        times.start("read");
+        istringstream in(mesh_text);
+        meshutils::ExactMesh mesh;
+        if (!meshutils::read_text_mesh(in, meshutils::TextMeshOptions(),
+                                       mesh, error))
+        {
+            fail(filename + ": " + error);
+        }
+        meshutils::MergeOptions options;
+        options.times = &times;
+        meshutils::NavMesh merged;
+        if (!meshutils::merge_mesh(mesh.mesh, options, merged, nullptr,
+                                   error))
+        {
+            fail(filename + ": " + error);
+        }
+        times.start("print");
+        ostringstream printed;
+        meshutils::write_text_mesh(merged, FORMAT_VERSION, 0, printed);
+    }, out);
+
+    // The packers keep the coordinates exact.
+    meshutils::TextMeshOptions exact;
+    exact.min_version = 1;
+    exact.min_vertex_polygons = 0;
+    exact.exact = true;
+    meshutils::ExactMesh triangles;
+    istringstream in(mesh_text);
+    if (!meshutils::read_text_mesh(in, exact, triangles, error))
+    {
+        fail(filename + ": " + error);
+    }
+    mesh_text.clear();
+    string packed_v2;
+    run(name, scale, cells, "meshpacker", [&](meshutils::PhaseTimes& times)
+    {
+        times.start("pack");
+        ostringstream packed;
+        meshutils::pack_v2(triangles, packed);
+        packed_v2 = packed.str();
+    }, out);
+    run(name, scale, cells, "meshunpacker", [&](meshutils::PhaseTimes& times)
+    {
+        times.start("unpack");
+        meshutils::ExactMesh mesh;
+        if (!meshutils::unpack_v2(packed_v2, mesh, error))
+        {
+            fail(filename + ": " + error);
+        }
+    }, out);
+    packed_v2.clear();
+
+    if (!rects_text.empty())
+    {
+        string packed_v1;
+        run(name, scale, cells, "meshpacker --v1",
+            [&](meshutils::PhaseTimes& times)
+        {
+            times.start("pack");
+            istringstream in(rects_text);
+            string header;
+            in >> header;
+            ostringstream packed;
+            meshutils::pack_v1(in, packed);
+            packed_v1 = packed.str();
+        }, out);
+        run(name, scale, cells, "meshunpacker --v1",
+            [&](meshutils::PhaseTimes& times)
+        {
+            times.start("unpack");
+            istringstream in(packed_v1);
+            in.ignore(4);
+            ostringstream unpacked;
+            meshutils::unpack_v1(in, unpacked);
+        }, out);
+    }
+
+    string compressed;
+    run(name, scale, cells, "meshpacker --compress",
+        [&](meshutils::PhaseTimes& times)
+    {
+        times.start("compress");
+        ostringstream packed;
+        meshutils::write_compressed_mesh(
+            triangles, meshutils::DEFAULT_BLOCK_SIZE, 0, packed);
+        compressed = packed.str();
+    }, out);
+    run(name, scale, cells, "meshunpacker --compress",
+        [&](meshutils::PhaseTimes& times)
+    {
+        times.start("open");
+        meshutils::CompressedMesh packed;
+        meshutils::ExactMesh mesh;
+        if (!packed.open(compressed, error))
+        {
+            fail(filename + ": " + error);
+        }
+        times.start("decode");
+        if (!packed.decode(mesh, 0, error))
+        {
+            fail(filename + ": " + error);
+        }
+    }, out);
+
+    string encoded;
+    if (!meshutils::encode_edgebreaker(triangles, encoded, error))
+    {
+        // Only some triangle meshes can be packed like this.
+        return;
+    }
+    run(name, scale, cells, "meshpacker --edgebreaker",
+        [&](meshutils::PhaseTimes& times)
+    {
+        times.start("encode");
+        encoded.clear();
+        meshutils::encode_edgebreaker(triangles, encoded, error);
+    }, out);
+    run(name, scale, cells, "meshunpacker --edgebreaker",
+        [&](meshutils::PhaseTimes& times)
+    {
+        times.start("decode");
+        meshutils::ExactMesh mesh;
+        if (!meshutils::decode_edgebreaker(encoded, mesh, error))
+        {
+            fail(filename + ": " + error);
+        }
+    }, out);
+}
+
+int main(int argc, char* argv[])
+{
+    string output;
+    vector<string> filenames;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 9, "--repeat=") == 0)
+        {
+            repeat = atoi(arg.c_str() + 9);
+            if (repeat < 1)
+            {
+                cerr << "Repeat must be positive" << endl;
+                return 1;
+            }
+        }
+        else if (arg.compare(0, 9, "--scales=") == 0)
+        {
+            scales.clear();
+            istringstream list(arg.substr(9));
+            string scale;
+            while (getline(list, scale, ','))
+            {
+                scales.push_back(atoi(scale.c_str()));
+                if (scales.back() < 1)
+                {
+                    cerr << "Scales must be positive" << endl;
+                    return 1;
+                }
+            }
+        }
+        else if (arg.compare(0, 9, "--output=") == 0)
+        {
+            output = arg.substr(9);
+        }
+        else if (meshutils::parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (arg.compare(0, 2, "--") != 0)
+        {
+            filenames.push_back(arg);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filenames.empty() || scales.empty())
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+    ofstream outfile;
+    if (!output.empty())
+    {
+        outfile.open(output);
+        if (!outfile.is_open())
+        {
+            cerr << "Unable to open " << output << endl;
+            return 1;
+        }
+    }
+    ostream& out = output.empty() ? cerr : outfile;
+    out << "map;scale;cells;tool;phase;seconds" << endl;
+    for (int scale : scales)
+    {
+        for (const string& filename : filenames)
+        {
+            // Scaling a polymap would just give the same triangles.
+            if (scale == 1 || !is_polymap(filename))
+            {
+                bench(filename, scale, out);
+            }
+        }
+    }
+    string error;
+    if (!meshutils::write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return 0;
+}
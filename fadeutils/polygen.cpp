@@ -0,0 +1,206 @@
+#include "polygen.h"
+#include <testDataGenerators.h>
+#include <cmath>
+#include <random>
+
+namespace fadeutils
+{
+
+namespace
+{
+
+// How much of each cell is left empty around what's in it, so neighbours
+// never touch.
+const double CELL_MARGIN = 0.1;
+// The coastline's radius goes from COAST_RADIUS - COAST_WOBBLE to
+// COAST_RADIUS + COAST_WOBBLE times half the size.
+const double COAST_RADIUS = 0.8;
+const double COAST_WOBBLE = 0.15;
+// Fade2D's generateRandomPolygon takes over a second for anything smaller
+// (and well under a millisecond for this), so obstacles have at least this
+// many points.
+const int MIN_RANDOM_VERTICES = 100;
+
+// A seed for one of Fade2D's generators. 0 would make it use the time.
+unsigned int fade_seed(mt19937& rng)
+{
+    unsigned int seed;
+    do
+    {
+        seed = rng();
+    }
+    while (seed == 0);
+    return seed;
+}
+
+double random_unit(mt19937& rng)
+{
+    return uniform_real_distribution<double>(0, 1)(rng);
+}
+
+void add_point(vector<double>& polygon, double x, double y)
+{
+    polygon.push_back(x);
+    polygon.push_back(y);
+}
+
+// A fractal wobble for each of n angles around a circle, between -1 and 1:
+// random values around the circle, smoothly joined, plus half as much of
+// twice as many, and so on.
+vector<double> fractal_wobble(int n, mt19937& rng)
+{
+    vector<double> wobble(n, 0.0);
+    double amplitude = 1;
+    double total = 0;
+    for (int knots = 4; knots <= 2 * n; knots *= 2)
+    {
+        vector<double> values(knots);
+        for (double& v : values)
+        {
+            v = random_unit(rng) * 2 - 1;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            const double at = (double) i * knots / n;
+            const int k = at;
+            double t = at - k;
+            t = t * t * (3 - 2 * t);
+            wobble[i] += amplitude * (values[k] +
+                         (values[(k + 1) % knots] - values[k]) * t);
+        }
+        total += amplitude;
+        amplitude /= 2;
+    }
+    for (double& w : wobble)
+    {
+        w /= total;
+    }
+    return wobble;
+}
+
+// A random simple polygon from Fade2D, scaled into the square from (x, y)
+// to (x + side, y + side).
+vector<double> random_polygon(int vertices, double x, double y,
+                              double side, mt19937& rng)
+{
+    vector<Segment2> segments;
+    generateRandomPolygon(max(vertices, MIN_RANDOM_VERTICES), 0, 1, segments,
+                          fade_seed(rng));
+    double min_x = segments[0].getSrc().x(), max_x = min_x;
+    double min_y = segments[0].getSrc().y(), max_y = min_y;
+    for (const Segment2& s : segments)
+    {
+        min_x = min(min_x, s.getSrc().x());
+        max_x = max(max_x, s.getSrc().x());
+        min_y = min(min_y, s.getSrc().y());
+        max_y = max(max_y, s.getSrc().y());
+    }
+    // Scaling it the same both ways keeps it simple. Some are made smaller
+    // and moved around their cell, so they don't all line up.
+    const double scale = side * (0.5 + 0.5 * random_unit(rng)) /
+                         max(max_x - min_x, max_y - min_y);
+    x += (side - (max_x - min_x) * scale) * random_unit(rng);
+    y += (side - (max_y - min_y) * scale) * random_unit(rng);
+    vector<double> polygon;
+    for (const Segment2& s : segments)
+    {
+        add_point(polygon, x + (s.getSrc().x() - min_x) * scale,
+                  y + (s.getSrc().y() - min_y) * scale);
+    }
+    return polygon;
+}
+
+// depth star-shaped polygons around (cx, cy), each inside the last: every
+// one has its points at the same angles, a bit closer in than the one
+// around it, so they can't cross.
+void add_nest(int depth, int vertices, double cx, double cy, double radius,
+              mt19937& rng, meshutils::PolyMap& out)
+{
+    vector<double> angles(vertices);
+    vector<double> radii(vertices);
+    for (int i = 0; i < vertices; i++)
+    {
+        angles[i] = 2 * M_PI * (i + 0.8 * random_unit(rng)) / vertices;
+        radii[i] = radius * (0.6 + 0.4 * random_unit(rng));
+    }
+    for (int level = 0; level < depth; level++)
+    {
+        vector<double> polygon;
+        for (int i = 0; i < vertices; i++)
+        {
+            add_point(polygon, cx + radii[i] * cos(angles[i]),
+                      cy + radii[i] * sin(angles[i]));
+            radii[i] *= 0.5 + 0.3 * random_unit(rng);
+        }
+        out.polygons.push_back(polygon);
+    }
+}
+
+}
+
+void generate_polymap(const PolyGenOptions& options,
+                      meshutils::PolyMap& out)
+{
+    mt19937 rng(options.seed);
+    out.polygons.clear();
+    const double half = options.size / 2;
+    // Everything else goes in the square from low to low + side.
+    double low, side;
+    if (options.coast >= 3)
+    {
+        // A star around the middle, so it can't cross itself. Its edges cut
+        // in to cos(pi / coast) of its smallest radius, and the biggest
+        // square inside that is left for the obstacles.
+        const vector<double> wobble = fractal_wobble(options.coast, rng);
+        vector<double> coast;
+        for (int i = 0; i < options.coast; i++)
+        {
+            const double angle = 2 * M_PI * i / options.coast;
+            const double radius = half * (COAST_RADIUS +
+                                          COAST_WOBBLE * wobble[i]);
+            add_point(coast, half + radius * cos(angle),
+                      half + radius * sin(angle));
+        }
+        out.polygons.push_back(coast);
+        side = half * (COAST_RADIUS - COAST_WOBBLE) *
+               cos(M_PI / options.coast) * sqrt(2.0);
+        low = half - side / 2;
+    }
+    else
+    {
+        out.polygons.push_back({0, 0, options.size, 0, options.size,
+                                options.size, 0, options.size});
+        low = 0;
+        side = options.size;
+    }
+
+    // Each obstacle and nest gets a random cell of a grid with enough cells
+    // for all of them.
+    const int things = options.polygons + options.nests;
+    const int across = ceil(sqrt((double) things));
+    vector<int> cells(across * across);
+    for (int i = 0; i < (int) cells.size(); i++)
+    {
+        cells[i] = i;
+    }
+    shuffle(cells.begin(), cells.end(), rng);
+    const double cell = side / max(across, 1);
+    const double inner = cell * (1 - 2 * CELL_MARGIN);
+    for (int i = 0; i < things; i++)
+    {
+        const double x = low + cells[i] % across * cell + cell * CELL_MARGIN;
+        const double y = low + cells[i] / across * cell + cell * CELL_MARGIN;
+        if (i < options.polygons)
+        {
+            out.polygons.push_back(random_polygon(options.vertices, x, y,
+                                                  inner, rng));
+        }
+        else
+        {
+            add_nest(options.depth, options.vertices, x + inner / 2,
+                     y + inner / 2, inner / 2, rng, out);
+        }
+    }
+}
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "polymap.h"
+#include "gridmap.h"
+
+namespace fadeutils
+{
+
+const int MIN_COAST = 8;
+
+// What generate_polymap makes.
+struct PolyGenOptions
+{
+    // The map is size by size.
+    double size;
+    // How many random obstacles there are, from Fade2D's
+    // generateRandomPolygon.
+    int polygons;
+    // How many nests there are: obstacles with a traversable hole in them,
+    // with an obstacle in that, and so on, depth polygons deep.
+    int nests;
+    int depth;
+    // The points in each ring of a nest, and each obstacle (though those
+    // always have at least 100, see polygen.cpp).
+    int vertices;
+    // The points in the coastline around the map, or 0 for a square. With
+    // fewer than MIN_COAST, there's hardly any room left for the obstacles.
+    int coast;
+    // The same options and seed always give the same polymap.
+    unsigned int seed;
+
+    PolyGenOptions()
+        : size(1000), polygons(100), nests(0), depth(3), vertices(100),
+          coast(0), seed(0)
+    {
+    }
+};
+
+// Makes a random polymap (see spec/poly). The first polygon goes around the
+// map: a square, or a fractal coastline if coast is given. The obstacles
+// and nests are each put in their own cell of a grid, which fits inside the
+// coastline's edges, so nothing crosses.
+void generate_polymap(const PolyGenOptions& options,
+                      meshutils::PolyMap& out);
+
+}
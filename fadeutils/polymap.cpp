@@ -98,10 +98,9 @@ vector<ConstraintGraph2*> *create_constraint_graphs(const vector<Polygon> &polyg
     return constraint_graphs;
 }
 
-Zone2* create_traversable_zone(istream& infile, Fade_2D &dt)
+Zone2* create_traversable_zone(const vector<Polygon> &polygons, Fade_2D &dt)
 {
-    vector<Polygon> *polygons = read_polys(infile);
-    vector<ConstraintGraph2*> *cgs = create_constraint_graphs(*polygons, dt);
+    vector<ConstraintGraph2*> *cgs = create_constraint_graphs(polygons, dt);
     dt.applyConstraintsAndZones();
 
     #ifndef NDEBUG
@@ -126,6 +125,15 @@ Zone2* create_traversable_zone(istream& infile, Fade_2D &dt)
     {
         traversable = zoneSymmetricDifference(traversable, zones[i]);
     }
+    delete cgs;
+    return traversable;
+}
+
+Zone2* create_traversable_zone(istream& infile, Fade_2D &dt)
+{
+    vector<Polygon> *polygons = read_polys(infile);
+    Zone2* traversable = create_traversable_zone(*polygons, dt);
+    delete polygons;
     return traversable;
 }
 
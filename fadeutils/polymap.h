@@ -18,6 +18,8 @@ vector<Polygon> *read_polys(istream& infile);
 
 vector<ConstraintGraph2*> *create_constraint_graphs(const vector<Polygon> &polygons, Fade_2D &dt);
 
+Zone2* create_traversable_zone(const vector<Polygon> &polygons, Fade_2D &dt);
+
 Zone2* create_traversable_zone(istream& infile, Fade_2D &dt);
 
 }
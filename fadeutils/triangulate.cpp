@@ -0,0 +1,175 @@
+#include "triangulate.h"
+#include <unordered_map>
+#include <algorithm>
+#include <array>
+
+namespace fadeutils
+{
+
+namespace
+{
+
+// Fade2D doesn't have a nice "is this triangle in this zone?" function so we
+// will have to make our own. Additionally, Fade2D has its own point index
+// feature, but it doesn't have a triangle index feature.
+// This map will satisfy both of these uses.
+typedef unordered_map<Triangle2*, int> TriangleIndex;
+
+// The polygons around a vertex, with -1 for the non-traversable area.
+vector<int> get_vertex_neighbours(const TriangleIndex& triangle_to_index,
+                                  Point2* vertex)
+{
+    vector<int> neighbours;
+    typedef TriangleAroundVertexIterator TAVI;
+    TAVI start(vertex);
+    bool first = true;
+    for (TAVI it(start); (it != start) || first; ++it)
+    {
+        first = false;
+        Triangle2 *cur_triangle = *it;
+
+        // triangle not in traversable area
+        auto found = triangle_to_index.find(cur_triangle);
+        if (cur_triangle == NULL || found == triangle_to_index.end())
+        {
+            if (neighbours.empty() || neighbours.back() != -1)
+            {
+                neighbours.push_back(-1);
+            }
+        }
+        else
+        {
+            neighbours.push_back(found->second);
+        }
+    }
+
+    // Most -1s should be removed already, but it is possible that
+    // the first AND last element are -1s.
+    assert(!neighbours.empty());
+    if (neighbours.front() == -1 && neighbours.back() == -1)
+    {
+        neighbours.pop_back();
+    }
+    // Which triangle the iterator starts from depends on how the
+    // triangulation was built, so start from the lowest numbered one.
+    // This way the same polymap gives the same mesh however it was read in.
+    auto lowest = neighbours.end();
+    for (auto it = neighbours.begin(); it != neighbours.end(); ++it)
+    {
+        if (*it != -1 && (lowest == neighbours.end() || *it < *lowest))
+        {
+            lowest = it;
+        }
+    }
+    if (lowest != neighbours.end())
+    {
+        rotate(neighbours.begin(), lowest, neighbours.end());
+    }
+    return neighbours;
+}
+
+// The triangle opposite corner i of a triangle, or -1 if there isn't one.
+int get_triangle_neighbour(const TriangleIndex& triangle_to_index,
+                           Triangle2* triangle, int i)
+{
+    Triangle2 *cur_triangle = triangle->getOppositeTriangle(i);
+    auto found = triangle_to_index.find(cur_triangle);
+    if (cur_triangle == NULL || found == triangle_to_index.end())
+    {
+        return -1;
+    }
+    return found->second;
+}
+
+}
+
+void make_mesh(Fade_2D &dt, Zone2* traversable, int version,
+               meshutils::NavMesh& out)
+{
+    vector<Point2*> vertices;
+    dt.getVertexPointers(vertices);
+    for (int i = 0; i < (int)vertices.size(); i++)
+    {
+        vertices[i]->setCustomIndex(i);
+    }
+    vector<Triangle2*> triangles;
+    traversable->getTriangles(triangles);
+    // The order Fade2D gives the triangles in depends on where they are in
+    // memory, which changes from run to run, so number them by their
+    // corners instead. Every triangle has different corners.
+    auto sorted_corners = [](Triangle2* triangle)
+    {
+        array<int, 3> out;
+        for (int i = 0; i < 3; i++)
+        {
+            out[i] = triangle->getCorner(i)->getCustomIndex();
+        }
+        sort(out.begin(), out.end());
+        return out;
+    };
+    sort(triangles.begin(), triangles.end(),
+         [&](Triangle2* x, Triangle2* y)
+         {
+             return sorted_corners(x) < sorted_corners(y);
+         });
+    TriangleIndex triangle_to_index;
+    for (int i = 0; i < (int)triangles.size(); i++)
+    {
+        triangle_to_index[triangles[i]] = i;
+    }
+
+    // Triangles.
+    // Go 2 0 1 in version 1, 1 2 0 in version 2.
+    const int VERSION_1_INDEX[] = {2, 0, 1};
+    const int VERSION_2_INDEX[] = {1, 2, 0};
+    const int* triangle_index = version == 1 ? VERSION_1_INDEX
+                                             : VERSION_2_INDEX;
+
+    for (auto vertex : vertices)
+    {
+        double x, y;
+        vertex->xy(x, y);
+        out.add_vertex(x, y, get_vertex_neighbours(triangle_to_index,
+                                                   vertex));
+    }
+    vector<int> corners(3);
+    vector<int> neighbours(3);
+    for (auto triangle : triangles)
+    {
+        // Vertices go 0 1 2.
+        for (int i = 0; i < 3; i++)
+        {
+            corners[i] = triangle->getCorner(i)->getCustomIndex();
+            neighbours[i] = get_triangle_neighbour(triangle_to_index,
+                                                   triangle,
+                                                   triangle_index[i]);
+        }
+        out.add_polygon(corners, neighbours);
+    }
+}
+
+bool triangulate(const meshutils::PolyMap& polymap, meshutils::NavMesh& out,
+                 string& error)
+{
+    if (polymap.polygons.empty())
+    {
+        error = "Invalid number of polys";
+        return false;
+    }
+    vector<Polygon> polygons;
+    for (const vector<double>& points : polymap.polygons)
+    {
+        Polygon polygon;
+        for (size_t i = 0; i + 1 < points.size(); i += 2)
+        {
+            polygon.push_back(Point2(points[i], points[i+1]));
+        }
+        polygons.push_back(polygon);
+    }
+    Fade_2D dt;
+    Zone2* traversable = create_traversable_zone(polygons, dt);
+    make_mesh(dt, traversable, 2, out);
+    return true;
+}
+
+}
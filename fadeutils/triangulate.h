@@ -0,0 +1,22 @@
+#pragma once
+#include "polymap.h"
+#include "navmesh.h"
+#include "gridmap.h"
+
+namespace fadeutils
+{
+
+// Makes a mesh of the triangles in the traversable zone of dt, like
+// poly2mesh. Every vertex of the triangulation is kept.
+// version is the mesh format version (see spec/mesh), which changes the order
+// of each triangle's neighbours.
+void make_mesh(Fade_2D &dt, Zone2* traversable, int version,
+               meshutils::NavMesh& out);
+
+// Triangulates the traversable area of the polymap into a version 2 mesh.
+// Returns false and sets error if there is nothing to triangulate, like
+// poly2mesh does for a polymap without any polygons.
+bool triangulate(const meshutils::PolyMap& polymap, meshutils::NavMesh& out,
+                 string& error);
+
+}
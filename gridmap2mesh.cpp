@@ -0,0 +1,138 @@
+// Does gridmap2poly, poly2mesh and (optionally) meshmerger in one go, without
+// writing out the polymap and mesh in between.
+// Takes a gridmap from stdin, and writes the mesh to the file given.
+// It can't go to stdout, as Fade prints its license there before main runs.
+#include <fstream>
+#include "triangulate.h"
+#include "merger.h"
+#include "binmesh.h"
+#include "textmesh.h"
+#include "reorder.h"
+#include "stats.h"
+
+#define FORMAT_VERSION 2
+
+
+using namespace std;
+
+// Merge the triangles like meshmerger does (with its default options).
+bool merge_triangles = false;
+// Output the binary format (spec/mesh/3.txt) instead of text.
+bool binary = false;
+meshutils::CurveOrder curve = meshutils::CURVE_NONE;
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--merge] [--binary] "
+         << "[--reorder=hilbert|morton] [--stats=json] "
+         << "[--chrome-trace=FILE] <mesh file>" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    string filename;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg == "--merge")
+        {
+            merge_triangles = true;
+        }
+        else if (arg == "--binary")
+        {
+            binary = true;
+        }
+        else if (meshutils::parse_reorder_arg(arg, curve))
+        {
+            // That set curve.
+        }
+        else if (meshutils::parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (filename.empty() && arg.compare(0, 2, "--") != 0)
+        {
+            filename = arg;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filename.empty())
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    string error;
+    meshutils::NavMesh mesh;
+    {
+        meshutils::GridMap map;
+        {
+            meshutils::StatsPhase phase("read");
+            if (!meshutils::read_gridmap(cin, map, error))
+            {
+                cerr << error << endl;
+                return 1;
+            }
+        }
+        meshutils::PolyMap polymap;
+        {
+            meshutils::StatsPhase phase("trace");
+            meshutils::trace_polygons(map, polymap);
+        }
+        meshutils::StatsPhase phase("triangulate");
+        if (!fadeutils::triangulate(polymap, mesh, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+    }
+    if (merge_triangles)
+    {
+        meshutils::StatsPhase phase("merge");
+        meshutils::MeshStats stats;
+        if (!meshutils::merge_mesh(mesh, meshutils::MergeOptions(), mesh,
+                                   &stats, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+        cerr << stats.polygons << ";" << stats.deadends << ";"
+             << stats.sum_traversable << endl;
+    }
+    {
+        meshutils::StatsPhase phase("reorder");
+        meshutils::reorder_mesh(mesh, curve);
+    }
+
+    ofstream outfile(filename, ios::binary);
+    if (!outfile.is_open())
+    {
+        cerr << "Unable to open " << filename << endl;
+        return 1;
+    }
+    {
+        meshutils::StatsPhase phase("write");
+        if (binary)
+        {
+            if (!meshutils::write_binary_mesh(mesh, outfile, error))
+            {
+                cerr << error << endl;
+                return 1;
+            }
+        }
+        else
+        {
+            meshutils::write_text_mesh(mesh, FORMAT_VERSION, 0, outfile);
+        }
+    }
+    if (!meshutils::write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return 0;
+}
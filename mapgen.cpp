@@ -0,0 +1,90 @@
+// Makes random octile maps of any size, for testing the converters on maps
+// bigger (or stranger) than the ones we have.
+// --type=random|rooms|maze|islands picks what the map looks like (see
+// meshutils/mapgen.h), and --width=N and --height=N its size (default 512).
+// The map is written to stdout as it is made, so it can be bigger than
+// memory. The same options and --seed=N give the same map.
+#include <stdlib.h>
+#include <iostream>
+#include <string>
+#include "mapgen.h"
+#include "stats.h"
+
+using namespace std;
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--type=random|rooms|maze|islands] "
+         << "[--width=N] [--height=N] [--density=P] [--size=N] "
+         << "[--levels=N] [--seed=N] [--threads=N] [--stats=json] "
+         << "[--chrome-trace=FILE]" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    meshutils::MapOptions options;
+    bool valid = true;
+    int threads = 0;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 7, "--type=") == 0)
+        {
+            valid &= meshutils::parse_map_type(arg.substr(7), options.type);
+        }
+        else if (arg.compare(0, 8, "--width=") == 0)
+        {
+            options.width = atoi(arg.c_str() + 8);
+        }
+        else if (arg.compare(0, 9, "--height=") == 0)
+        {
+            options.height = atoi(arg.c_str() + 9);
+        }
+        else if (arg.compare(0, 10, "--density=") == 0)
+        {
+            options.density = atof(arg.c_str() + 10);
+            options.room_density = options.density;
+        }
+        else if (arg.compare(0, 7, "--size=") == 0)
+        {
+            options.size = atoi(arg.c_str() + 7);
+        }
+        else if (arg.compare(0, 9, "--levels=") == 0)
+        {
+            options.levels = atoi(arg.c_str() + 9);
+        }
+        else if (arg.compare(0, 7, "--seed=") == 0)
+        {
+            options.seed = strtoull(arg.c_str() + 7, nullptr, 10);
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (!meshutils::parse_stats_arg(arg))
+        {
+            valid = false;
+        }
+    }
+    if (!valid)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+    // Writes go straight out in big blocks, so there's no point syncing with
+    // stdio.
+    ios::sync_with_stdio(false);
+    string error;
+    if (!meshutils::generate_gridmap(options, threads, cout, error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    cout.flush();
+    if (!meshutils::write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return cout ? 0 : 1;
+}
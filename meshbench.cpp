@@ -0,0 +1,238 @@
+// Runs Polyanya on every query of a scenario file, on a mesh, and prints
+// what each search did as CSV. Meshes made with different options can then
+// be compared on the same scenarios.
+// Takes the mesh and the scenario (in the Moving AI .scen format) as
+// arguments, and prints
+// "index;micro;expanded;generated;pushed;popped;pruned;length;realcost"
+// for each query to stdout. Queries run on --threads=N threads (default one
+// per core), each with its own copy of the search.
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "parallel.h"
+#include "search.h"
+#include "stats.h"
+#include "textmesh.h"
+using namespace std;
+using namespace meshutils;
+
+struct Query
+{
+    double sx, sy, gx, gy;
+    // The length the scenario gives, which is usually the octile distance
+    // on the grid.
+    double cost;
+};
+
+struct Result
+{
+    SearchStats stats;
+    double seconds;
+    double length;
+};
+
+string format(const char* spec, double x)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), spec, x);
+    return buffer;
+}
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--trace=FILE] [--threads=N] "
+         << "[--stats=json] [--chrome-trace=FILE] <mesh file> "
+         << "<scenario file>" << endl;
+}
+
+// Reads "bucket map width height sx sy gx gy cost" lines, after an optional
+// "version" line.
+bool read_scenario(const string& filename, vector<Query>& queries,
+                   string& error)
+{
+    ifstream infile(filename);
+    if (!infile.is_open())
+    {
+        error = "Unable to open " + filename;
+        return false;
+    }
+    string line;
+    int line_number = 0;
+    while (getline(infile, line))
+    {
+        line_number++;
+        if (line.find_first_not_of(" \t\r") == string::npos ||
+            (line_number == 1 && line.compare(0, 7, "version") == 0))
+        {
+            continue;
+        }
+        istringstream fields(line);
+        string bucket, map;
+        int width, height;
+        Query query;
+        if (!(fields >> bucket >> map >> width >> height >> query.sx
+                     >> query.sy >> query.gx >> query.gy >> query.cost))
+        {
+            error = "Invalid query on line " + to_string(line_number);
+            return false;
+        }
+        queries.push_back(query);
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    string trace_filename;
+    int threads = 0;
+    vector<string> filenames;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 8, "--trace=") == 0 && arg.size() > 8)
+        {
+            trace_filename = arg.substr(8);
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (arg.compare(0, 2, "--") != 0 && filenames.size() < 2)
+        {
+            filenames.push_back(arg);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filenames.size() != 2)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    string error;
+    ExactMesh mesh;
+    TextMeshOptions options;
+    options.threads = threads;
+    vector<Query> queries;
+    {
+        StatsPhase phase("read");
+        if (!read_text_mesh(filenames[0], options, mesh, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+        if (!read_scenario(filenames[1], queries, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+    }
+    ofstream trace;
+    if (!trace_filename.empty())
+    {
+        trace.open(trace_filename);
+        if (!trace.is_open())
+        {
+            cerr << "Unable to open " << trace_filename << endl;
+            return 1;
+        }
+    }
+
+    // The trace would come out jumbled from more than one thread.
+    if (trace.is_open())
+    {
+        threads = 1;
+    }
+    else if (threads <= 0)
+    {
+        threads = thread::hardware_concurrency();
+    }
+    const int n = queries.size();
+    threads = max(1, min(threads, n));
+    vector<MeshSearch> searches(threads);
+    parallel_for(threads, threads, [&](int t)
+    {
+        StatsPhase phase("build");
+        searches[t].build(mesh.mesh);
+    });
+
+    vector<Result> results(n);
+    atomic<int> next(0);
+    const auto start = chrono::steady_clock::now();
+    parallel_for(threads, threads, [&](int t)
+    {
+        StatsPhase phase("search");
+        vector<double> path;
+        for (int i = next++; i < n; i = next++)
+        {
+            const Query& q = queries[i];
+            Result& result = results[i];
+            const auto query_start = chrono::steady_clock::now();
+            result.length = searches[t].search(
+                q.sx, q.sy, q.gx, q.gy, result.stats,
+                trace.is_open() ? &path : nullptr,
+                trace.is_open() ? &trace : nullptr);
+            const chrono::duration<double> seconds =
+                chrono::steady_clock::now() - query_start;
+            result.seconds = seconds.count();
+            if (trace.is_open())
+            {
+                trace << "path " << i << ";";
+                for (size_t j = 0; j < path.size(); j += 2)
+                {
+                    trace << " (" << path[j] << ", " << path[j+1] << ")";
+                }
+                trace << "\n";
+            }
+        }
+    });
+    const chrono::duration<double> seconds =
+        chrono::steady_clock::now() - start;
+
+    long long total_expanded = 0;
+    int unreachable = 0;
+    {
+        StatsPhase phase("write");
+        cout << "index;micro;expanded;generated;pushed;popped;pruned;length;"
+             << "realcost" << "\n";
+        for (int i = 0; i < n; i++)
+        {
+            const Result& r = results[i];
+            total_expanded += r.stats.expanded;
+            unreachable += r.length < 0;
+            // Enough digits that lengths can be compared to the scenario's.
+            cout << i << ";" << format("%.3f", r.seconds * 1e6) << ";"
+                 << r.stats.expanded << ";" << r.stats.generated << ";"
+                 << r.stats.pushed << ";" << r.stats.popped << ";"
+                 << r.stats.pruned << ";" << format("%.10g", r.length) << ";"
+                 << format("%.10g", queries[i].cost) << "\n";
+        }
+    }
+    cerr << "queries;unreachable;seconds;queries per second;"
+         << "expanded per query" << endl;
+    cerr << n << ";" << unreachable << ";" << seconds.count() << ";"
+         << n / seconds.count() << ";"
+         << (double) total_expanded / max(n, 1) << endl;
+    stats_count("expanded", total_expanded);
+    stats_count("unreachable", unreachable);
+    if (!write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,122 @@
+// Checks that a mesh is valid: that Polyanya (and everything here) can use
+// it. See meshutils/validate.h for what is checked.
+// Takes text meshes (spec/mesh/2.txt) and binary ones (spec/mesh/3.txt).
+// Prints what's wrong to stdout, one problem per line, and how many problems
+// each check found to stderr.
+// Exits with 0 if the mesh is valid, 2 if it isn't, and 1 if it couldn't be
+// checked at all (it can't be read, or isn't a mesh).
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include "validate.h"
+#include "binmesh.h"
+#include "textmesh.h"
+#include "stats.h"
+using namespace std;
+using namespace meshutils;
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--max-errors=N] [--threads=N] "
+         << "[--stats=json] [--chrome-trace=FILE] <mesh file>" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    // How many problems to print.
+    int max_errors = 20;
+    int threads = 0;
+    string filename;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 13, "--max-errors=") == 0)
+        {
+            max_errors = atoi(arg.c_str() + 13);
+            if (max_errors < 0)
+            {
+                cerr << "Max errors must not be negative" << endl;
+                return 1;
+            }
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (filename.empty() && arg.compare(0, 2, "--") != 0)
+        {
+            filename = arg;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filename.empty())
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    string error;
+    ExactMesh mesh;
+    TextMeshOptions options;
+    options.threads = threads;
+    // Indices are left for check_mesh, so they show up as ranges.
+    options.check_indices = false;
+    {
+        StatsPhase phase("read");
+        if (is_binary_mesh(filename))
+        {
+            MappedMesh mapped;
+            if (!mapped.open(filename, error, true, false))
+            {
+                cerr << error << endl;
+                return 1;
+            }
+            mapped.copy_to(mesh.mesh);
+        }
+        else if (!read_text_mesh(filename, options, mesh, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+    }
+    MeshCheckReport report;
+    bool valid;
+    {
+        StatsPhase phase("check");
+        valid = check_mesh(mesh.mesh, threads, max_errors, report);
+    }
+    for (const string& message : report.messages)
+    {
+        cout << message << "\n";
+    }
+    if (report.total() > (long long) report.messages.size())
+    {
+        cout << "and " << report.total() - report.messages.size()
+             << " more" << "\n";
+    }
+    cout.flush();
+    for (int i = 0; i < NUM_CHECKS; i++)
+    {
+        cerr << (i > 0 ? ";" : "") << CHECK_NAMES[i];
+    }
+    cerr << endl;
+    for (int i = 0; i < NUM_CHECKS; i++)
+    {
+        cerr << (i > 0 ? ";" : "") << report.violations[i];
+    }
+    cerr << endl;
+    if (!write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return valid ? 0 : 2;
+}
@@ -0,0 +1,116 @@
+// Checks that a mesh covers exactly the traversable cells of the grid map it
+// was made from. See meshutils/coverage.h for how.
+// Prints what's wrong to stdout, one problem per line, and
+// "traversable;missing;extra;overlapping;outside;area" to stderr.
+// Exits with 0 if they match, 2 if they don't, and 1 if they couldn't be
+// compared at all (a file can't be read).
+#include <stdlib.h>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "coverage.h"
+#include "textmesh.h"
+#include "stats.h"
+using namespace std;
+using namespace meshutils;
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--max-errors=N] [--threads=N] "
+         << "[--stats=json] [--chrome-trace=FILE] <map file> <mesh file>"
+         << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    // How many problems to print.
+    int max_errors = 20;
+    int threads = 0;
+    vector<string> filenames;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 13, "--max-errors=") == 0)
+        {
+            max_errors = atoi(arg.c_str() + 13);
+            if (max_errors < 0)
+            {
+                cerr << "Max errors must not be negative" << endl;
+                return 1;
+            }
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (filenames.size() < 2 && arg.compare(0, 2, "--") != 0)
+        {
+            filenames.push_back(arg);
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filenames.size() != 2)
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    string error;
+    GridMap map;
+    {
+        StatsPhase phase("read map");
+        ifstream infile(filenames[0]);
+        if (!infile.is_open())
+        {
+            cerr << "Unable to open " << filenames[0] << endl;
+            return 1;
+        }
+        if (!read_gridmap(infile, map, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+    }
+    ExactMesh mesh;
+    TextMeshOptions options;
+    options.threads = threads;
+    {
+        StatsPhase phase("read mesh");
+        if (!read_text_mesh(filenames[1], options, mesh, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+    }
+    CoverageReport report;
+    const bool matches = compare_coverage(map, mesh.mesh, threads,
+                                          max_errors, report);
+    for (const string& message : report.messages)
+    {
+        cout << message << "\n";
+    }
+    if (report.problems() > (long long) report.messages.size())
+    {
+        cout << "and " << report.problems() - report.messages.size()
+             << " more" << "\n";
+    }
+    cout.flush();
+    cerr << "traversable;missing;extra;overlapping;outside;area" << endl;
+    cerr << report.traversable << ";" << report.missing << ";"
+         << report.extra << ";" << report.overlapping << ";"
+         << report.outside << ";" << to_string(report.area) << endl;
+    if (!write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return matches ? 0 : 2;
+}
@@ -0,0 +1,149 @@
+// Builds a point location index (spec/index/1.txt) for a mesh, so programs
+// can find which polygon a point is in without building one themselves.
+// With --query, locates the points on stdin using an index instead.
+#include <stdlib.h>
+#include <chrono>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "locate.h"
+#include "textmesh.h"
+#include "stats.h"
+using namespace std;
+using namespace meshutils;
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--stats=json] [--chrome-trace=FILE] "
+         << "<mesh file>" << endl;
+    cerr << "       " << name << " --query [--threads=N] [--stats=json] "
+         << "[--chrome-trace=FILE] <index file>" << endl;
+}
+
+int build(const string& filename)
+{
+    string error;
+    ExactMesh mesh;
+    {
+        StatsPhase phase("read");
+        if (!read_text_mesh(filename, TextMeshOptions(), mesh, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+    }
+    const auto start = chrono::steady_clock::now();
+    PointLocator index;
+    {
+        StatsPhase phase("build");
+        index.build(mesh.mesh);
+    }
+    const chrono::duration<double> seconds =
+        chrono::steady_clock::now() - start;
+
+    ofstream outfile(filename + ".index", ios::out | ios::binary);
+    if (!outfile.is_open())
+    {
+        cerr << "Unable to open file" << endl;
+        return 1;
+    }
+    {
+        StatsPhase phase("write");
+        index.write(outfile);
+    }
+    cerr << index.columns << "x" << index.rows << " buckets, "
+         << index.bucket_offsets[index.columns * index.rows]
+         << " polygons in buckets, built in " << seconds.count()
+         << " seconds" << endl;
+    return 0;
+}
+
+int query(const string& filename, int threads)
+{
+    string error;
+    PointLocator index;
+    vector<double> xy;
+    {
+        StatsPhase phase("read");
+        if (!index.open(filename, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+        if (!read_numbers(cin, xy) || xy.size() % 2 != 0)
+        {
+            cerr << "Expecting pairs of coordinates on stdin" << endl;
+            return 1;
+        }
+    }
+    const int n = xy.size() / 2;
+    vector<int> polygons(n);
+    const auto start = chrono::steady_clock::now();
+    {
+        StatsPhase phase("locate");
+        index.locate_batch(xy.data(), n, polygons.data(), threads);
+    }
+    const chrono::duration<double> seconds =
+        chrono::steady_clock::now() - start;
+
+    StatsPhase phase("write");
+    write_chunks(n, threads, [&](int begin, int end, TextBuffer& out)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            out.put_int(polygons[i]);
+            out.put('\n');
+        }
+    }, cout);
+    cerr << "located " << n << " points in " << seconds.count()
+         << " seconds" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[])
+{
+    bool query_mode = false;
+    int threads = 0;
+    string filename;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg == "--query")
+        {
+            query_mode = true;
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (filename.empty() && arg.compare(0, 2, "--") != 0)
+        {
+            filename = arg;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filename.empty())
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if ((query_mode ? query(filename, threads) : build(filename)) != 0)
+    {
+        return 1;
+    }
+    string error;
+    if (!write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,24 +1,106 @@
 #include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <vector>
+#include "pack.h"
+#include "compress.h"
+#include "edgebreaker.h"
+#include "textmesh.h"
+#include "stats.h"
 using namespace std;
+using namespace meshutils;
 
-void print_int(uint32_t n, ostream& s)
+void fail(const string& message)
 {
-    const char z = static_cast<char>(0xFF);
-    const char bytes[] = {static_cast<char>((n>>16)&z), static_cast<char>((n>>8)&z), static_cast<char>((n>>0)&z)};
-    s.write(bytes, 3);
+    cerr << message << endl;
+    exit(1);
+}
+
+// Prints and writes what --stats and --chrome-trace asked for.
+int finish(const char* name)
+{
+    string error;
+    if (!write_stats(name, error))
+    {
+        fail(error);
+    }
+    return 0;
+}
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--v1 | --edgebreaker [--keep-order] | "
+         << "--compress "
+         << "[--block-size=N] [--threads=N]] [--stats=json] "
+         << "[--chrome-trace=FILE] <file>" << endl;
 }
 
 int main(int argc, char* argv[])
 {
-    if (argc != 2)
+    bool v1 = false;
+    bool compress = false;
+    bool edgebreaker = false;
+    // Store the order of the mesh with --edgebreaker, so it unpacks to
+    // exactly the same mesh.
+    bool keep_order = false;
+    int block_size = DEFAULT_BLOCK_SIZE;
+    int threads = 0;
+    string filename;
+    for (int i = 1; i < argc; i++)
     {
-        cerr << "usage: " << argv[0] << " <file>" << endl;
+        const string arg = argv[i];
+        if (arg == "--v1")
+        {
+            v1 = true;
+        }
+        else if (arg == "--compress")
+        {
+            compress = true;
+        }
+        else if (arg == "--edgebreaker")
+        {
+            edgebreaker = true;
+        }
+        else if (arg == "--keep-order")
+        {
+            keep_order = true;
+        }
+        else if (arg.compare(0, 13, "--block-size=") == 0)
+        {
+            block_size = atoi(arg.c_str() + 13);
+            if (block_size < 1)
+            {
+                cerr << "Block size must be positive" << endl;
+                return 1;
+            }
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (filename.empty() && arg.compare(0, 2, "--") != 0)
+        {
+            filename = arg;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filename.empty() || v1 + compress + edgebreaker > 1 ||
+        (keep_order && !edgebreaker))
+    {
+        print_usage(argv[0]);
         return 1;
     }
-    string filename = argv[1];
     ifstream meshfile(filename);
     if (!meshfile.is_open())
     {
@@ -31,22 +113,79 @@ int main(int argc, char* argv[])
         cerr << "Unable to open file" << endl;
         return 1;
     }
-    string header;
-    if (!(meshfile >> header))
+    if (v1)
     {
-        cerr << "No header!" << endl;
-        return 1;
+        string header;
+        if (!(meshfile >> header))
+        {
+            cerr << "No header!" << endl;
+            return 1;
+        }
+        if (header != "mesh")
+        {
+            cerr << "Header is not mesh!" << endl;
+            return 1;
+        }
+        {
+            StatsPhase phase("pack");
+            pack_v1(meshfile, packedfile);
+        }
+        return finish(argv[0]);
     }
-    if (header != "mesh")
+    // Keep the coordinates exact, and allow anything the packed formats can
+    // store.
+    TextMeshOptions options;
+    options.min_version = 1;
+    options.min_vertex_polygons = 0;
+    options.exact = true;
+    options.threads = threads;
+    ExactMesh mesh;
+    string error;
     {
-        cerr << "Header is not mesh!" << endl;
-        return 1;
+        StatsPhase phase("read");
+        if (!read_text_mesh(filename, options, mesh, error))
+        {
+            fail("Error reading mesh (" + error + ")");
+        }
     }
-    int temp;
-    packedfile.write("pack", 4);
-    while (meshfile >> temp)
+    // The packed formats also need lists to be no longer than this.
+    const NavMesh& navmesh = mesh.mesh;
+    for (int i = 0; i < navmesh.num_vertices(); i++)
     {
-        print_int(temp, packedfile);
+        if (navmesh.vertex_offsets[i+1] - navmesh.vertex_offsets[i] >
+            navmesh.num_polygons())
+        {
+            fail("Number out of range in mesh");
+        }
     }
-    return 0;
+    for (int i = 0; i < navmesh.num_polygons(); i++)
+    {
+        if (navmesh.polygon_offsets[i+1] - navmesh.polygon_offsets[i] >
+            navmesh.num_vertices())
+        {
+            fail("Number out of range in mesh");
+        }
+    }
+    {
+        StatsPhase phase("pack");
+        if (edgebreaker)
+        {
+            string packed;
+            if (!encode_edgebreaker(mesh, packed, error, keep_order))
+            {
+                fail("Can't pack with --edgebreaker (" + error + "), try "
+                     "--compress instead");
+            }
+            packedfile << packed;
+        }
+        else if (compress)
+        {
+            write_compressed_mesh(mesh, block_size, threads, packedfile);
+        }
+        else
+        {
+            pack_v2(mesh, packedfile);
+        }
+    }
+    return finish(argv[0]);
 }
@@ -0,0 +1,209 @@
+// Answers line of sight (or with --raycast, raycast) queries on a mesh.
+// Takes the mesh file as an argument and the queries from stdin, one per
+// line, and prints the answers to stdout in the same order.
+// --sample=N instead checks N random lines between points in the mesh, to
+// see how much can be seen and how fast.
+#include <stdlib.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include "raycast.h"
+#include "textmesh.h"
+#include "stats.h"
+using namespace std;
+using namespace meshutils;
+
+bool raycast = false;
+int sample = 0;
+int threads = 0;
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--raycast] [--sample=N] [--threads=N] "
+         << "[--stats=json] [--chrome-trace=FILE] <mesh file>" << endl;
+}
+
+// A random point in a random polygon.
+void random_point(const NavMesh& mesh, mt19937& random, double& x,
+                  double& y)
+{
+    const int p = random() % mesh.num_polygons();
+    const int begin = mesh.polygon_offsets[p];
+    const int n = mesh.polygon_offsets[p+1] - begin;
+    // Somewhere between three of its vertices. Polygons are convex, so that
+    // is in the polygon.
+    uniform_real_distribution<double> unit(0, 1);
+    double a = unit(random);
+    double b = unit(random);
+    if (a + b > 1)
+    {
+        a = 1 - a;
+        b = 1 - b;
+    }
+    const int i = random() % n;
+    const int u = mesh.polygon_vertices[begin + i];
+    const int v = mesh.polygon_vertices[begin + (i + 1) % n];
+    const int w = mesh.polygon_vertices[begin + (i + 2) % n];
+    x = mesh.vertex_xy[2*u] + a * (mesh.vertex_xy[2*v] - mesh.vertex_xy[2*u]) +
+        b * (mesh.vertex_xy[2*w] - mesh.vertex_xy[2*u]);
+    y = mesh.vertex_xy[2*u+1] +
+        a * (mesh.vertex_xy[2*v+1] - mesh.vertex_xy[2*u+1]) +
+        b * (mesh.vertex_xy[2*w+1] - mesh.vertex_xy[2*u+1]);
+}
+
+// Line of sight prints 1 or 0. Raycasts print where they hit.
+void write_answers(const vector<double>& queries, const vector<char>& visible,
+                   const vector<double>& hits)
+{
+    const int n = queries.size() / 4;
+    write_chunks(n, threads, [&](int begin, int end, TextBuffer& out)
+    {
+        for (int i = begin; i < end; i++)
+        {
+            if (raycast)
+            {
+                const double* q = &queries[4*i];
+                out.put_double(q[0] + hits[i] * q[2]);
+                out.put(' ');
+                out.put_double(q[1] + hits[i] * q[3]);
+            }
+            else
+            {
+                out.put(visible[i] ? '1' : '0');
+            }
+            out.put('\n');
+        }
+    }, cout);
+}
+
+int main(int argc, char* argv[])
+{
+    string filename;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg == "--raycast")
+        {
+            raycast = true;
+        }
+        else if (arg.compare(0, 9, "--sample=") == 0)
+        {
+            sample = atoi(arg.c_str() + 9);
+            if (sample < 1)
+            {
+                cerr << "Sample size must be positive" << endl;
+                return 1;
+            }
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (filename.empty() && arg.compare(0, 2, "--") != 0)
+        {
+            filename = arg;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filename.empty() || (raycast && sample > 0))
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    string error;
+    ExactMesh mesh;
+    TextMeshOptions options;
+    options.threads = threads;
+    {
+        StatsPhase phase("read");
+        if (!read_text_mesh(filename, options, mesh, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+    }
+    if (mesh.mesh.num_polygons() == 0)
+    {
+        cerr << "The mesh has no polygons" << endl;
+        return 1;
+    }
+    RayCaster rays;
+    {
+        StatsPhase phase("build");
+        rays.build(mesh.mesh);
+    }
+
+    // ax, ay, bx, by (or x, y, dx, dy) for each query.
+    vector<double> queries;
+    if (sample > 0)
+    {
+        mt19937 random;
+        queries.resize(4 * sample);
+        for (int i = 0; i < sample; i++)
+        {
+            random_point(mesh.mesh, random, queries[4*i], queries[4*i+1]);
+            random_point(mesh.mesh, random, queries[4*i+2], queries[4*i+3]);
+        }
+    }
+    else
+    {
+        StatsPhase phase("read queries");
+        if (!read_numbers(cin, queries) || queries.size() % 4 != 0)
+        {
+            cerr << "Expecting four numbers per query on stdin" << endl;
+            return 1;
+        }
+    }
+    const int n = queries.size() / 4;
+
+    const auto start = chrono::steady_clock::now();
+    vector<char> visible;
+    vector<double> hits;
+    if (raycast)
+    {
+        StatsPhase phase("raycast");
+        hits.resize(n);
+        rays.raycast_batch(queries.data(), n, hits.data(), threads);
+    }
+    else
+    {
+        StatsPhase phase("line of sight");
+        visible.resize(n);
+        rays.line_of_sight_batch(queries.data(), n, visible.data(), threads);
+    }
+    const chrono::duration<double> seconds =
+        chrono::steady_clock::now() - start;
+
+    if (sample > 0)
+    {
+        int count = 0;
+        for (char v : visible)
+        {
+            count += v;
+        }
+        cerr << "lines;visible;seconds;lines per second" << endl;
+        cerr << n << ";" << count << ";" << seconds.count() << ";"
+             << n / seconds.count() << endl;
+    }
+    else
+    {
+        StatsPhase phase("write");
+        write_answers(queries, visible, hits);
+    }
+    if (!write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return 0;
+}
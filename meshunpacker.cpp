@@ -1,27 +1,132 @@
 #include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
 #include <iostream>
 #include <fstream>
+#include <iterator>
 #include <string.h>
+#include "pack.h"
+#include "compress.h"
+#include "edgebreaker.h"
+#include "stats.h"
 using namespace std;
-typedef unsigned char uchar;
+using namespace meshutils;
 typedef char bint[4];
 
-const uint32_t magic = 0xffffff;
+void fail(const string& message)
+{
+    cerr << message << endl;
+    exit(1);
+}
+
+// Prints and writes what --stats and --chrome-trace asked for.
+int finish(const char* name)
+{
+    string error;
+    if (!write_stats(name, error))
+    {
+        fail(error);
+    }
+    return 0;
+}
 
-uint32_t remove_b(bint n)
+// The shortest way of writing x which reads back as exactly x.
+string format_double(double x)
 {
-    return uint32_t((uchar)(n[0]) << 16 |
-                    (uchar)(n[1]) << 8  | (uchar)(n[2]) << 0);
+    char buffer[32];
+    for (int precision = 15; precision <= 17; precision++)
+    {
+        snprintf(buffer, sizeof(buffer), "%.*g", precision, x);
+        if (strtod(buffer, nullptr) == x)
+        {
+            break;
+        }
+    }
+    return buffer;
+}
+
+void print_text_mesh(const ExactMesh& in, ostream& meshfile)
+{
+    const NavMesh& mesh = in.mesh;
+    meshfile << "mesh\n" << in.version << "\n" << mesh.num_vertices() << " "
+             << mesh.num_polygons() << "\n";
+    for (int i = 0; i < mesh.num_vertices(); i++)
+    {
+        for (int j = 2*i; j < 2*i + 2; j++)
+        {
+            if (in.fixed_point)
+            {
+                meshfile << format_fixed(in.fixed_xy[j], in.scale);
+            }
+            else
+            {
+                meshfile << format_double(mesh.vertex_xy[j]);
+            }
+            meshfile << " ";
+        }
+        const int start = mesh.vertex_offsets[i];
+        const int end = mesh.vertex_offsets[i+1];
+        meshfile << end - start;
+        for (int j = start; j < end; j++)
+        {
+            meshfile << " " << mesh.vertex_polygons[j];
+        }
+        meshfile << "\n";
+    }
+    for (int i = 0; i < mesh.num_polygons(); i++)
+    {
+        const int start = mesh.polygon_offsets[i];
+        const int end = mesh.polygon_offsets[i+1];
+        meshfile << end - start;
+        for (int j = start; j < end; j++)
+        {
+            meshfile << " " << mesh.polygon_vertices[j];
+        }
+        for (int j = start; j < end; j++)
+        {
+            meshfile << " " << mesh.polygon_neighbours[j];
+        }
+        meshfile << "\n";
+    }
+}
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--threads=N] [--stats=json] "
+         << "[--chrome-trace=FILE] <file>" << endl;
 }
 
 int main(int argc, char* argv[])
 {
-    if (argc != 2)
+    // Threads to decompress compressed meshes with, 0 for one per core.
+    int threads = 0;
+    string filename;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 10, "--threads=") == 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (filename.empty() && arg.compare(0, 2, "--") != 0)
+        {
+            filename = arg;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filename.empty())
     {
-        cerr << "usage: " << argv[0] << " <file>" << endl;
+        print_usage(argv[0]);
         return 1;
     }
-    string filename = argv[1];
     ifstream packedfile(filename, ios::in | ios::binary);
     if (!packedfile.is_open())
     {
@@ -42,24 +147,61 @@ int main(int argc, char* argv[])
         cerr << "Can't get 4 bytes?" << endl;
         return 1;
     }
-    if (strncmp(x, "pack", 4) != 0)
+    if (strncmp(x, "pack", 4) == 0)
     {
-        cerr << "Header is not pack" << endl;
+        {
+            StatsPhase phase("unpack");
+            unpack_v1(packedfile, meshfile);
+        }
+        return finish(argv[0]);
+    }
+    if (strncmp(x, "pak2", 4) != 0 && strncmp(x, "pakz", 4) != 0 &&
+        strncmp(x, "pakt", 4) != 0)
+    {
+        cerr << "Header is not pack, pak2, pakz or pakt" << endl;
         return 1;
     }
-    meshfile << "mesh" << endl;
-    uint32_t temp;
-    while (packedfile.read(x, 3))
+
+    packedfile.seekg(0);
+    string data;
     {
-        temp = remove_b(x);
-        if (temp == magic)
+        StatsPhase phase("read");
+        data.assign(istreambuf_iterator<char>(packedfile),
+                    istreambuf_iterator<char>());
+    }
+    ExactMesh mesh;
+    {
+        StatsPhase phase("unpack");
+        if (strncmp(x, "pak2", 4) == 0)
+        {
+            string error;
+            if (!unpack_v2(data, mesh, error))
+            {
+                fail("Error reading packed mesh (" + error + ")");
+            }
+        }
+        else if (strncmp(x, "pakt", 4) == 0)
         {
-            meshfile << "-1" << "\n";
+            string error;
+            if (!decode_edgebreaker(data, mesh, error))
+            {
+                fail("Error reading packed mesh (" + error + ")");
+            }
         }
         else
         {
-            meshfile << temp << "\n";
+            CompressedMesh compressed;
+            string error;
+            if (!compressed.open(data, error) ||
+                !compressed.decode(mesh, threads, error))
+            {
+                fail("Error reading packed mesh (" + error + ")");
+            }
         }
     }
-    return 0;
+    {
+        StatsPhase phase("write");
+        print_text_mesh(mesh, meshfile);
+    }
+    return finish(argv[0]);
 }
@@ -0,0 +1,336 @@
+#include "binmesh.h"
+#include <string.h>
+#include <climits>
+#include <fstream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace meshutils
+{
+
+namespace
+{
+
+const size_t HEADER_SIZE = 64;
+const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+const uint64_t FNV_PRIME = 1099511628211ULL;
+
+// Where each array starts in the file.
+struct Layout
+{
+    size_t vertex_xy;
+    size_t vertex_offsets;
+    size_t vertex_polygons;
+    size_t polygon_offsets;
+    size_t polygon_vertices;
+    size_t polygon_neighbours;
+    size_t total;
+};
+
+size_t align(size_t n)
+{
+    return (n + 7) & ~size_t(7);
+}
+
+Layout get_layout(uint64_t V, uint64_t P,
+                  uint64_t num_vertex_polygons, uint64_t num_polygon_vertices)
+{
+    Layout out;
+    out.vertex_xy = HEADER_SIZE;
+    out.vertex_offsets = align(out.vertex_xy + 16 * V);
+    out.vertex_polygons = align(out.vertex_offsets + 4 * (V + 1));
+    out.polygon_offsets = align(out.vertex_polygons + 4 * num_vertex_polygons);
+    out.polygon_vertices = align(out.polygon_offsets + 4 * (P + 1));
+    out.polygon_neighbours = align(out.polygon_vertices +
+                                   4 * num_polygon_vertices);
+    out.total = align(out.polygon_neighbours + 4 * num_polygon_vertices);
+    return out;
+}
+
+template <typename T>
+void put(vector<char>& buffer, size_t offset, T value)
+{
+    memcpy(&buffer[offset], &value, sizeof(T));
+}
+
+template <typename T>
+T get(const char* data, size_t offset)
+{
+    T out;
+    memcpy(&out, data + offset, sizeof(T));
+    return out;
+}
+
+}
+
+bool is_little_endian()
+{
+    const uint16_t one = 1;
+    unsigned char first;
+    memcpy(&first, &one, 1);
+    return first == 1;
+}
+
+uint64_t checksum(const char* data, size_t size)
+{
+    uint64_t out = FNV_OFFSET;
+    for (size_t i = 0; i < size; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, data + i, 8);
+        out = (out ^ word) * FNV_PRIME;
+    }
+    return out;
+}
+
+bool map_file(const string& filename, void*& data, size_t& size,
+              string& error)
+{
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        error = "Unable to open file";
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || info.st_size == 0)
+    {
+        ::close(fd);
+        error = "File is empty";
+        return false;
+    }
+    size = info.st_size;
+    data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        data = nullptr;
+        size = 0;
+        error = "Unable to mmap file";
+        return false;
+    }
+    return true;
+}
+
+bool write_binary_mesh(const NavMesh& mesh, ostream& outfile, string& error)
+{
+    if (!is_little_endian())
+    {
+        error = "Binary meshes can only be written on little-endian hosts";
+        return false;
+    }
+    const uint64_t V = mesh.num_vertices();
+    const uint64_t P = mesh.num_polygons();
+    const uint64_t num_vertex_polygons = mesh.vertex_polygons.size();
+    const uint64_t num_polygon_vertices = mesh.polygon_vertices.size();
+    const Layout layout = get_layout(V, P, num_vertex_polygons,
+                                     num_polygon_vertices);
+
+    // Zero-filled so the padding is zeroed too.
+    vector<char> buffer(layout.total, 0);
+    #define COPY(offset, vec) \
+        if (!(vec).empty()) \
+        { \
+            memcpy(&buffer[offset], (vec).data(), \
+                   (vec).size() * sizeof((vec)[0])); \
+        }
+    COPY(layout.vertex_xy, mesh.vertex_xy);
+    COPY(layout.vertex_offsets, mesh.vertex_offsets);
+    COPY(layout.vertex_polygons, mesh.vertex_polygons);
+    COPY(layout.polygon_offsets, mesh.polygon_offsets);
+    COPY(layout.polygon_vertices, mesh.polygon_vertices);
+    COPY(layout.polygon_neighbours, mesh.polygon_neighbours);
+    #undef COPY
+
+    memcpy(&buffer[0], "mesh", 4);
+    put<uint32_t>(buffer, 4, BINARY_FORMAT_VERSION);
+    put<uint32_t>(buffer, 8, V);
+    put<uint32_t>(buffer, 12, P);
+    put<uint64_t>(buffer, 16, num_vertex_polygons);
+    put<uint64_t>(buffer, 24, num_polygon_vertices);
+    put<uint64_t>(buffer, 32, checksum(&buffer[HEADER_SIZE],
+                                       layout.total - HEADER_SIZE));
+    put<uint64_t>(buffer, 40, layout.total);
+
+    outfile.write(&buffer[0], buffer.size());
+    return true;
+}
+
+MappedMesh::MappedMesh()
+    : num_vertices(0), num_polygons(0),
+      vertex_xy(nullptr), vertex_offsets(nullptr), vertex_polygons(nullptr),
+      polygon_offsets(nullptr), polygon_vertices(nullptr),
+      polygon_neighbours(nullptr), data(nullptr), size(0)
+{
+}
+
+MappedMesh::~MappedMesh()
+{
+    close();
+}
+
+void MappedMesh::close()
+{
+    if (data != nullptr)
+    {
+        munmap(data, size);
+    }
+    data = nullptr;
+    size = 0;
+    num_vertices = num_polygons = 0;
+    vertex_xy = nullptr;
+    vertex_offsets = polygon_offsets = nullptr;
+    vertex_polygons = polygon_vertices = polygon_neighbours = nullptr;
+}
+
+bool is_binary_mesh(const string& filename)
+{
+    ifstream infile(filename, ios::binary);
+    char header[8];
+    if (!infile.read(header, sizeof(header)))
+    {
+        return false;
+    }
+    // A text mesh has whitespace and a version number after "mesh".
+    return memcmp(header, "mesh", 4) == 0 &&
+           get<uint32_t>(header, 4) == (uint32_t) BINARY_FORMAT_VERSION;
+}
+
+bool MappedMesh::open(const string& filename, string& error,
+                      bool verify_checksum, bool check_indices)
+{
+    close();
+    if (!is_little_endian())
+    {
+        error = "Binary meshes can only be read on little-endian hosts";
+        return false;
+    }
+
+    if (!map_file(filename, data, size, error))
+    {
+        return false;
+    }
+
+    const char* bytes = static_cast<const char*>(data);
+    #define REJECT(message) { error = message; close(); return false; }
+    if (size < HEADER_SIZE)
+    {
+        REJECT("File is too small to be a binary mesh");
+    }
+    if (memcmp(bytes, "mesh", 4) != 0)
+    {
+        REJECT("Invalid header (expecting 'mesh')");
+    }
+    if (get<uint32_t>(bytes, 4) != (uint32_t) BINARY_FORMAT_VERSION)
+    {
+        REJECT("Invalid version (expecting 3)");
+    }
+    const uint64_t V = get<uint32_t>(bytes, 8);
+    const uint64_t P = get<uint32_t>(bytes, 12);
+    const uint64_t num_vertex_polygons = get<uint64_t>(bytes, 16);
+    const uint64_t num_polygon_vertices = get<uint64_t>(bytes, 24);
+    if (V < 1 || V > INT_MAX || P < 1 || P > INT_MAX ||
+        num_vertex_polygons > UINT32_MAX || num_polygon_vertices > UINT32_MAX)
+    {
+        REJECT("Invalid number of vertices or polygons");
+    }
+    const Layout layout = get_layout(V, P, num_vertex_polygons,
+                                     num_polygon_vertices);
+    if (get<uint64_t>(bytes, 40) != layout.total || size != layout.total)
+    {
+        REJECT("File size does not match header");
+    }
+    if (verify_checksum &&
+        get<uint64_t>(bytes, 32) != checksum(bytes + HEADER_SIZE,
+                                             size - HEADER_SIZE))
+    {
+        REJECT("Checksum does not match");
+    }
+
+    // mmap gives us page-aligned memory, and every array is 8-byte aligned in
+    // the file, so we can point straight into it.
+    num_vertices = V;
+    num_polygons = P;
+    vertex_xy = reinterpret_cast<const double*>(bytes + layout.vertex_xy);
+    vertex_offsets = reinterpret_cast<const uint32_t*>(
+        bytes + layout.vertex_offsets);
+    vertex_polygons = reinterpret_cast<const int32_t*>(
+        bytes + layout.vertex_polygons);
+    polygon_offsets = reinterpret_cast<const uint32_t*>(
+        bytes + layout.polygon_offsets);
+    polygon_vertices = reinterpret_cast<const int32_t*>(
+        bytes + layout.polygon_vertices);
+    polygon_neighbours = reinterpret_cast<const int32_t*>(
+        bytes + layout.polygon_neighbours);
+
+    if (vertex_offsets[0] != 0 || vertex_offsets[V] != num_vertex_polygons ||
+        polygon_offsets[0] != 0 || polygon_offsets[P] != num_polygon_vertices)
+    {
+        REJECT("Offsets do not match header");
+    }
+    // With the ends right, offsets which never go down stay in range.
+    for (uint64_t i = 0; i < V; i++)
+    {
+        if (vertex_offsets[i] > vertex_offsets[i+1])
+        {
+            REJECT("Vertex offsets go down at vertex " + to_string(i));
+        }
+    }
+    for (uint64_t i = 0; i < P; i++)
+    {
+        if (polygon_offsets[i] > polygon_offsets[i+1])
+        {
+            REJECT("Polygon offsets go down at polygon " + to_string(i));
+        }
+    }
+
+    if (check_indices)
+    {
+        const int32_t max_vertex = V - 1;
+        const int32_t max_polygon = P - 1;
+        for (uint64_t i = 0; i < num_vertex_polygons; i++)
+        {
+            if (vertex_polygons[i] < -1 || vertex_polygons[i] > max_polygon)
+            {
+                REJECT("Invalid polygon index " +
+                       to_string(vertex_polygons[i]) + " around a vertex");
+            }
+        }
+        for (uint64_t i = 0; i < num_polygon_vertices; i++)
+        {
+            if (polygon_vertices[i] < 0 || polygon_vertices[i] > max_vertex)
+            {
+                REJECT("Invalid vertex index " +
+                       to_string(polygon_vertices[i]) + " in a polygon");
+            }
+            if (polygon_neighbours[i] < -1 ||
+                polygon_neighbours[i] > max_polygon)
+            {
+                REJECT("Invalid polygon index " +
+                       to_string(polygon_neighbours[i]) + " in a polygon");
+            }
+        }
+    }
+    #undef REJECT
+    return true;
+}
+
+void MappedMesh::copy_to(NavMesh& out) const
+{
+    out.vertex_xy.assign(vertex_xy, vertex_xy + 2 * num_vertices);
+    out.vertex_offsets.assign(vertex_offsets,
+                              vertex_offsets + num_vertices + 1);
+    out.vertex_polygons.assign(vertex_polygons,
+                               vertex_polygons + vertex_offsets[num_vertices]);
+    out.polygon_offsets.assign(polygon_offsets,
+                               polygon_offsets + num_polygons + 1);
+    const uint32_t num_polygon_vertices = polygon_offsets[num_polygons];
+    out.polygon_vertices.assign(polygon_vertices,
+                                polygon_vertices + num_polygon_vertices);
+    out.polygon_neighbours.assign(polygon_neighbours,
+                                  polygon_neighbours + num_polygon_vertices);
+}
+
+}
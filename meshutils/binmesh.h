@@ -0,0 +1,74 @@
+#pragma once
+#include "navmesh.h"
+#include <stdint.h>
+#include <stddef.h>
+#include <iostream>
+#include <string>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Binary mesh format version 3. See spec/mesh/3.txt.
+const int BINARY_FORMAT_VERSION = 3;
+
+// Returns false and sets error (writing nothing) if it can't, as the format
+// is little-endian and this host isn't.
+bool write_binary_mesh(const NavMesh& mesh, ostream& outfile, string& error);
+
+// Helpers for binary formats, which are all little-endian.
+bool is_little_endian();
+// 64-bit FNV-1a, but on 8-byte words instead of bytes so it's fast.
+// data must be 8-byte aligned and size must be a multiple of 8.
+uint64_t checksum(const char* data, size_t size);
+// mmaps a whole file read-only. Returns false and sets error if it can't
+// (including if it is empty, which can't be mapped).
+bool map_file(const string& filename, void*& data, size_t& size,
+              string& error);
+
+// Whether the file starts with a binary mesh header, rather than a text one.
+// Returns false if the file can't be read.
+bool is_binary_mesh(const string& filename);
+
+// A binary mesh which has been mmapped from a file.
+// None of the arrays are copied or parsed, so they are only valid while this
+// is open.
+class MappedMesh
+{
+public:
+    int num_vertices;
+    int num_polygons;
+
+    // Laid out the same way as in NavMesh.
+    const double* vertex_xy;
+    const uint32_t* vertex_offsets;
+    const int32_t* vertex_polygons;
+    const uint32_t* polygon_offsets;
+    const int32_t* polygon_vertices;
+    const int32_t* polygon_neighbours;
+
+    MappedMesh();
+    ~MappedMesh();
+
+    // Maps the file and checks its header, sizes, offsets and (if asked to)
+    // checksum and that every index is in range.
+    // The offsets are always checked, so every slice is inside its array.
+    // Without check_indices, indices can be anything, for meshcheck to find.
+    // Returns false and sets error if the file is not a valid binary mesh.
+    bool open(const string& filename, string& error,
+              bool verify_checksum = true, bool check_indices = true);
+    void close();
+
+    // Copies the arrays into out.
+    void copy_to(NavMesh& out) const;
+
+private:
+    void* data;
+    size_t size;
+
+    MappedMesh(const MappedMesh&);
+    MappedMesh& operator=(const MappedMesh&);
+};
+
+}
@@ -0,0 +1,309 @@
+#include "cache.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace meshutils
+{
+
+namespace
+{
+
+const uint32_t ROUND_CONSTANTS[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+inline uint32_t rotr(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+bool read_file(const string& filename, string& out)
+{
+    ifstream infile(filename, ios::binary);
+    if (!infile.is_open())
+    {
+        return false;
+    }
+    out.assign(istreambuf_iterator<char>(infile), istreambuf_iterator<char>());
+    return !infile.bad();
+}
+
+// Writes the file under another name and renames it, so anyone reading the
+// cache at the same time sees all of it or none of it.
+bool write_file(const string& filename, const string& data)
+{
+    const string temp = filename + ".tmp" + to_string(getpid());
+    {
+        ofstream outfile(temp, ios::binary);
+        if (!(outfile << data) || !outfile.flush())
+        {
+            remove(temp.c_str());
+            return false;
+        }
+    }
+    if (rename(temp.c_str(), filename.c_str()) != 0)
+    {
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+}
+
+Sha256::Sha256() : block_size(0), total_size(0)
+{
+    const uint32_t initial[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f,
+        0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+    };
+    copy(initial, initial + 8, state);
+}
+
+void Sha256::compress()
+{
+    uint32_t w[64];
+    for (int i = 0; i < 16; i++)
+    {
+        w[i] = (uint32_t) block[4*i] << 24 | (uint32_t) block[4*i+1] << 16 |
+               (uint32_t) block[4*i+2] << 8 | block[4*i+3];
+    }
+    for (int i = 16; i < 64; i++)
+    {
+        const uint32_t s0 = rotr(w[i-15], 7) ^ rotr(w[i-15], 18) ^
+                            (w[i-15] >> 3);
+        const uint32_t s1 = rotr(w[i-2], 17) ^ rotr(w[i-2], 19) ^
+                            (w[i-2] >> 10);
+        w[i] = w[i-16] + s0 + w[i-7] + s1;
+    }
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+    for (int i = 0; i < 64; i++)
+    {
+        const uint32_t s1 = rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25);
+        const uint32_t ch = (e & f) ^ (~e & g);
+        const uint32_t t1 = h + s1 + ch + ROUND_CONSTANTS[i] + w[i];
+        const uint32_t s0 = rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22);
+        const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        const uint32_t t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+    state[4] += e;
+    state[5] += f;
+    state[6] += g;
+    state[7] += h;
+}
+
+void Sha256::update(const char* data, size_t size)
+{
+    total_size += size;
+    for (size_t i = 0; i < size; i++)
+    {
+        block[block_size++] = data[i];
+        if (block_size == 64)
+        {
+            compress();
+            block_size = 0;
+        }
+    }
+}
+
+string Sha256::hex_digest()
+{
+    const unsigned long long bits = total_size * 8;
+    block[block_size++] = 0x80;
+    if (block_size > 56)
+    {
+        fill(block + block_size, block + 64, 0);
+        compress();
+        block_size = 0;
+    }
+    fill(block + block_size, block + 56, 0);
+    for (int i = 0; i < 8; i++)
+    {
+        block[56 + i] = bits >> (56 - 8 * i);
+    }
+    compress();
+
+    const char* digits = "0123456789abcdef";
+    string out;
+    for (uint32_t word : state)
+    {
+        for (int shift = 28; shift >= 0; shift -= 4)
+        {
+            out.push_back(digits[(word >> shift) & 15]);
+        }
+    }
+    return out;
+}
+
+// Sends everything written to a stream to where it was going anyway, and
+// keeps a copy.
+class ToolCache::Capture : public streambuf
+{
+public:
+    string text;
+
+    Capture(ostream& stream) : stream(stream), original(stream.rdbuf(this))
+    {
+    }
+    ~Capture()
+    {
+        stream.rdbuf(original);
+    }
+
+protected:
+    int overflow(int c) override
+    {
+        if (c == EOF)
+        {
+            return 0;
+        }
+        text.push_back(c);
+        return original->sputc(c);
+    }
+    streamsize xsputn(const char* s, streamsize n) override
+    {
+        text.append(s, n);
+        return original->sputn(s, n);
+    }
+    int sync() override
+    {
+        return original->pubsync();
+    }
+
+private:
+    ostream& stream;
+    streambuf* original;
+};
+
+ToolCache::ToolCache(const string& folder, const vector<string>& options)
+    : folder(folder), captured_out(nullptr), captured_err(nullptr)
+{
+    if (folder.empty())
+    {
+        return;
+    }
+    // Hash the tool itself, so rebuilding it starts afresh.
+    string tool;
+    read_file("/proc/self/exe", tool);
+    hash.update("toolcache 1\n");
+    hash.update(to_string(tool.size()) + ":");
+    hash.update(tool);
+    for (const string& option : options)
+    {
+        // The size first, so the options can't run into each other.
+        hash.update(to_string(option.size()) + ":" + option);
+    }
+}
+
+ToolCache::~ToolCache()
+{
+    delete captured_out;
+    delete captured_err;
+}
+
+void ToolCache::add_file(const string& filename)
+{
+    if (folder.empty())
+    {
+        return;
+    }
+    string contents;
+    read_file(filename, contents);
+    hash.update(to_string(contents.size()) + ":");
+    hash.update(contents);
+}
+
+bool ToolCache::replay()
+{
+    if (folder.empty())
+    {
+        return false;
+    }
+    // cin goes through stdio one character at a time, so skip it.
+    string contents;
+    char buffer[1 << 16];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), stdin)) > 0)
+    {
+        contents.append(buffer, size);
+    }
+    hash.update(to_string(contents.size()) + ":");
+    hash.update(contents);
+    stdin_copy.str(contents);
+
+    // Spread the results over 256 folders, like git does.
+    const string name = hash.hex_digest();
+    const string subfolder = folder + "/" + name.substr(0, 2);
+    path = subfolder + "/" + name.substr(2);
+
+    string out, err;
+    if (read_file(path, out) && read_file(path + ".err", err))
+    {
+        cout.write(out.data(), out.size());
+        cerr.write(err.data(), err.size());
+        return true;
+    }
+    mkdir(folder.c_str(), 0777);
+    mkdir(subfolder.c_str(), 0777);
+    captured_out = new Capture(cout);
+    captured_err = new Capture(cerr);
+    return false;
+}
+
+void ToolCache::store()
+{
+    if (captured_out == nullptr)
+    {
+        return;
+    }
+    cout.flush();
+    // .err goes first, as replay looks for the output first.
+    // It doesn't matter if this fails, we just don't get a hit next time.
+    if (write_file(path + ".err", captured_err->text))
+    {
+        write_file(path, captured_out->text);
+    }
+    delete captured_out;
+    delete captured_err;
+    captured_out = nullptr;
+    captured_err = nullptr;
+}
+
+bool parse_cache_arg(const string& arg, string& folder)
+{
+    if (arg.compare(0, 8, "--cache=") != 0 || arg.size() == 8)
+    {
+        return false;
+    }
+    folder = arg.substr(8);
+    return true;
+}
+
+}
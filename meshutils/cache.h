@@ -0,0 +1,84 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// SHA-256, for naming things by their contents.
+class Sha256
+{
+public:
+    Sha256();
+    void update(const char* data, size_t size);
+    void update(const string& data)
+    {
+        update(data.data(), data.size());
+    }
+    // The hash of everything so far, in hex. Can only be called once.
+    string hex_digest();
+
+private:
+    uint32_t state[8];
+    unsigned char block[64];
+    size_t block_size;
+    unsigned long long total_size;
+
+    void compress();
+};
+
+// Remembers what a tool printed for a given input, so running it again on
+// the same input can just print that instead.
+// Results are stored in a folder, named by the SHA-256 of the tool's own
+// executable, the options it was given and everything it read. Rebuilding
+// the tool or changing anything it reads gives a new name, so nothing in the
+// folder ever needs to be invalidated. Old results can be deleted at any
+// time.
+// Only stdout and stderr are stored, so this is for tools which read
+// everything they need from stdin (and any files added with add_file).
+// With no folder it does nothing, and input() is just cin.
+class ToolCache
+{
+public:
+    // options are the arguments which change what the tool prints.
+    ToolCache(const string& folder, const vector<string>& options);
+    ~ToolCache();
+    ToolCache(const ToolCache&) = delete;
+    ToolCache& operator=(const ToolCache&) = delete;
+
+    // Adds the contents of a file the tool reads to the name.
+    void add_file(const string& filename);
+
+    // Reads all of stdin, which the tool should then read from input().
+    // If there is a result for it, prints it and returns true. Otherwise
+    // starts capturing what is printed to cout and cerr.
+    bool replay();
+    istream& input()
+    {
+        return folder.empty() ? cin : stdin_copy;
+    }
+
+    // Stores what was captured. Call this once the tool has succeeded.
+    void store();
+
+private:
+    class Capture;
+
+    string folder;
+    Sha256 hash;
+    string path;
+    istringstream stdin_copy;
+    Capture* captured_out;
+    Capture* captured_err;
+};
+
+// Gets the cache folder out of --cache=FOLDER. Returns false if arg isn't
+// that.
+bool parse_cache_arg(const string& arg, string& folder);
+
+}
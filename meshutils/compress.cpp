@@ -0,0 +1,630 @@
+#include "compress.h"
+#include "parallel.h"
+#include <string.h>
+#include <cmath>
+
+namespace meshutils
+{
+
+namespace
+{
+
+// rANS with a 32-bit state and byte-wise output, as described in
+// "Interleaved entropy coders" (Giesen, 2014).
+const int PROB_BITS = 12;
+const uint32_t PROB_SCALE = 1 << PROB_BITS;
+const uint32_t RANS_L = 1 << 23;
+
+enum BlockMethod
+{
+    // Stored as is, as rANS didn't make it any smaller.
+    METHOD_STORED,
+    METHOD_RANS
+};
+
+// Scales counts so they sum to PROB_SCALE, while keeping every symbol which
+// appears at least 1.
+void normalise(const uint64_t counts[256], uint64_t total, uint32_t freqs[256])
+{
+    uint32_t sum = 0;
+    int biggest = 0;
+    for (int s = 0; s < 256; s++)
+    {
+        freqs[s] = 0;
+        if (counts[s] != 0)
+        {
+            freqs[s] = max<uint64_t>(1, counts[s] * PROB_SCALE / total);
+        }
+        sum += freqs[s];
+        if (freqs[s] > freqs[biggest])
+        {
+            biggest = s;
+        }
+    }
+    // Rounding leaves us a bit off, so take it from (or give it to) the
+    // biggest symbols as it'll matter the least there.
+    while (sum > PROB_SCALE)
+    {
+        int s = 0;
+        for (int i = 1; i < 256; i++)
+        {
+            if (freqs[i] > freqs[s])
+            {
+                s = i;
+            }
+        }
+        freqs[s]--;
+        sum--;
+    }
+    freqs[biggest] += PROB_SCALE - sum;
+}
+
+}
+
+void entropy_encode(const string& in, string& out)
+{
+    write_varint(in.size(), out);
+    uint64_t counts[256] = {};
+    for (char c : in)
+    {
+        counts[(unsigned char) c]++;
+    }
+    string encoded;
+    if (!in.empty())
+    {
+        uint32_t freqs[256];
+        uint32_t starts[256];
+        normalise(counts, in.size(), freqs);
+        uint32_t start = 0;
+        int num_symbols = 0;
+        for (int s = 0; s < 256; s++)
+        {
+            starts[s] = start;
+            start += freqs[s];
+            num_symbols += freqs[s] != 0;
+        }
+
+        write_varint(num_symbols, encoded);
+        for (int s = 0; s < 256; s++)
+        {
+            if (freqs[s] != 0)
+            {
+                encoded.push_back(static_cast<char>(s));
+                write_varint(freqs[s], encoded);
+            }
+        }
+
+        // rANS works backwards, so we make the output backwards and then
+        // reverse it.
+        string backwards;
+        uint32_t x = RANS_L;
+        for (size_t i = in.size(); i-- > 0;)
+        {
+            const unsigned char s = in[i];
+            const uint32_t freq = freqs[s];
+            const uint32_t x_max = ((RANS_L >> PROB_BITS) << 8) * freq;
+            while (x >= x_max)
+            {
+                backwards.push_back(static_cast<char>(x & 0xFF));
+                x >>= 8;
+            }
+            x = ((x / freq) << PROB_BITS) + (x % freq) + starts[s];
+        }
+        for (int i = 0; i < 4; i++)
+        {
+            backwards.push_back(static_cast<char>(x & 0xFF));
+            x >>= 8;
+        }
+        encoded.append(backwards.rbegin(), backwards.rend());
+    }
+
+    if (!in.empty() && encoded.size() < in.size())
+    {
+        out.push_back(METHOD_RANS);
+        out += encoded;
+    }
+    else
+    {
+        out.push_back(METHOD_STORED);
+        out += in;
+    }
+}
+
+bool entropy_decode(const char* pos, const char* end, string& out)
+{
+    uint64_t size;
+    if (!read_varint(pos, end, size) || pos == end)
+    {
+        return false;
+    }
+    const char method = *pos;
+    pos++;
+    if (method == METHOD_STORED)
+    {
+        if (uint64_t(end - pos) != size)
+        {
+            return false;
+        }
+        out.assign(pos, end);
+        return true;
+    }
+    if (method != METHOD_RANS)
+    {
+        return false;
+    }
+
+    uint64_t num_symbols;
+    if (!read_varint(pos, end, num_symbols) || num_symbols > 256)
+    {
+        return false;
+    }
+    uint32_t freqs[256] = {};
+    uint32_t starts[256] = {};
+    unsigned char symbols[PROB_SCALE];
+    uint32_t start = 0;
+    for (uint64_t i = 0; i < num_symbols; i++)
+    {
+        uint64_t freq;
+        if (pos == end)
+        {
+            return false;
+        }
+        const unsigned char s = *pos;
+        pos++;
+        if (!read_varint(pos, end, freq) || freq == 0 ||
+            freq > PROB_SCALE - start || freqs[s] != 0)
+        {
+            return false;
+        }
+        freqs[s] = freq;
+        starts[s] = start;
+        memset(symbols + start, s, freq);
+        start += freq;
+    }
+    if (start != PROB_SCALE || end - pos < 4)
+    {
+        return false;
+    }
+
+    uint32_t x = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        x = (x << 8) | (unsigned char) *pos;
+        pos++;
+    }
+    out.resize(size);
+    for (uint64_t i = 0; i < size; i++)
+    {
+        const uint32_t slot = x & (PROB_SCALE - 1);
+        const unsigned char s = symbols[slot];
+        out[i] = static_cast<char>(s);
+        x = freqs[s] * (x >> PROB_BITS) + slot - starts[s];
+        while (x < RANS_L)
+        {
+            if (pos == end)
+            {
+                return false;
+            }
+            x = (x << 8) | (unsigned char) *pos;
+            pos++;
+        }
+    }
+    // The encoder started at RANS_L, so we should be back there.
+    return pos == end && x == RANS_L;
+}
+
+namespace
+{
+
+// Vertices are written as x and y (deltas from the last vertex if fixed
+// point), then the number of polygons and each polygon as a delta from the
+// last polygon written, plus 1 (0 is -1).
+void encode_vertices(const ExactMesh& in, int first, int count, string& out)
+{
+    const NavMesh& mesh = in.mesh;
+    int64_t last_x = 0;
+    int64_t last_y = 0;
+    int last_polygon = 0;
+    for (int i = first; i < first + count; i++)
+    {
+        if (in.fixed_point)
+        {
+            const int64_t x = in.fixed_xy[2*i];
+            const int64_t y = in.fixed_xy[2*i+1];
+            write_varint(delta(x, last_x), out);
+            write_varint(delta(y, last_y), out);
+            last_x = x;
+            last_y = y;
+        }
+        else
+        {
+            // Doubles don't delta code well, so just copy them.
+            out.append(reinterpret_cast<const char*>(&mesh.vertex_xy[2*i]), 16);
+        }
+        const int start = mesh.vertex_offsets[i];
+        const int end = mesh.vertex_offsets[i+1];
+        write_varint(end - start, out);
+        for (int j = start; j < end; j++)
+        {
+            const int p = mesh.vertex_polygons[j];
+            if (p == -1)
+            {
+                write_varint(0, out);
+            }
+            else
+            {
+                write_varint(delta(p, last_polygon) + 1, out);
+                last_polygon = p;
+            }
+        }
+    }
+}
+
+// Polygons are written as their number of vertices, their first vertex as a
+// delta from the last polygon's first vertex, their other vertices as deltas
+// from the vertex before, and their neighbours as deltas from the polygon
+// itself, plus 1 (0 is -1).
+void encode_polygons(const ExactMesh& in, int first, int count, string& out)
+{
+    const NavMesh& mesh = in.mesh;
+    int last_first_vertex = 0;
+    for (int i = first; i < first + count; i++)
+    {
+        const int start = mesh.polygon_offsets[i];
+        const int end = mesh.polygon_offsets[i+1];
+        write_varint(end - start, out);
+        write_varint(delta(mesh.polygon_vertices[start], last_first_vertex),
+                     out);
+        last_first_vertex = mesh.polygon_vertices[start];
+        for (int j = start + 1; j < end; j++)
+        {
+            write_varint(delta(mesh.polygon_vertices[j],
+                               mesh.polygon_vertices[j-1]), out);
+        }
+        for (int j = start; j < end; j++)
+        {
+            const int p = mesh.polygon_neighbours[j];
+            write_varint(p == -1 ? 0 : delta(p, i) + 1, out);
+        }
+    }
+}
+
+// Reads varints from a decoded block, remembering if anything went wrong.
+struct BlockReader
+{
+    const char* pos;
+    const char* end;
+    bool ok;
+
+    uint64_t read()
+    {
+        uint64_t out = 0;
+        if (ok && !read_varint(pos, end, out))
+        {
+            ok = false;
+        }
+        return out;
+    }
+
+    // Reads a delta coded value which must be in [min, max].
+    int64_t read_delta(int64_t previous, int64_t min, int64_t max)
+    {
+        return check(undelta(read(), previous), min, max);
+    }
+
+    // Reads a polygon written as 0 for -1 or a delta plus 1.
+    int read_polygon(int previous, int num_polygons)
+    {
+        const uint64_t coded = read();
+        if (coded == 0)
+        {
+            return -1;
+        }
+        return check(undelta(coded - 1, previous), 0, num_polygons - 1);
+    }
+
+    int64_t check(int64_t value, int64_t min, int64_t max)
+    {
+        if (value < min || value > max)
+        {
+            ok = false;
+            return min;
+        }
+        return value;
+    }
+};
+
+bool decode_vertices(const CompressedMesh& header, const BlockInfo& block,
+                     BlockReader& reader, ExactMesh& out)
+{
+    const double power = pow(10.0, header.scale);
+    int64_t last_x = 0;
+    int64_t last_y = 0;
+    int last_polygon = 0;
+    vector<int> polygons;
+    for (int i = 0; i < block.count && reader.ok; i++)
+    {
+        double x, y;
+        if (header.fixed_point)
+        {
+            last_x = undelta(reader.read(), last_x);
+            last_y = undelta(reader.read(), last_y);
+            out.fixed_xy.push_back(last_x);
+            out.fixed_xy.push_back(last_y);
+            x = last_x / power;
+            y = last_y / power;
+        }
+        else
+        {
+            if (reader.end - reader.pos < 16)
+            {
+                return false;
+            }
+            memcpy(&x, reader.pos, 8);
+            memcpy(&y, reader.pos + 8, 8);
+            reader.pos += 16;
+        }
+        const uint64_t n = reader.read();
+        if (n > (uint64_t) header.num_polygons)
+        {
+            return false;
+        }
+        polygons.resize(n);
+        for (uint64_t j = 0; j < n; j++)
+        {
+            polygons[j] = reader.read_polygon(last_polygon,
+                                              header.num_polygons);
+            if (polygons[j] != -1)
+            {
+                last_polygon = polygons[j];
+            }
+        }
+        out.mesh.add_vertex(x, y, polygons);
+    }
+    return reader.ok;
+}
+
+bool decode_polygons(const CompressedMesh& header, const BlockInfo& block,
+                     BlockReader& reader, ExactMesh& out)
+{
+    const int V = header.num_vertices;
+    int last_first_vertex = 0;
+    vector<int> vertices;
+    vector<int> neighbours;
+    for (int i = block.first; i < block.first + block.count && reader.ok; i++)
+    {
+        const uint64_t n = reader.read();
+        if (n < 3 || n > (uint64_t) V)
+        {
+            return false;
+        }
+        vertices.resize(n);
+        neighbours.resize(n);
+        vertices[0] = reader.read_delta(last_first_vertex, 0, V - 1);
+        last_first_vertex = vertices[0];
+        for (uint64_t j = 1; j < n; j++)
+        {
+            vertices[j] = reader.read_delta(vertices[j-1], 0, V - 1);
+        }
+        for (uint64_t j = 0; j < n; j++)
+        {
+            neighbours[j] = reader.read_polygon(i, header.num_polygons);
+        }
+        out.mesh.add_polygon(vertices, neighbours);
+    }
+    return reader.ok;
+}
+
+// Appends the vertices and polygons of from to the end of to.
+void append(ExactMesh& to, const ExactMesh& from)
+{
+    NavMesh& a = to.mesh;
+    const NavMesh& b = from.mesh;
+    to.fixed_xy.insert(to.fixed_xy.end(), from.fixed_xy.begin(),
+                       from.fixed_xy.end());
+    a.vertex_xy.insert(a.vertex_xy.end(), b.vertex_xy.begin(),
+                       b.vertex_xy.end());
+    const int vertex_base = a.vertex_polygons.size();
+    for (int i = 1; i < (int) b.vertex_offsets.size(); i++)
+    {
+        a.vertex_offsets.push_back(vertex_base + b.vertex_offsets[i]);
+    }
+    a.vertex_polygons.insert(a.vertex_polygons.end(),
+                             b.vertex_polygons.begin(),
+                             b.vertex_polygons.end());
+    const int polygon_base = a.polygon_vertices.size();
+    for (int i = 1; i < (int) b.polygon_offsets.size(); i++)
+    {
+        a.polygon_offsets.push_back(polygon_base + b.polygon_offsets[i]);
+    }
+    a.polygon_vertices.insert(a.polygon_vertices.end(),
+                              b.polygon_vertices.begin(),
+                              b.polygon_vertices.end());
+    a.polygon_neighbours.insert(a.polygon_neighbours.end(),
+                                b.polygon_neighbours.begin(),
+                                b.polygon_neighbours.end());
+}
+
+}
+
+void write_compressed_mesh(const ExactMesh& mesh, int block_size,
+                           int threads, ostream& outfile)
+{
+    const int V = mesh.mesh.num_vertices();
+    const int P = mesh.mesh.num_polygons();
+    vector<BlockInfo> blocks;
+    for (int i = 0; i < V; i += block_size)
+    {
+        blocks.push_back({BLOCK_VERTICES, i, min(block_size, V - i), 0, 0});
+    }
+    for (int i = 0; i < P; i += block_size)
+    {
+        blocks.push_back({BLOCK_POLYGONS, i, min(block_size, P - i), 0, 0});
+    }
+
+    vector<string> encoded(blocks.size());
+    parallel_for(blocks.size(), threads, [&](int i)
+    {
+        const BlockInfo& block = blocks[i];
+        string raw;
+        if (block.kind == BLOCK_VERTICES)
+        {
+            encode_vertices(mesh, block.first, block.count, raw);
+        }
+        else
+        {
+            encode_polygons(mesh, block.first, block.count, raw);
+        }
+        entropy_encode(raw, encoded[i]);
+    });
+
+    string header;
+    write_varint(mesh.version, header);
+    write_varint(V, header);
+    write_varint(P, header);
+    write_varint(mesh.fixed_point ? 0 : 1, header);
+    write_varint(mesh.scale, header);
+    write_varint(blocks.size(), header);
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+        write_varint(blocks[i].kind, header);
+        write_varint(blocks[i].first, header);
+        write_varint(blocks[i].count, header);
+        write_varint(encoded[i].size(), header);
+    }
+
+    outfile.write("pakz", 4);
+    outfile.write(header.data(), header.size());
+    for (const string& block : encoded)
+    {
+        outfile.write(block.data(), block.size());
+    }
+}
+
+bool CompressedMesh::open(const string& data, string& error)
+{
+    this->data = &data;
+    blocks.clear();
+    const char* pos = data.data();
+    const char* const end = pos + data.size();
+    if (data.size() < 4 || data.compare(0, 4, "pakz") != 0)
+    {
+        error = "Header is not pakz";
+        return false;
+    }
+    pos += 4;
+
+    bool ok = true;
+    auto read = [&](uint64_t max) -> uint64_t
+    {
+        uint64_t out = 0;
+        if (ok && (!read_varint(pos, end, out) || out > max))
+        {
+            ok = false;
+        }
+        return out;
+    };
+    version = read(2);
+    num_vertices = read(INT32_MAX);
+    num_polygons = read(INT32_MAX);
+    fixed_point = read(1) == 0;
+    scale = read(MAX_SCALE);
+    const uint64_t num_blocks = read(uint64_t(num_vertices) + num_polygons);
+    if (!ok || num_vertices < 1 || num_polygons < 1 || version < 1)
+    {
+        error = "Invalid header";
+        return false;
+    }
+
+    // Blocks must cover the vertices then the polygons, in order.
+    int next_vertex = 0;
+    int next_polygon = 0;
+    for (uint64_t i = 0; i < num_blocks && ok; i++)
+    {
+        BlockInfo block;
+        block.kind = (BlockKind) read(BLOCK_POLYGONS);
+        block.first = read(INT32_MAX);
+        block.count = read(INT32_MAX);
+        block.size = read(data.size());
+        block.offset = 0;
+        int& next = block.kind == BLOCK_VERTICES ? next_vertex : next_polygon;
+        if (block.first != next || block.count == 0 ||
+            (block.kind == BLOCK_VERTICES && next_polygon != 0))
+        {
+            ok = false;
+        }
+        next += block.count;
+        blocks.push_back(block);
+    }
+    if (!ok || next_vertex != num_vertices || next_polygon != num_polygons)
+    {
+        error = "Invalid block index";
+        return false;
+    }
+
+    size_t offset = pos - data.data();
+    for (BlockInfo& block : blocks)
+    {
+        block.offset = offset;
+        offset += block.size;
+    }
+    if (offset != data.size())
+    {
+        error = "File size does not match block index";
+        return false;
+    }
+    return true;
+}
+
+bool CompressedMesh::decode_block(int index, ExactMesh& out,
+                                  string& error) const
+{
+    const BlockInfo& block = blocks[index];
+    out.version = version;
+    out.fixed_point = fixed_point;
+    out.scale = scale;
+    string raw;
+    const char* start = data->data() + block.offset;
+    if (!entropy_decode(start, start + block.size, raw))
+    {
+        error = "Unable to decompress block " + to_string(index);
+        return false;
+    }
+    BlockReader reader = {raw.data(), raw.data() + raw.size(), true};
+    const bool ok = block.kind == BLOCK_VERTICES
+                    ? decode_vertices(*this, block, reader, out)
+                    : decode_polygons(*this, block, reader, out);
+    if (!ok || reader.pos != reader.end)
+    {
+        error = "Invalid data in block " + to_string(index);
+        return false;
+    }
+    return true;
+}
+
+bool CompressedMesh::decode(ExactMesh& out, int threads, string& error) const
+{
+    vector<ExactMesh> decoded(blocks.size());
+    vector<string> errors(blocks.size());
+    parallel_for(blocks.size(), threads, [&](int i)
+    {
+        decode_block(i, decoded[i], errors[i]);
+    });
+
+    out = ExactMesh();
+    out.version = version;
+    out.fixed_point = fixed_point;
+    out.scale = scale;
+    for (size_t i = 0; i < blocks.size(); i++)
+    {
+        if (!errors[i].empty())
+        {
+            error = errors[i];
+            return false;
+        }
+        append(out, decoded[i]);
+    }
+    return true;
+}
+
+}
@@ -0,0 +1,78 @@
+#pragma once
+#include "packing.h"
+#include <iostream>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Compressed packed meshes ("pakz"). See spec/packed/3.txt.
+// The vertices and polygons are split into blocks which are delta coded and
+// entropy coded separately, so they can be decoded in parallel or on their
+// own.
+
+const int DEFAULT_BLOCK_SIZE = 4096;
+
+// Entropy codes in with rANS (or stores it if that's smaller), appending the
+// result to out. See spec/packed/3.txt for the layout.
+void entropy_encode(const string& in, string& out);
+// Decodes [pos, end), which must be exactly what entropy_encode wrote.
+bool entropy_decode(const char* pos, const char* end, string& out);
+
+enum BlockKind
+{
+    BLOCK_VERTICES,
+    BLOCK_POLYGONS
+};
+
+struct BlockInfo
+{
+    BlockKind kind;
+    // The vertices or polygons in this block are [first, first + count).
+    int first;
+    int count;
+    // Where the block is, relative to the start of the file.
+    size_t offset;
+    size_t size;
+};
+
+// Compresses mesh into blocks of block_size vertices or polygons, using up
+// to threads threads (0 for one per core).
+void write_compressed_mesh(const ExactMesh& mesh, int block_size,
+                           int threads, ostream& outfile);
+
+// A compressed mesh in memory. Only the header and block index are read
+// when it is opened.
+class CompressedMesh
+{
+public:
+    // The header, as in ExactMesh.
+    int version;
+    int num_vertices;
+    int num_polygons;
+    bool fixed_point;
+    int scale;
+    vector<BlockInfo> blocks;
+
+    CompressedMesh()
+        : version(0), num_vertices(0), num_polygons(0), fixed_point(true),
+          scale(0), data(nullptr) {}
+
+    // data must outlive this.
+    // Returns false and sets error if the header or index are invalid.
+    bool open(const string& data, string& error);
+
+    // Decodes one block. The vertices or polygons of the block are added to
+    // out.mesh (and out.fixed_xy) in order, and their indices are still
+    // relative to the whole mesh.
+    bool decode_block(int index, ExactMesh& out, string& error) const;
+
+    // Decodes every block using up to threads threads (0 for one per core).
+    bool decode(ExactMesh& out, int threads, string& error) const;
+
+private:
+    const string* data;
+};
+
+}
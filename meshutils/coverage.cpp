@@ -0,0 +1,340 @@
+#include "coverage.h"
+#include "parallel.h"
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+
+namespace meshutils
+{
+
+namespace
+{
+
+// Rows filled at a time by each thread.
+const int BAND_ROWS = 16;
+// Polygons looked at a time by each thread.
+const int CHUNK_SIZE = 1 << 14;
+// How far the area can be from the number of traversable cells, per cell.
+const double AREA_EPSILON = 1e-9;
+
+// What one band of rows or chunk of polygons found.
+struct Found
+{
+    long long traversable;
+    long long missing;
+    long long extra;
+    long long overlapping;
+    long long outside;
+    double area;
+    vector<string> messages;
+
+    Found() : traversable(0), missing(0), extra(0), overlapping(0),
+              outside(0), area(0) {}
+};
+
+string cell(int x, int y)
+{
+    return "cell (" + to_string(x) + ", " + to_string(y) + ") ";
+}
+
+class Coverer
+{
+public:
+    Coverer(const GridMap& map, const NavMesh& mesh, int max_messages)
+        : map(map), mesh(mesh), max_messages(max_messages),
+          first_row(mesh.num_polygons()), end_row(mesh.num_polygons()) {}
+
+    void look_at_polygon(int p, Found& found);
+    void bucket();
+    void fill_band(int band, Found& found);
+
+    int num_bands() const
+    {
+        return (map.height + BAND_ROWS - 1) / BAND_ROWS;
+    }
+
+private:
+    const GridMap& map;
+    const NavMesh& mesh;
+    int max_messages;
+    // The rows polygon p covers centres in are first_row[p] to
+    // end_row[p]-1, cut off at the edges of the map.
+    vector<int> first_row;
+    vector<int> end_row;
+    // The polygons band b covers are band_polygons[band_offsets[b]] to
+    // band_polygons[band_offsets[b+1]-1], in increasing order.
+    vector<int> band_offsets;
+    vector<int> band_polygons;
+
+    void note(Found& found, const string& message)
+    {
+        if ((int) found.messages.size() < max_messages)
+        {
+            found.messages.push_back(message);
+        }
+    }
+
+    double x(int v) const
+    {
+        return mesh.vertex_xy[2*v];
+    }
+    double y(int v) const
+    {
+        return mesh.vertex_xy[2*v+1];
+    }
+
+    // The first row (or column) whose centre is at or after z, so that each
+    // polygon gets the centres in [min, max).
+    int first_centre(double z, int size) const
+    {
+        return (int) max(0.0, min((double) size, ceil(z - 0.5)));
+    }
+
+    void fill_row(int p, int row, vector<double>& crossings, int* owner,
+                  int* also);
+};
+
+void Coverer::look_at_polygon(int p, Found& found)
+{
+    const int begin = mesh.polygon_offsets[p];
+    const int end = mesh.polygon_offsets[p+1];
+    double min_y = HUGE_VAL;
+    double max_y = -HUGE_VAL;
+    double area = 0;
+    bool inside = true;
+    for (int i = begin; i < end; i++)
+    {
+        const int a = mesh.polygon_vertices[i == begin ? end - 1 : i - 1];
+        const int b = mesh.polygon_vertices[i];
+        min_y = min(min_y, y(b));
+        max_y = max(max_y, y(b));
+        area += x(a) * y(b) - x(b) * y(a);
+        inside = inside && x(b) >= 0 && x(b) <= map.width && y(b) >= 0 &&
+                 y(b) <= map.height;
+    }
+    found.area += fabs(area) / 2;
+    if (!inside)
+    {
+        found.outside++;
+        note(found, "polygon " + to_string(p) + " goes off the map");
+    }
+    first_row[p] = first_centre(min_y, map.height);
+    end_row[p] = first_centre(max_y, map.height);
+}
+
+void Coverer::bucket()
+{
+    band_offsets.assign(num_bands() + 1, 0);
+    for (int p = 0; p < mesh.num_polygons(); p++)
+    {
+        if (first_row[p] < end_row[p])
+        {
+            for (int b = first_row[p] / BAND_ROWS;
+                 b <= (end_row[p] - 1) / BAND_ROWS; b++)
+            {
+                band_offsets[b+1]++;
+            }
+        }
+    }
+    for (int b = 0; b < num_bands(); b++)
+    {
+        band_offsets[b+1] += band_offsets[b];
+    }
+    band_polygons.resize(band_offsets.back());
+    vector<int> next(band_offsets.begin(), band_offsets.end() - 1);
+    for (int p = 0; p < mesh.num_polygons(); p++)
+    {
+        if (first_row[p] < end_row[p])
+        {
+            for (int b = first_row[p] / BAND_ROWS;
+                 b <= (end_row[p] - 1) / BAND_ROWS; b++)
+            {
+                band_polygons[next[b]++] = p;
+            }
+        }
+    }
+}
+
+// Finds where the row's centre line goes in and out of p, and gives p the
+// cells between. Convex polygons only go in and out once, but this works
+// for any polygon.
+void Coverer::fill_row(int p, int row, vector<double>& crossings, int* owner,
+                       int* also)
+{
+    const double centre = row + 0.5;
+    const int begin = mesh.polygon_offsets[p];
+    const int end = mesh.polygon_offsets[p+1];
+    crossings.clear();
+    for (int i = begin; i < end; i++)
+    {
+        int a = mesh.polygon_vertices[i == begin ? end - 1 : i - 1];
+        int b = mesh.polygon_vertices[i];
+        if ((y(a) <= centre) == (y(b) <= centre))
+        {
+            continue;
+        }
+        // Work it out from the lower end, so the polygon on the other side
+        // of the edge gets exactly the same x.
+        if (y(b) < y(a))
+        {
+            swap(a, b);
+        }
+        crossings.push_back(x(a) + (centre - y(a)) * (x(b) - x(a)) /
+                            (y(b) - y(a)));
+    }
+    sort(crossings.begin(), crossings.end());
+    for (size_t k = 0; k + 1 < crossings.size(); k += 2)
+    {
+        const int last = first_centre(crossings[k+1], map.width);
+        for (int c = first_centre(crossings[k], map.width); c < last; c++)
+        {
+            if (owner[c] == -1)
+            {
+                owner[c] = p;
+            }
+            else if (also[c] == -1)
+            {
+                also[c] = p;
+            }
+        }
+    }
+}
+
+void Coverer::fill_band(int band, Found& found)
+{
+    const int top = band * BAND_ROWS;
+    const int rows = min(BAND_ROWS, map.height - top);
+    // The first and second polygon covering each cell of the band.
+    vector<int> owner(rows * map.width, -1);
+    vector<int> also(rows * map.width, -1);
+    vector<double> crossings;
+    for (int i = band_offsets[band]; i < band_offsets[band+1]; i++)
+    {
+        const int p = band_polygons[i];
+        const int end = min(end_row[p], top + rows);
+        for (int row = max(first_row[p], top); row < end; row++)
+        {
+            const int offset = (row - top) * map.width;
+            fill_row(p, row, crossings, &owner[offset], &also[offset]);
+        }
+    }
+
+    for (int row = top; row < top + rows; row++)
+    {
+        const vector<bool>& traversable = map.traversable[row];
+        const int* row_owner = &owner[(row - top) * map.width];
+        const int* row_also = &also[(row - top) * map.width];
+        for (int c = 0; c < map.width; c++)
+        {
+            if (traversable[c])
+            {
+                found.traversable++;
+                if (row_owner[c] == -1)
+                {
+                    found.missing++;
+                    note(found, cell(c, row) + "is traversable, but no "
+                         "polygon covers it");
+                }
+            }
+            else if (row_owner[c] != -1)
+            {
+                found.extra++;
+                note(found, cell(c, row) + "is blocked, but polygon " +
+                     to_string(row_owner[c]) + " covers it");
+            }
+            if (row_also[c] != -1)
+            {
+                found.overlapping++;
+                note(found, cell(c, row) + "is covered by polygons " +
+                     to_string(row_owner[c]) + " and " +
+                     to_string(row_also[c]));
+            }
+        }
+    }
+}
+
+void add(const Found& found, int max_messages, CoverageReport& out)
+{
+    out.traversable += found.traversable;
+    out.missing += found.missing;
+    out.extra += found.extra;
+    out.overlapping += found.overlapping;
+    out.outside += found.outside;
+    out.area += found.area;
+    for (const string& message : found.messages)
+    {
+        if ((int) out.messages.size() < max_messages)
+        {
+            out.messages.push_back(message);
+        }
+    }
+}
+
+}
+
+long long CoverageReport::problems() const
+{
+    const bool area_wrong =
+        fabs(area - traversable) > AREA_EPSILON * (traversable + 1);
+    return missing + extra + overlapping + outside + area_wrong;
+}
+
+bool CoverageReport::matches() const
+{
+    return problems() == 0;
+}
+
+bool compare_coverage(const GridMap& map, const NavMesh& mesh, int threads,
+                      int max_messages, CoverageReport& out)
+{
+    out = CoverageReport();
+    out.traversable = out.missing = out.extra = out.overlapping =
+        out.outside = 0;
+    out.area = 0;
+    Coverer coverer(map, mesh, max_messages);
+    {
+        StatsPhase phase("bucket polygons");
+        const int chunks = (mesh.num_polygons() + CHUNK_SIZE - 1) /
+                           CHUNK_SIZE;
+        vector<Found> found(chunks);
+        parallel_for(chunks, threads, [&](int chunk)
+        {
+            const int end = min(mesh.num_polygons(),
+                                (chunk + 1) * CHUNK_SIZE);
+            for (int p = chunk * CHUNK_SIZE; p < end; p++)
+            {
+                coverer.look_at_polygon(p, found[chunk]);
+            }
+        });
+        // Added up in order, so the area doesn't depend on the threads.
+        for (const Found& f : found)
+        {
+            add(f, max_messages, out);
+        }
+        coverer.bucket();
+    }
+    {
+        StatsPhase phase("fill rows");
+        vector<Found> found(coverer.num_bands());
+        parallel_for(coverer.num_bands(), threads, [&](int band)
+        {
+            coverer.fill_band(band, found[band]);
+        });
+        for (const Found& f : found)
+        {
+            add(f, max_messages, out);
+        }
+    }
+    if (out.problems() > out.missing + out.extra + out.overlapping +
+                         out.outside &&
+        (int) out.messages.size() < max_messages)
+    {
+        out.messages.push_back("the polygons have an area of " +
+                               to_string(out.area) + ", but there are " +
+                               to_string(out.traversable) +
+                               " traversable cells");
+    }
+    return out.matches();
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "gridmap.h"
+#include "navmesh.h"
+#include <string>
+#include <vector>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Checking that a mesh covers exactly the traversable cells of the map it was
+// made from, which is what meshcover does. Cell (x, y) is the square from
+// (x, y) to (x+1, y+1), as it is for every converter.
+// Each polygon is filled into the grid a row at a time, like a rasteriser:
+// a cell is covered by the polygons its centre is in. Centres on an edge go
+// to the polygon on its right (larger x), so two polygons sharing an edge
+// never both get a cell.
+
+struct CoverageReport
+{
+    // Traversable cells in the map.
+    long long traversable;
+    // Traversable cells no polygon covers.
+    long long missing;
+    // Blocked cells a polygon covers.
+    long long extra;
+    // Cells more than one polygon covers.
+    long long overlapping;
+    // Polygons which go off the map.
+    long long outside;
+    // The total area of the polygons, which should be traversable, to catch
+    // gaps and overlaps too thin to cover a centre.
+    double area;
+    // What the first few problems were, and where (polygons off the map
+    // first, then the cells in order, then the area).
+    vector<string> messages;
+
+    // How many problems were found, counting the area being wrong as one.
+    long long problems() const;
+    // Whether the mesh covers exactly the traversable cells.
+    bool matches() const;
+};
+
+// Compares mesh with map on up to threads threads (0 for one per core),
+// keeping up to max_messages messages. Returns true if they match.
+bool compare_coverage(const GridMap& map, const NavMesh& mesh, int threads,
+                      int max_messages, CoverageReport& out);
+
+}
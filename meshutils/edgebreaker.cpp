@@ -0,0 +1,1386 @@
+#include "edgebreaker.h"
+#include "compress.h"
+#include <string.h>
+#include <cmath>
+#include <algorithm>
+
+namespace meshutils
+{
+
+namespace
+{
+
+enum Symbol
+{
+    SYMBOL_C,
+    SYMBOL_L,
+    SYMBOL_E,
+    SYMBOL_R,
+    SYMBOL_S
+};
+
+// The streams after the header, in order.
+enum Stream
+{
+    STREAM_SYMBOLS,
+    STREAM_SPLITS,
+    STREAM_DUMMIES,
+    STREAM_MERGES,
+    STREAM_ISOLATED,
+    STREAM_GEOMETRY,
+    NUM_STREAMS,
+    // Only there if the encoder was asked to keep the mesh's order.
+    STREAM_ORDER = NUM_STREAMS
+};
+
+// Triangles are stored as corners: corner k of triangle t is 3t + k.
+inline int next_corner(int c)
+{
+    return c % 3 == 2 ? c - 2 : c + 1;
+}
+
+inline int prev_corner(int c)
+{
+    return c % 3 == 0 ? c + 2 : c - 1;
+}
+
+// The boundary between the visited and unvisited triangles, as loops of
+// nodes. Each node is a vertex and the edge from it to the next node, and
+// goes the same way around as the visited triangles.
+struct Loops
+{
+    vector<int> vertex;
+    // The encoder stores the corner across each edge (in the unvisited
+    // triangle), and the decoder stores the corner opposite it in the visited
+    // triangle.
+    vector<int> corner;
+    vector<int> prev;
+    vector<int> next;
+    // Loops to go back to after splitting: a node on it and its size.
+    vector<pair<int, int>> stack;
+
+    int add(int v, int c)
+    {
+        vertex.push_back(v);
+        corner.push_back(c);
+        prev.push_back(-1);
+        next.push_back(-1);
+        return vertex.size() - 1;
+    }
+
+    void join(int a, int b)
+    {
+        next[a] = b;
+        prev[b] = a;
+    }
+
+    // A loop around the triangle (v[0], v[1], v[2]), where c[k] goes with
+    // the edge v[k] to v[k+1]. Returns the node of v[0].
+    int start(const int v[3], const int c[3])
+    {
+        const int first = add(v[0], c[0]);
+        join(first, add(v[1], c[1]));
+        join(first + 1, add(v[2], c[2]));
+        join(first + 2, first);
+        return first;
+    }
+
+    // The next triangle is always the one across the edge from the gate node
+    // a to b. It is made of a, b and x, which adds the edges a to x (which
+    // gets corner left) and x to b (which gets corner right).
+
+    // x wasn't visited yet. Returns the new node of x.
+    int apply_c(int a, int x, int left, int right)
+    {
+        const int node = add(x, right);
+        join(node, next[a]);
+        join(a, node);
+        corner[a] = left;
+        return node;
+    }
+
+    // x is the node before a. Returns it.
+    int apply_l(int a, int right)
+    {
+        const int pa = prev[a];
+        join(pa, next[a]);
+        corner[pa] = right;
+        return pa;
+    }
+
+    // x is the node after b. Returns a.
+    int apply_r(int a, int left)
+    {
+        join(a, next[next[a]]);
+        corner[a] = left;
+        return a;
+    }
+
+    // x is the node x_node elsewhere on the loop, which splits it in two.
+    // x_node stays on the loop from x to b, and a new node for x is made on
+    // the loop from a to x.
+    void apply_s(int a, int x_node, int left, int right)
+    {
+        const int b = next[a];
+        const int node = add(vertex[x_node], corner[x_node]);
+        join(node, next[x_node]);
+        join(a, node);
+        join(x_node, b);
+        corner[x_node] = right;
+        corner[a] = left;
+    }
+};
+
+// Sizes of the two loops after splitting a loop of size n at a node k after b
+// (if forwards) or k before a. The first is the loop with b.
+pair<int, int> split_sizes(int n, int k, bool forwards)
+{
+    if (forwards)
+    {
+        return make_pair(k + 1, n - k);
+    }
+    return make_pair(n - k, k + 1);
+}
+
+// Predicts a vertex's coordinates from the vertices given by predictors,
+// which are indices into xy (-1 if it can't be used): a + b - o if all three
+// can be, otherwise a or b, otherwise last.
+void predict(const int predictors[3], const vector<int64_t>& xy,
+             const int64_t last[2], int64_t out[2])
+{
+    const int a = predictors[0];
+    const int b = predictors[1];
+    const int o = predictors[2];
+    for (int j = 0; j < 2; j++)
+    {
+        if (a != -1 && b != -1 && o != -1)
+        {
+            out[j] = int64_t(uint64_t(xy[2*a+j]) + uint64_t(xy[2*b+j]) -
+                             uint64_t(xy[2*o+j]));
+        }
+        else if (a != -1)
+        {
+            out[j] = xy[2*a+j];
+        }
+        else if (b != -1)
+        {
+            out[j] = xy[2*b+j];
+        }
+        else
+        {
+            out[j] = last[j];
+        }
+    }
+}
+
+// The predictors of a decoded vertex, as indices of final vertices.
+void final_predictors(const vector<int>& predictors,
+                      const vector<int>& final_index, int d, int out[3])
+{
+    for (int j = 0; j < 3; j++)
+    {
+        const int p = predictors[3*d+j];
+        out[j] = p == -1 ? -1 : final_index[p];
+    }
+}
+
+// Reads varints from a decoded stream, remembering if anything went wrong.
+struct StreamReader
+{
+    const char* pos;
+    const char* end;
+    bool ok;
+
+    explicit StreamReader(const string& data)
+        : pos(data.data()), end(data.data() + data.size()), ok(true) {}
+
+    uint64_t read(uint64_t max)
+    {
+        uint64_t out = 0;
+        if (ok && (!read_varint(pos, end, out) || out > max))
+        {
+            ok = false;
+        }
+        return ok ? out : 0;
+    }
+
+    bool finished() const
+    {
+        return ok && pos == end;
+    }
+};
+
+// Finds where in b the elements of a start, after mapping each one (other
+// than -1) with map, or -1 if b isn't a turned around.
+int cycle_start(const int* a, const int* b, int n, const vector<int>& map)
+{
+    if (n == 0)
+    {
+        return 0;
+    }
+    for (int start = 0; start < n; start++)
+    {
+        bool same = true;
+        for (int i = 0; i < n && same; i++)
+        {
+            const int x = a[i];
+            same = (x == -1 ? -1 : map[x]) == b[(start + i) % n];
+        }
+        if (same)
+        {
+            return start;
+        }
+    }
+    return -1;
+}
+
+bool same_cycle(const int* a, const int* b, int n, const vector<int>& map)
+{
+    return cycle_start(a, b, n, map) != -1;
+}
+
+// Checks that decoded is original with vertex v renumbered to vertex_map[v]
+// and polygon p to polygon_map[p].
+bool same_mesh(const ExactMesh& original, const ExactMesh& decoded,
+               const vector<int>& vertex_map, const vector<int>& polygon_map)
+{
+    const NavMesh& a = original.mesh;
+    const NavMesh& b = decoded.mesh;
+    if (original.version != decoded.version ||
+        original.fixed_point != decoded.fixed_point ||
+        original.scale != decoded.scale ||
+        a.num_vertices() != b.num_vertices() ||
+        a.num_polygons() != b.num_polygons())
+    {
+        return false;
+    }
+    for (int v = 0; v < a.num_vertices(); v++)
+    {
+        const int w = vertex_map[v];
+        if (original.fixed_point)
+        {
+            if (original.fixed_xy[2*v] != decoded.fixed_xy[2*w] ||
+                original.fixed_xy[2*v+1] != decoded.fixed_xy[2*w+1])
+            {
+                return false;
+            }
+        }
+        else if (memcmp(&a.vertex_xy[2*v], &b.vertex_xy[2*w], 16) != 0)
+        {
+            return false;
+        }
+        const int n = a.vertex_offsets[v+1] - a.vertex_offsets[v];
+        if (b.vertex_offsets[w+1] - b.vertex_offsets[w] != n ||
+            !same_cycle(&a.vertex_polygons[a.vertex_offsets[v]],
+                        &b.vertex_polygons[b.vertex_offsets[w]], n,
+                        polygon_map))
+        {
+            return false;
+        }
+    }
+    for (int p = 0; p < a.num_polygons(); p++)
+    {
+        const int q = polygon_map[p];
+        const int* av = &a.polygon_vertices[3*p];
+        const int* an = &a.polygon_neighbours[3*p];
+        const int* bv = &b.polygon_vertices[3*q];
+        const int* bn = &b.polygon_neighbours[3*q];
+        // The vertices and neighbours have to be turned the same amount.
+        bool same = false;
+        for (int r = 0; r < 3 && !same; r++)
+        {
+            same = true;
+            for (int j = 0; j < 3 && same; j++)
+            {
+                same = vertex_map[av[j]] == bv[(j + r) % 3] &&
+                       (an[j] == -1 ? -1 : polygon_map[an[j]]) ==
+                       bn[(j + r) % 3];
+            }
+        }
+        if (!same)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The order stream: how to turn decoded, which same_mesh has checked is
+// original renumbered with vertex_map and polygon_map, back into original.
+void write_order(const ExactMesh& original, const ExactMesh& decoded,
+                 const vector<int>& vertex_map, const vector<int>& polygon_map,
+                 string& out)
+{
+    const NavMesh& a = original.mesh;
+    const NavMesh& b = decoded.mesh;
+    const int V = a.num_vertices();
+    const int P = a.num_polygons();
+    vector<int> original_vertex(V);
+    vector<int> original_polygon(P);
+    for (int v = 0; v < V; v++)
+    {
+        original_vertex[vertex_map[v]] = v;
+    }
+    for (int p = 0; p < P; p++)
+    {
+        original_polygon[polygon_map[p]] = p;
+    }
+    // Nearby vertices and triangles are usually decoded together, so these
+    // are written as the gap from one after the last.
+    int last = -1;
+    for (int v : original_vertex)
+    {
+        write_varint(delta(v, last + 1), out);
+        last = v;
+    }
+    last = -1;
+    for (int p : original_polygon)
+    {
+        write_varint(delta(p, last + 1), out);
+        last = p;
+    }
+    for (int q = 0; q < P; q++)
+    {
+        const int first = vertex_map[a.polygon_vertices[3*original_polygon[q]]];
+        int turn = 0;
+        while (b.polygon_vertices[3*q + turn] != first)
+        {
+            turn++;
+        }
+        write_varint(turn, out);
+    }
+    for (int w = 0; w < V; w++)
+    {
+        const int v = original_vertex[w];
+        write_varint(cycle_start(&a.vertex_polygons[a.vertex_offsets[v]],
+                                 &b.vertex_polygons[b.vertex_offsets[w]],
+                                 a.vertex_offsets[v+1] - a.vertex_offsets[v],
+                                 polygon_map), out);
+    }
+}
+
+// Puts a decoded mesh back in the order the order stream gives.
+bool apply_order(const string& stream, ExactMesh& mesh)
+{
+    const NavMesh& b = mesh.mesh;
+    const int V = b.num_vertices();
+    const int P = b.num_polygons();
+    StreamReader order(stream);
+    vector<int> original_vertex(V);
+    vector<int> vertex_map(V, -1);
+    int64_t last = -1;
+    for (int w = 0; w < V && order.ok; w++)
+    {
+        const int64_t v = undelta(order.read(UINT64_MAX), last + 1);
+        if (v < 0 || v >= V || vertex_map[v] != -1)
+        {
+            return false;
+        }
+        original_vertex[w] = v;
+        vertex_map[v] = w;
+        last = v;
+    }
+    vector<int> original_polygon(P);
+    vector<int> polygon_map(P, -1);
+    last = -1;
+    for (int q = 0; q < P && order.ok; q++)
+    {
+        const int64_t p = undelta(order.read(UINT64_MAX), last + 1);
+        if (p < 0 || p >= P || polygon_map[p] != -1)
+        {
+            return false;
+        }
+        original_polygon[q] = p;
+        polygon_map[p] = q;
+        last = p;
+    }
+    vector<int> turn(P);
+    for (int q = 0; q < P; q++)
+    {
+        turn[q] = order.read(2);
+    }
+    vector<int> start(V);
+    for (int w = 0; w < V; w++)
+    {
+        const int n = b.vertex_offsets[w+1] - b.vertex_offsets[w];
+        start[w] = order.read(max(n - 1, 0));
+    }
+    if (!order.finished())
+    {
+        return false;
+    }
+
+    auto original = [&](int q)
+    {
+        return q == -1 ? -1 : original_polygon[q];
+    };
+    NavMesh out;
+    vector<int> polygons;
+    for (int v = 0; v < V; v++)
+    {
+        const int w = vertex_map[v];
+        const int begin = b.vertex_offsets[w];
+        const int n = b.vertex_offsets[w+1] - begin;
+        polygons.resize(n);
+        for (int i = 0; i < n; i++)
+        {
+            polygons[i] = original(b.vertex_polygons[begin +
+                                                     (start[w] + i) % n]);
+        }
+        out.add_vertex(b.vertex_xy[2*w], b.vertex_xy[2*w+1], polygons);
+    }
+    vector<int> vertices(3);
+    vector<int> neighbours(3);
+    for (int p = 0; p < P; p++)
+    {
+        const int q = polygon_map[p];
+        for (int j = 0; j < 3; j++)
+        {
+            const int k = 3*q + (j + turn[q]) % 3;
+            vertices[j] = original_vertex[b.polygon_vertices[k]];
+            neighbours[j] = original(b.polygon_neighbours[k]);
+        }
+        out.add_polygon(vertices, neighbours);
+    }
+    if (mesh.fixed_point)
+    {
+        vector<int64_t> fixed_xy(2 * V);
+        for (int v = 0; v < V; v++)
+        {
+            fixed_xy[2*v] = mesh.fixed_xy[2*vertex_map[v]];
+            fixed_xy[2*v+1] = mesh.fixed_xy[2*vertex_map[v]+1];
+        }
+        mesh.fixed_xy.swap(fixed_xy);
+    }
+    mesh.mesh = out;
+    return true;
+}
+
+// Whether a and b are exactly the same, numbering and all.
+bool identical(const ExactMesh& a, const ExactMesh& b)
+{
+    return a.version == b.version && a.fixed_point == b.fixed_point &&
+           a.scale == b.scale &&
+           (!a.fixed_point || a.fixed_xy == b.fixed_xy) &&
+           a.mesh.vertex_xy == b.mesh.vertex_xy &&
+           a.mesh.vertex_offsets == b.mesh.vertex_offsets &&
+           a.mesh.vertex_polygons == b.mesh.vertex_polygons &&
+           a.mesh.polygon_offsets == b.mesh.polygon_offsets &&
+           a.mesh.polygon_vertices == b.mesh.polygon_vertices &&
+           a.mesh.polygon_neighbours == b.mesh.polygon_neighbours;
+}
+
+}
+
+bool encode_edgebreaker(const ExactMesh& in, string& out, string& error,
+                        bool keep_order)
+{
+    const NavMesh& mesh = in.mesh;
+    const int V = mesh.num_vertices();
+    const int P = mesh.num_polygons();
+    if ((int) mesh.polygon_vertices.size() != 3 * P)
+    {
+        error = "not a triangle mesh";
+        return false;
+    }
+
+    // Corner c is at vertex[c], and opposite[c] is the corner across the
+    // edge opposite it (or -1).
+    vector<int> vertex(mesh.polygon_vertices);
+    vector<int> opposite(3 * P, -1);
+    for (int t = 0; t < P; t++)
+    {
+        const int* v = &vertex[3*t];
+        if (v[0] == v[1] || v[1] == v[2] || v[2] == v[0])
+        {
+            error = "triangle " + to_string(t) + " has repeated vertices";
+            return false;
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            // Neighbour j shares the edge from v[j-1] to v[j], so it should
+            // have the edge from v[j] to v[j-1].
+            const int q = mesh.polygon_neighbours[3*t+j];
+            if (q == -1)
+            {
+                continue;
+            }
+            const int* w = &vertex[3*q];
+            for (int i = 0; i < 3; i++)
+            {
+                if (w[(i+2) % 3] == v[j] && w[i] == v[(j+2) % 3] &&
+                    mesh.polygon_neighbours[3*q+i] == t)
+                {
+                    opposite[3*t + (j+1) % 3] = 3*q + (i+1) % 3;
+                }
+            }
+            if (opposite[3*t + (j+1) % 3] == -1)
+            {
+                error = "triangles " + to_string(t) + " and " + to_string(q) +
+                        " don't agree on their shared edge";
+                return false;
+            }
+        }
+    }
+
+    // Vertices touching more than one fan of triangles (like where two
+    // corners of the walkable area meet) are split into a vertex per fan,
+    // and merged again when decoding.
+    // The first fan of vertex v keeps v, and the rest are numbered from V.
+    vector<int> original(V);
+    for (int v = 0; v < V; v++)
+    {
+        original[v] = v;
+    }
+    vector<bool> has_fan(V, false);
+    vector<int> split(3 * P, -1);
+    for (int c = 0; c < 3 * P; c++)
+    {
+        if (split[c] != -1)
+        {
+            continue;
+        }
+        // Go back to where the fan starts.
+        int first = c;
+        while (opposite[prev_corner(first)] != -1)
+        {
+            const int d = prev_corner(opposite[prev_corner(first)]);
+            if (d == c)
+            {
+                break;
+            }
+            first = d;
+        }
+        const int v = vertex[c];
+        int id = v;
+        if (has_fan[v])
+        {
+            id = original.size();
+            original.push_back(v);
+        }
+        has_fan[v] = true;
+        int d = first;
+        do
+        {
+            if (vertex[d] != v || split[d] != -1)
+            {
+                error = "the triangles around vertex " + to_string(v) +
+                        " don't agree";
+                return false;
+            }
+            split[d] = id;
+            d = opposite[next_corner(d)];
+            d = d == -1 ? -1 : next_corner(d);
+        } while (d != -1 && d != first);
+    }
+    vertex = split;
+
+    // Cap each hole with a fan of dummy triangles around a dummy vertex, so
+    // there are no boundaries left.
+    const int num_split = original.size();
+    vector<bool> dummy(num_split, false);
+    vector<bool> capped(3 * P, false);
+    for (int c = 0; c < 3 * P; c++)
+    {
+        if (opposite[c] != -1 || capped[c])
+        {
+            continue;
+        }
+        // The edge opposite a boundary corner goes from vertex[next c] to
+        // vertex[prev c], and the next one starts from vertex[prev c].
+        vector<int> hole;
+        int d = c;
+        do
+        {
+            if (capped[d] || (int) hole.size() > 3 * P)
+            {
+                error = "the boundary at triangle " + to_string(c / 3) +
+                        " doesn't make a loop";
+                return false;
+            }
+            capped[d] = true;
+            hole.push_back(d);
+            d = prev_corner(d);
+            while (opposite[prev_corner(d)] != -1)
+            {
+                d = prev_corner(opposite[prev_corner(d)]);
+            }
+            d = prev_corner(d);
+        } while (d != c);
+
+        const int h = original.size();
+        original.push_back(-1);
+        dummy.push_back(true);
+        const int first = vertex.size() / 3;
+        const int n = hole.size();
+        for (int i = 0; i < n; i++)
+        {
+            const int t = first + i;
+            vertex.push_back(vertex[prev_corner(hole[i])]);
+            vertex.push_back(vertex[next_corner(hole[i])]);
+            vertex.push_back(h);
+            opposite.push_back(3 * (first + (i + n - 1) % n) + 1);
+            opposite.push_back(3 * (first + (i + 1) % n));
+            opposite.push_back(hole[i]);
+            opposite[hole[i]] = 3*t + 2;
+        }
+    }
+    const int T = vertex.size() / 3;
+
+    // Visit each connected part of the mesh, starting from its first
+    // triangle.
+    vector<bool> visited_triangle(T, false);
+    vector<bool> visited(original.size(), false);
+    // The decoded index of each split vertex, and the decoded triangles.
+    vector<int> decoded(original.size(), -1);
+    vector<int> triangles;
+    vector<int> predictors;
+    int components = 0;
+    string symbols;
+    string splits;
+    auto visit = [&](int s, int a, int b, int o)
+    {
+        visited[s] = true;
+        decoded[s] = predictors.size() / 3;
+        predictors.push_back(a == -1 ? -1 : decoded[a]);
+        predictors.push_back(b == -1 ? -1 : decoded[b]);
+        predictors.push_back(o == -1 ? -1 : decoded[o]);
+    };
+    Loops loops;
+    for (int t = 0; t < P; t++)
+    {
+        if (visited_triangle[t])
+        {
+            continue;
+        }
+        components++;
+        const int* v = &vertex[3*t];
+        if (visited[v[0]] || visited[v[1]] || visited[v[2]])
+        {
+            error = "couldn't start from triangle " + to_string(t);
+            return false;
+        }
+        visit(v[0], -1, -1, -1);
+        visit(v[1], v[0], -1, -1);
+        visit(v[2], v[1], -1, -1);
+        visited_triangle[t] = true;
+        triangles.push_back(t);
+        const int corners[3] = {opposite[3*t+2], opposite[3*t],
+                                opposite[3*t+1]};
+        int gate = loops.start(v, corners);
+        int size = 3;
+        while (true)
+        {
+            const int a = gate;
+            const int b = loops.next[a];
+            const int c = loops.corner[a];
+            if (visited_triangle[c / 3])
+            {
+                error = "triangle " + to_string(c / 3) + " was visited twice";
+                return false;
+            }
+            visited_triangle[c / 3] = true;
+            triangles.push_back(c / 3);
+            const int x = vertex[c];
+            const int left = opposite[next_corner(c)];
+            const int right = opposite[prev_corner(c)];
+            const int pa = loops.prev[a];
+            const int nb = loops.next[b];
+            if (!visited[x])
+            {
+                symbols += char(SYMBOL_C);
+                visit(x, loops.vertex[a], loops.vertex[b],
+                      vertex[opposite[c]]);
+                gate = loops.apply_c(a, x, left, right);
+                size++;
+            }
+            else if (x == loops.vertex[pa] && x == loops.vertex[nb])
+            {
+                symbols += char(SYMBOL_E);
+                if (loops.stack.empty())
+                {
+                    break;
+                }
+                gate = loops.stack.back().first;
+                size = loops.stack.back().second;
+                loops.stack.pop_back();
+            }
+            else if (x == loops.vertex[pa])
+            {
+                symbols += char(SYMBOL_L);
+                gate = loops.apply_l(a, right);
+                size--;
+            }
+            else if (x == loops.vertex[nb])
+            {
+                symbols += char(SYMBOL_R);
+                gate = loops.apply_r(a, left);
+                size--;
+            }
+            else
+            {
+                // Look for x both ways round the loop at once.
+                int forwards = loops.next[nb];
+                int backwards = loops.prev[pa];
+                int k = 2;
+                while (k < size && loops.vertex[forwards] != x &&
+                       loops.vertex[backwards] != x)
+                {
+                    forwards = loops.next[forwards];
+                    backwards = loops.prev[backwards];
+                    k++;
+                }
+                if (k >= size)
+                {
+                    // x is on a loop we've put aside, so the mesh has a hole
+                    // we didn't find or goes around on itself.
+                    error = "vertex " + to_string(original[x]) +
+                            " joins the mesh to itself";
+                    return false;
+                }
+                const bool is_forwards = loops.vertex[forwards] == x;
+                symbols += char(SYMBOL_S);
+                write_varint(2 * (k - 2) + (is_forwards ? 0 : 1), splits);
+                const pair<int, int> sizes = split_sizes(size, k, is_forwards);
+                const int x_node = is_forwards ? forwards : backwards;
+                loops.apply_s(a, x_node, left, right);
+                loops.stack.push_back(make_pair(a, sizes.second));
+                gate = x_node;
+                size = sizes.first;
+            }
+        }
+    }
+    if ((int) triangles.size() != T)
+    {
+        error = "some dummy triangles weren't visited";
+        return false;
+    }
+
+    // Number the decoded vertices like the decoder: in the order they were
+    // decoded, with dummy vertices removed, split vertices merged into the
+    // first of them and vertices without any triangles at the end.
+    const int D = predictors.size() / 3;
+    vector<int> decoded_split(D);
+    for (int s = 0; s < (int) original.size(); s++)
+    {
+        decoded_split[decoded[s]] = s;
+    }
+    vector<int> primary(V, -1);
+    vector<int> final_index(D, -1);
+    vector<int> vertex_map(V, -1);
+    vector<int> order;
+    string dummies;
+    string merges;
+    int last_dummy = 0;
+    int last_merge = 0;
+    int num_dummies = 0;
+    int num_merges = 0;
+    for (int d = 0; d < D; d++)
+    {
+        const int s = decoded_split[d];
+        if (dummy[s])
+        {
+            write_varint(d - last_dummy, dummies);
+            last_dummy = d + 1;
+            num_dummies++;
+            continue;
+        }
+        const int v = original[s];
+        if (primary[v] == -1)
+        {
+            primary[v] = d;
+            final_index[d] = order.size();
+            vertex_map[v] = order.size();
+            order.push_back(v);
+        }
+        else
+        {
+            write_varint(d - last_merge, merges);
+            write_varint(d - primary[v] - 1, merges);
+            last_merge = d + 1;
+            num_merges++;
+            final_index[d] = final_index[primary[v]];
+        }
+    }
+    string isolated;
+    int num_isolated = 0;
+    for (int v = 0; v < V; v++)
+    {
+        if (!has_fan[v])
+        {
+            write_varint(mesh.vertex_offsets[v+1] - mesh.vertex_offsets[v],
+                         isolated);
+            vertex_map[v] = order.size();
+            order.push_back(v);
+            num_isolated++;
+        }
+    }
+    vector<int> polygon_map(P, -1);
+    int num_real = 0;
+    for (int t : triangles)
+    {
+        if (t < P)
+        {
+            polygon_map[t] = num_real++;
+        }
+    }
+
+    // Predict each vertex from the triangle it was decoded from.
+    string geometry;
+    if (in.fixed_point)
+    {
+        vector<int64_t> xy(2 * V);
+        for (int i = 0; i < V; i++)
+        {
+            xy[2*i] = in.fixed_xy[2*order[i]];
+            xy[2*i+1] = in.fixed_xy[2*order[i]+1];
+        }
+        int64_t last[2] = {0, 0};
+        for (int i = 0; i < V; i++)
+        {
+            // Vertices without triangles can only be predicted from the
+            // last one.
+            int p[3] = {-1, -1, -1};
+            if (has_fan[order[i]])
+            {
+                final_predictors(predictors, final_index, primary[order[i]],
+                                 p);
+            }
+            int64_t guess[2];
+            predict(p, xy, last, guess);
+            for (int j = 0; j < 2; j++)
+            {
+                write_varint(delta(xy[2*i+j], guess[j]), geometry);
+                last[j] = xy[2*i+j];
+            }
+        }
+    }
+    else
+    {
+        // Doubles don't predict well, so just copy them.
+        for (int v : order)
+        {
+            geometry.append(
+                reinterpret_cast<const char*>(&mesh.vertex_xy[2*v]), 16);
+        }
+    }
+
+    const string* streams[NUM_STREAMS] = {&symbols, &splits, &dummies,
+                                          &merges, &isolated, &geometry};
+    string body;
+    for (const string* stream : streams)
+    {
+        string coded;
+        entropy_encode(*stream, coded);
+        write_varint(coded.size(), body);
+        body += coded;
+    }
+
+    // Vertices with more than one fan are put back together in the order the
+    // fans go around, but we don't know which way around the mesh lists
+    // them, so try both.
+    for (int reversed = 0; reversed < 2; reversed++)
+    {
+        string packed = "pakt";
+        write_varint(in.version, packed);
+        write_varint(V, packed);
+        write_varint(P, packed);
+        write_varint(in.fixed_point ? 0 : 1, packed);
+        write_varint(in.scale, packed);
+        write_varint(reversed, packed);
+        write_varint(components, packed);
+        write_varint(symbols.size(), packed);
+        write_varint(D, packed);
+        write_varint(num_dummies, packed);
+        write_varint(num_merges, packed);
+        write_varint(num_isolated, packed);
+        packed += body;
+
+        ExactMesh check;
+        if (!decode_edgebreaker(packed, check, error))
+        {
+            error = "couldn't decode it again (" + error + ")";
+            return false;
+        }
+        if (!same_mesh(in, check, vertex_map, polygon_map))
+        {
+            continue;
+        }
+        if (keep_order)
+        {
+            string order;
+            write_order(in, check, vertex_map, polygon_map, order);
+            string coded;
+            entropy_encode(order, coded);
+            write_varint(coded.size(), packed);
+            packed += coded;
+            ExactMesh exact;
+            if (!decode_edgebreaker(packed, exact, error))
+            {
+                error = "couldn't decode it again (" + error + ")";
+                return false;
+            }
+            if (!identical(in, exact))
+            {
+                error = "the decoded mesh is in a different order";
+                return false;
+            }
+        }
+        out += packed;
+        return true;
+    }
+    error = "the decoded mesh is different, as its vertices don't list "
+            "their polygons in order around them";
+    return false;
+}
+
+bool decode_edgebreaker(const string& data, ExactMesh& out, string& error)
+{
+    if (data.size() < 4 || data.compare(0, 4, "pakt") != 0)
+    {
+        error = "bad header";
+        return false;
+    }
+    StreamReader header(data);
+    header.pos += 4;
+    out.version = header.read(2);
+    const int V = header.read(INT32_MAX);
+    const int P = header.read(INT32_MAX);
+    out.fixed_point = header.read(1) == 0;
+    out.scale = header.read(MAX_SCALE);
+    const bool reversed = header.read(1);
+    // Everything else is limited so that there can't be more than INT32_MAX
+    // corners.
+    const int components = header.read(INT32_MAX / 6);
+    const int num_symbols = header.read(INT32_MAX / 6);
+    const int D = header.read(INT32_MAX);
+    const int num_dummies = header.read(D);
+    const int num_merges = header.read(D);
+    const int num_isolated = header.read(V);
+    if (!header.ok)
+    {
+        error = "bad header";
+        return false;
+    }
+    string streams[NUM_STREAMS + 1];
+    bool has_order = false;
+    for (int i = 0; i < NUM_STREAMS + 1; i++)
+    {
+        if (i == STREAM_ORDER)
+        {
+            if (header.finished())
+            {
+                break;
+            }
+            has_order = true;
+        }
+        const uint64_t size = header.read(header.end - header.pos);
+        if (!header.ok ||
+            !entropy_decode(header.pos, header.pos + size, streams[i]))
+        {
+            error = "bad stream";
+            return false;
+        }
+        header.pos += size;
+    }
+    if (!header.finished())
+    {
+        error = "data after the last stream";
+        return false;
+    }
+    const string& symbols = streams[STREAM_SYMBOLS];
+    if ((int) symbols.size() != num_symbols)
+    {
+        error = "wrong number of symbols";
+        return false;
+    }
+
+    // Rebuild the triangles, linking each corner to the corner opposite it.
+    const int T = components + num_symbols;
+    vector<int> vertex(3 * T, -1);
+    vector<int> opposite(3 * T, -1);
+    vector<int> vertex_corner;
+    vector<int> predictors;
+    StreamReader splits(streams[STREAM_SPLITS]);
+    bool ok = true;
+    auto link = [&](int c, int d)
+    {
+        ok = ok && opposite[c] == -1 && opposite[d] == -1;
+        opposite[c] = d;
+        opposite[d] = c;
+    };
+    auto add_vertex = [&](int corner, int a, int b, int o)
+    {
+        vertex_corner.push_back(corner);
+        predictors.push_back(a);
+        predictors.push_back(b);
+        predictors.push_back(o);
+        return (int) vertex_corner.size() - 1;
+    };
+    Loops loops;
+    int t = 0;
+    int s = 0;
+    for (int i = 0; i < components && ok; i++)
+    {
+        const int v0 = add_vertex(3*t, -1, -1, -1);
+        const int v1 = add_vertex(3*t + 1, v0, -1, -1);
+        const int v2 = add_vertex(3*t + 2, v1, -1, -1);
+        const int v[3] = {v0, v1, v2};
+        const int corners[3] = {3*t + 2, 3*t, 3*t + 1};
+        copy(v, v + 3, &vertex[3*t]);
+        int gate = loops.start(v, corners);
+        int size = 3;
+        t++;
+        while (ok)
+        {
+            if (s == num_symbols)
+            {
+                error = "not enough symbols";
+                return false;
+            }
+            const int a = gate;
+            const int b = loops.next[a];
+            const int pa = loops.prev[a];
+            const int nb = loops.next[b];
+            const int va = loops.vertex[a];
+            const int vb = loops.vertex[b];
+            link(3*t, loops.corner[a]);
+            int x = -1;
+            bool done = false;
+            switch (symbols[s++])
+            {
+            case SYMBOL_C:
+                x = add_vertex(3*t, va, vb, vertex[loops.corner[a]]);
+                gate = loops.apply_c(a, x, 3*t + 1, 3*t + 2);
+                size++;
+                break;
+            case SYMBOL_L:
+                ok = ok && size > 3;
+                x = loops.vertex[pa];
+                link(3*t + 1, loops.corner[pa]);
+                gate = loops.apply_l(a, 3*t + 2);
+                size--;
+                break;
+            case SYMBOL_R:
+                ok = ok && size > 3;
+                x = loops.vertex[nb];
+                link(3*t + 2, loops.corner[b]);
+                gate = loops.apply_r(a, 3*t + 1);
+                size--;
+                break;
+            case SYMBOL_E:
+                ok = ok && size == 3;
+                x = loops.vertex[pa];
+                link(3*t + 1, loops.corner[pa]);
+                link(3*t + 2, loops.corner[b]);
+                if (loops.stack.empty())
+                {
+                    done = true;
+                }
+                else
+                {
+                    gate = loops.stack.back().first;
+                    size = loops.stack.back().second;
+                    loops.stack.pop_back();
+                }
+                break;
+            case SYMBOL_S:
+            {
+                const uint64_t offset = splits.read(2 * size);
+                const int k = offset / 2 + 2;
+                const bool forwards = offset % 2 == 0;
+                if (!splits.ok || size - k < 3)
+                {
+                    error = "bad split";
+                    return false;
+                }
+                int x_node = forwards ? nb : pa;
+                for (int j = 1; j < k; j++)
+                {
+                    x_node = forwards ? loops.next[x_node]
+                                      : loops.prev[x_node];
+                }
+                x = loops.vertex[x_node];
+                const pair<int, int> sizes = split_sizes(size, k, forwards);
+                loops.apply_s(a, x_node, 3*t + 1, 3*t + 2);
+                loops.stack.push_back(make_pair(a, sizes.second));
+                gate = x_node;
+                size = sizes.first;
+                break;
+            }
+            default:
+                error = "bad symbol";
+                return false;
+            }
+            vertex[3*t] = x;
+            vertex[3*t + 1] = vb;
+            vertex[3*t + 2] = va;
+            t++;
+            if (done)
+            {
+                break;
+            }
+        }
+    }
+    if (!ok || s != num_symbols || !splits.finished() ||
+        (int) vertex_corner.size() != D)
+    {
+        error = "bad connectivity";
+        return false;
+    }
+    for (int c = 0; c < 3 * T; c++)
+    {
+        if (opposite[c] == -1)
+        {
+            error = "bad connectivity";
+            return false;
+        }
+    }
+
+    // Dummy vertices, and the triangles around them.
+    vector<bool> dummy(D, false);
+    StreamReader dummies(streams[STREAM_DUMMIES]);
+    int last = 0;
+    for (int i = 0; i < num_dummies && dummies.ok; i++)
+    {
+        // Each is written as the gap since the one before.
+        dummies.ok = last < D;
+        last += dummies.read(D - 1 - last);
+        if (dummies.ok)
+        {
+            dummy[last++] = true;
+        }
+    }
+    vector<int> polygon_index(T, -1);
+    int num_real = 0;
+    for (int i = 0; i < T; i++)
+    {
+        const int n = dummy[vertex[3*i]] + dummy[vertex[3*i+1]] +
+                      dummy[vertex[3*i+2]];
+        ok = ok && n < 2;
+        if (n == 0)
+        {
+            polygon_index[i] = num_real++;
+        }
+    }
+    if (!dummies.finished() || !ok || num_real != P)
+    {
+        error = "bad dummy vertices";
+        return false;
+    }
+
+    // Split vertices. The rest of each vertex's fans are chained from its
+    // first fan by next_fan.
+    vector<int> primary(D, -1);
+    vector<int> next_fan(D, -1);
+    vector<int> last_fan(D);
+    for (int d = 0; d < D; d++)
+    {
+        last_fan[d] = d;
+    }
+    StreamReader merges(streams[STREAM_MERGES]);
+    last = 0;
+    for (int i = 0; i < num_merges && merges.ok; i++)
+    {
+        // Each is written as the gap since the one before, then how far
+        // before it the first fan is.
+        merges.ok = last < D;
+        last += merges.read(D - 1 - last);
+        const int extra = last++;
+        const int first = extra - 1 - merges.read(max(extra - 1, 0));
+        if (!merges.ok || first < 0 || dummy[extra] || dummy[first] ||
+            primary[first] != -1)
+        {
+            merges.ok = false;
+            break;
+        }
+        primary[extra] = first;
+        next_fan[last_fan[first]] = extra;
+        last_fan[first] = extra;
+    }
+    if (!merges.finished())
+    {
+        error = "bad split vertices";
+        return false;
+    }
+    vector<int> final_index(D, -1);
+    vector<int> order;
+    for (int d = 0; d < D; d++)
+    {
+        if (dummy[d])
+        {
+            continue;
+        }
+        if (primary[d] == -1)
+        {
+            final_index[d] = order.size();
+            order.push_back(d);
+        }
+        else
+        {
+            final_index[d] = final_index[primary[d]];
+        }
+    }
+    if ((int) order.size() + num_isolated != V)
+    {
+        error = "wrong number of vertices";
+        return false;
+    }
+
+    // Coordinates.
+    StreamReader geometry(streams[STREAM_GEOMETRY]);
+    vector<double> xy(2 * V);
+    if (out.fixed_point)
+    {
+        const double power = pow(10.0, out.scale);
+        out.fixed_xy.resize(2 * V);
+        int64_t last_xy[2] = {0, 0};
+        for (int i = 0; i < V && geometry.ok; i++)
+        {
+            int p[3] = {-1, -1, -1};
+            if (i < (int) order.size())
+            {
+                final_predictors(predictors, final_index, order[i], p);
+            }
+            int64_t guess[2];
+            predict(p, out.fixed_xy, last_xy, guess);
+            for (int j = 0; j < 2; j++)
+            {
+                last_xy[j] = undelta(geometry.read(UINT64_MAX), guess[j]);
+                out.fixed_xy[2*i+j] = last_xy[j];
+                xy[2*i+j] = last_xy[j] / power;
+            }
+        }
+    }
+    else if (geometry.end - geometry.pos == 16 * int64_t(V))
+    {
+        memcpy(xy.data(), geometry.pos, 16 * size_t(V));
+        geometry.pos = geometry.end;
+    }
+    if (!geometry.finished())
+    {
+        error = "bad coordinates";
+        return false;
+    }
+
+    // Each vertex lists the triangles around each of its fans in order,
+    // with -1 after each fan which doesn't go all the way around.
+    vector<int> polygons;
+    vector<pair<double, int>> fans;
+    vector<int> fan_start;
+    StreamReader isolated(streams[STREAM_ISOLATED]);
+    for (int i = 0; i < V; i++)
+    {
+        polygons.clear();
+        if (i >= (int) order.size())
+        {
+            polygons.assign(isolated.read(P), -1);
+            out.mesh.add_vertex(xy[2*i], xy[2*i+1], polygons);
+            continue;
+        }
+        fans.clear();
+        fan_start.clear();
+        // Sort the fans by the direction of their first triangle, which goes
+        // the same way around as the triangles.
+        double area = 0;
+        for (int d = order[i]; d != -1; d = next_fan[d])
+        {
+            const int c = vertex_corner[d];
+            int first = c;
+            int corner = c;
+            do
+            {
+                if (vertex[corner] != d)
+                {
+                    error = "bad connectivity";
+                    return false;
+                }
+                const int before = prev_corner(opposite[prev_corner(corner)]);
+                if (polygon_index[before / 3] == -1 &&
+                    polygon_index[corner / 3] != -1)
+                {
+                    first = corner;
+                }
+                corner = before;
+            } while (corner != c);
+            fan_start.push_back(first);
+            double centre[2] = {0, 0};
+            double points[3][2];
+            for (int k = 0; k < 3; k++)
+            {
+                const int w = final_index[vertex[first - first % 3 + k]];
+                for (int j = 0; j < 2; j++)
+                {
+                    points[k][j] = w == -1 ? xy[2*i+j] : xy[2*w+j];
+                    centre[j] += points[k][j] / 3;
+                }
+            }
+            if (d == order[i])
+            {
+                area = (points[1][0] - points[0][0]) *
+                       (points[2][1] - points[0][1]) -
+                       (points[2][0] - points[0][0]) *
+                       (points[1][1] - points[0][1]);
+            }
+            const double angle = atan2(centre[1] - xy[2*i+1],
+                                       centre[0] - xy[2*i]);
+            fans.push_back(make_pair(area < 0 ? -angle : angle,
+                                     fans.size()));
+        }
+        sort(fans.begin(), fans.end());
+        for (const pair<double, int>& fan : fans)
+        {
+            const int first = fan_start[fan.second];
+            int corner = first;
+            do
+            {
+                const int p = polygon_index[corner / 3];
+                const int o = opposite[next_corner(corner)];
+                const int after = next_corner(o);
+                if (p != -1)
+                {
+                    polygons.push_back(p);
+                    if (polygon_index[after / 3] == -1)
+                    {
+                        polygons.push_back(-1);
+                    }
+                }
+                corner = after;
+            } while (corner != first);
+        }
+        if (reversed)
+        {
+            reverse(polygons.begin(), polygons.end());
+        }
+        out.mesh.add_vertex(xy[2*i], xy[2*i+1], polygons);
+    }
+    if (!isolated.finished())
+    {
+        error = "bad isolated vertices";
+        return false;
+    }
+
+    vector<int> vertices(3);
+    vector<int> neighbours(3);
+    for (int i = 0; i < T; i++)
+    {
+        if (polygon_index[i] == -1)
+        {
+            continue;
+        }
+        for (int j = 0; j < 3; j++)
+        {
+            vertices[j] = final_index[vertex[3*i+j]];
+            neighbours[j] = polygon_index[opposite[3*i + (j+1) % 3] / 3];
+        }
+        out.mesh.add_polygon(vertices, neighbours);
+    }
+    if (has_order && !apply_order(streams[STREAM_ORDER], out))
+    {
+        error = "bad order";
+        return false;
+    }
+    return true;
+}
+
+}
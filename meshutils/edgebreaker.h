@@ -0,0 +1,33 @@
+#pragma once
+#include "packing.h"
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Connectivity compression for triangle meshes ("pakt"), based on
+// Edgebreaker. See spec/packed/4.txt.
+// Instead of storing the vertices and neighbours of every triangle, the
+// triangles are visited in an order where each one can be described by a
+// single symbol, and the rest of the mesh is rebuilt from those.
+// The decoded mesh is the same mesh, but its vertices and triangles are
+// numbered in the order they were decoded, and each vertex's list of
+// polygons may start somewhere else around the vertex, unless the original
+// order was kept.
+
+// Appends the packed mesh to out.
+// If keep_order is true, it also stores how to put the decoded mesh back in
+// the original order, so it decodes to exactly the same mesh. This makes the
+// packed mesh two or three times bigger.
+// Returns false and sets error if the mesh can't be packed this way, like if
+// it has polygons which aren't triangles, or neighbours which don't agree.
+// The packed mesh is decoded before returning to make sure it is the same.
+bool encode_edgebreaker(const ExactMesh& mesh, string& out, string& error,
+                        bool keep_order = false);
+
+// Decodes a whole "pakt" file.
+// Returns false and sets error if it is invalid.
+bool decode_edgebreaker(const string& data, ExactMesh& out, string& error);
+
+}
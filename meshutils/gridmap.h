@@ -0,0 +1,41 @@
+#pragma once
+#include <iostream>
+#include <string>
+#include <vector>
+#include "timing.h"
+
+namespace meshutils
+{
+
+using namespace std;
+
+// An octile grid map, like the ones in maps.
+struct GridMap
+{
+    int width;
+    int height;
+    // traversable[y][x] is whether the cell (x, y) is traversable.
+    vector<vector<bool>> traversable;
+};
+
+// A polygon map (see spec/poly): the polygons around the obstacles, and
+// around the traversable areas inside those.
+struct PolyMap
+{
+    // The x and y of each point of each polygon.
+    vector<vector<double>> polygons;
+};
+
+// Reads a grid map. Returns false and sets error if it is invalid.
+bool read_gridmap(istream& infile, GridMap& out, string& error);
+
+// Traces the polygons around the obstacles of the map, like gridmap2poly.
+// Every point is on a grid corner.
+// If times isn't null, each phase of the tracing is timed into it.
+void trace_polygons(const GridMap& map, PolyMap& out,
+                    PhaseTimes* times = nullptr);
+
+// Writes a polymap (version 1). Whole coordinates are written as integers.
+void write_polymap(const PolyMap& polymap, ostream& outfile);
+
+}
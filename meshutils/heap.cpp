@@ -0,0 +1,60 @@
+// What the counting operator new and delete (heapnew.cpp) add up for
+// stats.h.
+#include "stats.h"
+#include <malloc.h>
+#include <algorithm>
+#include <atomic>
+
+namespace meshutils
+{
+
+namespace
+{
+
+// Set before any threads start (by parse_stats_arg, say), so they can read
+// it without locking.
+bool counting = false;
+
+atomic<long long> allocations(0);
+atomic<long long> allocated_bytes(0);
+thread_local ThreadHeap heap = {0, 0};
+
+}
+
+void count_heap()
+{
+    counting = true;
+}
+
+ThreadHeap& thread_heap()
+{
+    return heap;
+}
+
+void heap_totals(long long& allocations_out, long long& bytes_out)
+{
+    allocations_out = allocations;
+    bytes_out = allocated_bytes;
+}
+
+void heap_allocated(void* p)
+{
+    if (counting)
+    {
+        const long long bytes = malloc_usable_size(p);
+        heap.bytes += bytes;
+        heap.peak = std::max(heap.peak, heap.bytes);
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+    }
+}
+
+void heap_freed(void* p)
+{
+    if (counting)
+    {
+        heap.bytes -= malloc_usable_size(p);
+    }
+}
+
+}
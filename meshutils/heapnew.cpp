@@ -0,0 +1,31 @@
+// The operator new and delete which count allocations for stats.h. They're
+// on their own so the compiler can't see them being mixed with the standard
+// library's, and so only the tools get them: they aren't in
+// libnavmeshutils.a, as they would replace the allocator of every program
+// which links it. Programs which want the heap counted can link this too.
+#include "stats.h"
+#include <stdlib.h>
+#include <new>
+
+// Everything (including Fade2D) allocates through these, so counting here
+// catches it all.
+void* operator new(size_t size)
+{
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    meshutils::heap_allocated(p);
+    return p;
+}
+
+void operator delete(void* p) noexcept
+{
+    if (p == nullptr)
+    {
+        return;
+    }
+    meshutils::heap_freed(p);
+    free(p);
+}
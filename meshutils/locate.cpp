@@ -0,0 +1,422 @@
+#include "locate.h"
+#include "binmesh.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <string.h>
+#include <sys/mman.h>
+
+namespace meshutils
+{
+
+namespace
+{
+
+const size_t HEADER_SIZE = 80;
+// Points are located in chunks this big, so threads don't fight over them.
+const int BATCH_CHUNK = 1024;
+
+// Where each array starts in the file.
+struct Layout
+{
+    size_t bucket_offsets;
+    size_t bucket_polygons;
+    size_t polygon_offsets;
+    size_t polygon_xy;
+    size_t total;
+};
+
+size_t align(size_t n)
+{
+    return (n + 7) & ~size_t(7);
+}
+
+Layout get_layout(uint64_t buckets, uint64_t P, uint64_t num_bucket_polygons,
+                  uint64_t num_polygon_points)
+{
+    Layout out;
+    out.bucket_offsets = HEADER_SIZE;
+    out.bucket_polygons = align(out.bucket_offsets + 4 * (buckets + 1));
+    out.polygon_offsets = align(out.bucket_polygons + 4 * num_bucket_polygons);
+    out.polygon_xy = align(out.polygon_offsets + 4 * (P + 1));
+    out.total = out.polygon_xy + 16 * num_polygon_points;
+    return out;
+}
+
+template <typename T>
+void put(char* data, size_t offset, T value)
+{
+    memcpy(data + offset, &value, sizeof(T));
+}
+
+template <typename T>
+T get(const char* data, size_t offset)
+{
+    T out;
+    memcpy(&out, data + offset, sizeof(T));
+    return out;
+}
+
+// Which column (or row) v is in. Can be outside the grid.
+inline long long cell_of(double v, double min, double cell_size)
+{
+    return (long long) floor((v - min) / cell_size);
+}
+
+}
+
+PointLocator::PointLocator()
+    : num_polygons(0), columns(0), rows(0), min_x(0), min_y(0),
+      cell_size(1), bucket_offsets(nullptr), bucket_polygons(nullptr),
+      polygon_offsets(nullptr), polygon_xy(nullptr), data(nullptr), size(0)
+{
+}
+
+PointLocator::~PointLocator()
+{
+    close();
+}
+
+void PointLocator::close()
+{
+    if (data != nullptr)
+    {
+        munmap(data, size);
+    }
+    data = nullptr;
+    size = 0;
+    vector<uint64_t>().swap(buffer);
+    num_polygons = columns = rows = 0;
+    min_x = min_y = 0;
+    cell_size = 1;
+    bucket_offsets = polygon_offsets = nullptr;
+    bucket_polygons = nullptr;
+    polygon_xy = nullptr;
+}
+
+void PointLocator::point_at(const char* bytes)
+{
+    num_polygons = get<uint32_t>(bytes, 8);
+    columns = get<uint32_t>(bytes, 12);
+    rows = get<uint32_t>(bytes, 16);
+    min_x = get<double>(bytes, 24);
+    min_y = get<double>(bytes, 32);
+    cell_size = get<double>(bytes, 40);
+    const Layout layout = get_layout((uint64_t) columns * rows, num_polygons,
+                                     get<uint64_t>(bytes, 48),
+                                     get<uint64_t>(bytes, 56));
+    bucket_offsets = reinterpret_cast<const uint32_t*>(
+        bytes + layout.bucket_offsets);
+    bucket_polygons = reinterpret_cast<const int32_t*>(
+        bytes + layout.bucket_polygons);
+    polygon_offsets = reinterpret_cast<const uint32_t*>(
+        bytes + layout.polygon_offsets);
+    polygon_xy = reinterpret_cast<const double*>(bytes + layout.polygon_xy);
+}
+
+void PointLocator::build(const NavMesh& mesh)
+{
+    close();
+    const int P = mesh.num_polygons();
+
+    // Each polygon's bounding box, and the mesh's.
+    vector<double> boxes(4 * P);
+    double max_x = 0, max_y = 0;
+    for (int p = 0; p < P; p++)
+    {
+        double* box = &boxes[4 * p];
+        box[0] = box[1] = INFINITY;
+        box[2] = box[3] = -INFINITY;
+        for (int j = mesh.polygon_offsets[p]; j < mesh.polygon_offsets[p+1];
+             j++)
+        {
+            const int v = mesh.polygon_vertices[j];
+            const double x = mesh.vertex_xy[2*v];
+            const double y = mesh.vertex_xy[2*v+1];
+            box[0] = min(box[0], x);
+            box[1] = min(box[1], y);
+            box[2] = max(box[2], x);
+            box[3] = max(box[3], y);
+        }
+        if (p == 0)
+        {
+            min_x = box[0];
+            min_y = box[1];
+            max_x = box[2];
+            max_y = box[3];
+        }
+        min_x = min(min_x, box[0]);
+        min_y = min(min_y, box[1]);
+        max_x = max(max_x, box[2]);
+        max_y = max(max_y, box[3]);
+    }
+
+    // About as many buckets as polygons, so each has about one polygon in
+    // it (plus the ones which stick into it from next door).
+    const double width = max_x - min_x;
+    const double height = max_y - min_y;
+    if (width > 0 && height > 0)
+    {
+        cell_size = sqrt(width * height / max(P, 1));
+    }
+    else if (width > 0 || height > 0)
+    {
+        cell_size = max(width, height) / max(P, 1);
+    }
+    else
+    {
+        cell_size = 1;
+    }
+    // +1 so points on the top and right edges are in the grid.
+    columns = (int) floor(width / cell_size) + 1;
+    rows = (int) floor(height / cell_size) + 1;
+    const size_t buckets = (size_t) columns * rows;
+
+    // The buckets each polygon touches.
+    auto cells = [&](int p, int& c0, int& r0, int& c1, int& r1)
+    {
+        const double* box = &boxes[4 * p];
+        c0 = max(0LL, cell_of(box[0], min_x, cell_size));
+        r0 = max(0LL, cell_of(box[1], min_y, cell_size));
+        c1 = min(columns - 1LL, cell_of(box[2], min_x, cell_size));
+        r1 = min(rows - 1LL, cell_of(box[3], min_y, cell_size));
+    };
+    vector<uint32_t> offsets(buckets + 1, 0);
+    for (int p = 0; p < P; p++)
+    {
+        int c0, r0, c1, r1;
+        cells(p, c0, r0, c1, r1);
+        for (int r = r0; r <= r1; r++)
+        {
+            for (int c = c0; c <= c1; c++)
+            {
+                offsets[(size_t) r * columns + c + 1]++;
+            }
+        }
+    }
+    for (size_t b = 0; b < buckets; b++)
+    {
+        offsets[b+1] += offsets[b];
+    }
+    const uint64_t num_bucket_polygons = offsets[buckets];
+    const uint64_t num_polygon_points = mesh.polygon_vertices.size() + P;
+    const Layout layout = get_layout(buckets, P, num_bucket_polygons,
+                                     num_polygon_points);
+
+    // Zero-filled so the padding is zeroed too.
+    buffer.assign(layout.total / 8, 0);
+    char* bytes = reinterpret_cast<char*>(&buffer[0]);
+    memcpy(bytes + layout.bucket_offsets, &offsets[0], 4 * (buckets + 1));
+    // Polygons go in in order, so each bucket ends up sorted.
+    int32_t* out_polygons = reinterpret_cast<int32_t*>(
+        bytes + layout.bucket_polygons);
+    for (int p = 0; p < P; p++)
+    {
+        int c0, r0, c1, r1;
+        cells(p, c0, r0, c1, r1);
+        for (int r = r0; r <= r1; r++)
+        {
+            for (int c = c0; c <= c1; c++)
+            {
+                out_polygons[offsets[(size_t) r * columns + c]++] = p;
+            }
+        }
+    }
+    uint32_t* out_offsets = reinterpret_cast<uint32_t*>(
+        bytes + layout.polygon_offsets);
+    double* out_xy = reinterpret_cast<double*>(bytes + layout.polygon_xy);
+    size_t k = 0;
+    out_offsets[0] = 0;
+    for (int p = 0; p < P; p++)
+    {
+        const int begin = mesh.polygon_offsets[p];
+        const int end = mesh.polygon_offsets[p+1];
+        for (int j = begin; j <= end; j++)
+        {
+            // The first vertex again at the end.
+            const int v = mesh.polygon_vertices[j == end ? begin : j];
+            out_xy[2*k] = mesh.vertex_xy[2*v];
+            out_xy[2*k+1] = mesh.vertex_xy[2*v+1];
+            k++;
+        }
+        out_offsets[p+1] = k;
+    }
+
+    memcpy(bytes, "pidx", 4);
+    put<uint32_t>(bytes, 4, INDEX_FORMAT_VERSION);
+    put<uint32_t>(bytes, 8, P);
+    put<uint32_t>(bytes, 12, columns);
+    put<uint32_t>(bytes, 16, rows);
+    put<double>(bytes, 24, min_x);
+    put<double>(bytes, 32, min_y);
+    put<double>(bytes, 40, cell_size);
+    put<uint64_t>(bytes, 48, num_bucket_polygons);
+    put<uint64_t>(bytes, 56, num_polygon_points);
+    put<uint64_t>(bytes, 64, checksum(bytes + HEADER_SIZE,
+                                      layout.total - HEADER_SIZE));
+    put<uint64_t>(bytes, 72, layout.total);
+    point_at(bytes);
+}
+
+bool PointLocator::open(const string& filename, string& error,
+                        bool verify_checksum)
+{
+    close();
+    if (!is_little_endian())
+    {
+        error = "Indexes can only be read on little-endian hosts";
+        return false;
+    }
+
+    if (!map_file(filename, data, size, error))
+    {
+        return false;
+    }
+
+    const char* bytes = static_cast<const char*>(data);
+    #define REJECT(message) { error = message; close(); return false; }
+    if (size < HEADER_SIZE)
+    {
+        REJECT("File is too small to be an index");
+    }
+    if (memcmp(bytes, "pidx", 4) != 0)
+    {
+        REJECT("Invalid header (expecting 'pidx')");
+    }
+    if (get<uint32_t>(bytes, 4) != (uint32_t) INDEX_FORMAT_VERSION)
+    {
+        REJECT("Invalid version (expecting 1)");
+    }
+    const uint64_t P = get<uint32_t>(bytes, 8);
+    const uint64_t C = get<uint32_t>(bytes, 12);
+    const uint64_t R = get<uint32_t>(bytes, 16);
+    const uint64_t num_bucket_polygons = get<uint64_t>(bytes, 48);
+    const uint64_t num_polygon_points = get<uint64_t>(bytes, 56);
+    if (P > INT_MAX || C < 1 || C > INT_MAX || R < 1 || R > INT_MAX ||
+        C * R >= UINT32_MAX || num_bucket_polygons > UINT32_MAX ||
+        num_polygon_points > UINT32_MAX)
+    {
+        REJECT("Invalid number of polygons or buckets");
+    }
+    if (!(get<double>(bytes, 40) > 0))
+    {
+        REJECT("Invalid bucket size");
+    }
+    const Layout layout = get_layout(C * R, P, num_bucket_polygons,
+                                     num_polygon_points);
+    if (get<uint64_t>(bytes, 72) != layout.total || size != layout.total)
+    {
+        REJECT("File size does not match header");
+    }
+    if (verify_checksum &&
+        get<uint64_t>(bytes, 64) != checksum(bytes + HEADER_SIZE,
+                                             size - HEADER_SIZE))
+    {
+        REJECT("Checksum does not match");
+    }
+
+    // mmap gives us page-aligned memory, and every array is 8-byte aligned in
+    // the file, so we can point straight into it.
+    point_at(bytes);
+    if (bucket_offsets[0] != 0 ||
+        bucket_offsets[C * R] != num_bucket_polygons ||
+        polygon_offsets[0] != 0 || polygon_offsets[P] != num_polygon_points)
+    {
+        REJECT("Offsets do not match header");
+    }
+    // With the ends right, offsets which never go down stay in range.
+    for (uint64_t b = 0; b < C * R; b++)
+    {
+        if (bucket_offsets[b] > bucket_offsets[b+1])
+        {
+            REJECT("Bucket offsets go down at bucket " + to_string(b));
+        }
+    }
+    for (uint64_t i = 0; i < P; i++)
+    {
+        if (polygon_offsets[i] > polygon_offsets[i+1])
+        {
+            REJECT("Polygon offsets go down at polygon " + to_string(i));
+        }
+    }
+    for (uint64_t i = 0; i < num_bucket_polygons; i++)
+    {
+        if (bucket_polygons[i] < 0 || (uint64_t) bucket_polygons[i] >= P)
+        {
+            REJECT("Invalid polygon index " + to_string(bucket_polygons[i]) +
+                   " in a bucket");
+        }
+    }
+    #undef REJECT
+    return true;
+}
+
+void PointLocator::write(ostream& outfile) const
+{
+    if (!buffer.empty())
+    {
+        outfile.write(reinterpret_cast<const char*>(&buffer[0]),
+                      8 * buffer.size());
+    }
+    else if (data != nullptr)
+    {
+        outfile.write(static_cast<const char*>(data), size);
+    }
+}
+
+int PointLocator::locate(double x, double y) const
+{
+    // Written this way round so NaNs aren't anywhere.
+    if (!(x >= min_x && y >= min_y))
+    {
+        return -1;
+    }
+    const long long c = cell_of(x, min_x, cell_size);
+    const long long r = cell_of(y, min_y, cell_size);
+    if (c >= columns || r >= rows)
+    {
+        return -1;
+    }
+    const size_t b = (size_t) r * columns + c;
+    for (uint32_t i = bucket_offsets[b]; i < bucket_offsets[b+1]; i++)
+    {
+        const int p = bucket_polygons[i];
+        const double* v = polygon_xy + 2 * polygon_offsets[p];
+        const int n = polygon_offsets[p+1] - polygon_offsets[p] - 1;
+        // The point is inside (or on the edge) if it is on the same side of
+        // every edge. Whichever way round the polygon goes, that's the same
+        // as the cross products all being >= 0 or all being <= 0.
+        // The first vertex is repeated at the end, so there are no branches
+        // and the compiler is free to vectorise this.
+        double lo = 0, hi = 0;
+        for (int j = 0; j < n; j++)
+        {
+            const double cross = (v[2*j+2] - v[2*j]) * (y - v[2*j+1]) -
+                                 (v[2*j+3] - v[2*j+1]) * (x - v[2*j]);
+            lo = cross < lo ? cross : lo;
+            hi = cross > hi ? cross : hi;
+        }
+        if (lo >= 0 || hi <= 0)
+        {
+            return p;
+        }
+    }
+    return -1;
+}
+
+void PointLocator::locate_batch(const double* xy, int n, int* out,
+                                int threads) const
+{
+    const int chunks = (n + BATCH_CHUNK - 1) / BATCH_CHUNK;
+    parallel_for(chunks, threads, [&](int chunk)
+    {
+        const int end = min(n, (chunk + 1) * BATCH_CHUNK);
+        for (int i = chunk * BATCH_CHUNK; i < end; i++)
+        {
+            out[i] = locate(xy[2*i], xy[2*i+1]);
+        }
+    });
+}
+
+}
@@ -0,0 +1,83 @@
+#pragma once
+#include "navmesh.h"
+#include <stdint.h>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Point location index format version 1. See spec/index/1.txt.
+const int INDEX_FORMAT_VERSION = 1;
+
+// Finds which polygon of a mesh a point is in.
+// The bounding box of the mesh is split into a grid of square buckets, about
+// one per polygon, and each bucket lists the polygons whose bounding boxes
+// touch it. The coordinates of each polygon are copied into the index, so a
+// query only looks at the index, and the index can be used without the mesh.
+// It is stored exactly as it is written to a file, so it can be built in
+// memory or mmapped from a file with no parsing.
+class PointLocator
+{
+public:
+    int num_polygons;
+    int columns;
+    int rows;
+    double min_x;
+    double min_y;
+    double cell_size;
+
+    // The polygons touching bucket (column, row) are
+    // bucket_polygons[bucket_offsets[b]] to
+    // bucket_polygons[bucket_offsets[b+1]-1], where b = row * columns +
+    // column, in increasing order.
+    const uint32_t* bucket_offsets;
+    const int32_t* bucket_polygons;
+    // The vertices of polygon i are
+    // polygon_xy[2*polygon_offsets[i]] to polygon_xy[2*polygon_offsets[i+1]-1]
+    // as x0, y0, x1, y1, ..., with the first vertex repeated at the end.
+    const uint32_t* polygon_offsets;
+    const double* polygon_xy;
+
+    PointLocator();
+    ~PointLocator();
+
+    // Builds the index for the mesh in memory.
+    void build(const NavMesh& mesh);
+    // Maps the file and checks its header, sizes, offsets, polygon indices
+    // and (if asked to) checksum.
+    // Returns false and sets error if the file is not a valid index.
+    bool open(const string& filename, string& error,
+              bool verify_checksum = true);
+    void close();
+
+    // Writes the index (built or opened) to a file.
+    void write(ostream& outfile) const;
+
+    // The polygon the point is in, or -1 if it isn't in any. Points on an
+    // edge shared by several polygons get the lowest numbered one.
+    int locate(double x, double y) const;
+    // Locates n points, with xy as x0, y0, x1, y1, ... and out as the polygon
+    // for each, using up to threads threads (0 for one per core).
+    void locate_batch(const double* xy, int n, int* out,
+                      int threads = 0) const;
+
+private:
+    // Built indexes are kept here, laid out exactly as in the file. Words,
+    // so the doubles are aligned.
+    vector<uint64_t> buffer;
+    // Opened indexes are mmapped instead.
+    void* data;
+    size_t size;
+
+    // Points the arrays at the index starting at bytes.
+    void point_at(const char* bytes);
+
+    PointLocator(const PointLocator&);
+    PointLocator& operator=(const PointLocator&);
+};
+
+}
@@ -0,0 +1,515 @@
+#include "mapgen.h"
+#include "parallel.h"
+#include "stats.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace meshutils
+{
+
+namespace
+{
+
+// Each thread makes about this many bytes of rows at a time.
+const int CHUNK_BYTES = 1 << 20;
+const int CHUNKS_PER_WRITE = 64;
+// Each octave of the islands' noise is half the size of the last.
+const int ISLAND_OCTAVES = 4;
+
+const char BLOCKED = '@';
+const char TRAVERSABLE = '.';
+
+// splitmix64's mixer, so each cell can have its own random number without
+// going through the cells before it.
+uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ull;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+// A random number for each line (row or column) of the map, different for
+// each use.
+uint64_t line_key(uint64_t seed, int use, int line)
+{
+    return mix(seed ^ mix(use ^ mix(uint32_t(line))));
+}
+
+// A random number for cell x of the line key is for.
+uint64_t cell_hash(uint64_t key, int x)
+{
+    return mix(key ^ uint32_t(x));
+}
+
+// Between 0 and 1.
+double unit(uint64_t h)
+{
+    return (h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double smooth(double t)
+{
+    return t * t * (3 - 2 * t);
+}
+
+// Eller's algorithm, which makes a perfect maze a row at a time while only
+// remembering which cells of the last row are joined up.
+class MazeRows
+{
+public:
+    struct Row
+    {
+        // Whether there's a wall to the right of (below) each cell.
+        vector<char> right;
+        vector<char> down;
+    };
+
+    MazeRows(int width, int height, uint64_t seed)
+        : width(width), height(height), made(0), rng(seed), set(width)
+    {
+        for (int i = 0; i < width; i++)
+        {
+            set[i] = i;
+        }
+    }
+
+    // Makes the next row. The last row joins everything left over.
+    void next(Row& row)
+    {
+        const bool last = ++made == height;
+        row.right.assign(width, 1);
+        row.down.assign(width, 1);
+        parent.resize(width);
+        for (int i = 0; i < width; i++)
+        {
+            parent[i] = i;
+        }
+        for (int i = 0; i + 1 < width; i++)
+        {
+            const int a = find(set[i]);
+            const int b = find(set[i+1]);
+            if (a != b && (last || random() % 2 == 0))
+            {
+                parent[a] = b;
+                row.right[i] = 0;
+            }
+        }
+        if (last)
+        {
+            return;
+        }
+        // Each set needs a way down, or it would be cut off. pick is a
+        // random cell of each set (by reservoir sampling) in case none of
+        // them happen to get one.
+        count.assign(width, 0);
+        pick.assign(width, -1);
+        has_down.assign(width, 0);
+        for (int i = 0; i < width; i++)
+        {
+            const int s = find(set[i]);
+            set[i] = s;
+            if (random() % ++count[s] == 0)
+            {
+                pick[s] = i;
+            }
+            if (random() % 2 == 0)
+            {
+                row.down[i] = 0;
+                has_down[s] = 1;
+            }
+        }
+        for (int s = 0; s < width; s++)
+        {
+            if (count[s] > 0 && !has_down[s])
+            {
+                row.down[pick[s]] = 0;
+            }
+        }
+        // Cells with no way down start a new set in the next row. Sets are
+        // renumbered so they stay below width.
+        label.assign(width, -1);
+        int labels = 0;
+        for (int i = 0; i < width; i++)
+        {
+            if (!row.down[i])
+            {
+                if (label[set[i]] == -1)
+                {
+                    label[set[i]] = labels++;
+                }
+                set[i] = label[set[i]];
+            }
+            else
+            {
+                set[i] = -1;
+            }
+        }
+        for (int i = 0; i < width; i++)
+        {
+            if (set[i] == -1)
+            {
+                set[i] = labels++;
+            }
+        }
+    }
+
+private:
+    int width;
+    int height;
+    int made;
+    uint64_t rng;
+    // Which set each cell of the last row is in.
+    vector<int> set;
+    // Scratch space for next.
+    vector<int> parent;
+    vector<int> count;
+    vector<int> pick;
+    vector<char> has_down;
+    vector<int> label;
+
+    uint64_t random()
+    {
+        rng += 0x9e3779b97f4a7c15ull;
+        return mix(rng);
+    }
+
+    int find(int s)
+    {
+        while (parent[s] != s)
+        {
+            parent[s] = parent[parent[s]];
+            s = parent[s];
+        }
+        return s;
+    }
+};
+
+class Generator
+{
+public:
+    Generator(const MapOptions& options)
+        : o(options), pitch(1), maze_width(0), maze_height(0),
+          maze(0, 0, 0), maze_first(0), door(1)
+    {
+        if (o.type == MAP_MAZE)
+        {
+            // Corridors are size wide, with walls one cell wide between
+            // and around them. Anything left over on the right and bottom
+            // is blocked.
+            pitch = o.size + 1;
+            maze_width = max(0, (o.width - 1) / pitch);
+            maze_height = max(0, (o.height - 1) / pitch);
+            maze = MazeRows(maze_width, maze_height, mix(o.seed));
+        }
+        if (o.type == MAP_ROOMS)
+        {
+            door = max(1, (o.size - 1) / 4);
+        }
+        if (o.type == MAP_ISLANDS)
+        {
+            // How far across its lattice cell each cell of each octave is,
+            // smoothed.
+            for (int octave = 0; octave < ISLAND_OCTAVES; octave++)
+            {
+                const int size = max(1, o.size >> octave);
+                weights.push_back(vector<double>(size));
+                for (int i = 0; i < size; i++)
+                {
+                    weights.back()[i] = smooth((i + 0.5) / size);
+                }
+            }
+        }
+    }
+
+    // Makes sure maze_rows has every row of the maze rows first to last-1
+    // need. They have to be asked for in order.
+    void prepare(int first, int last)
+    {
+        if (o.type != MAP_MAZE || maze_width == 0 || maze_height == 0)
+        {
+            return;
+        }
+        // Wall rows need the maze row above them too.
+        const int lowest = max(0, first / pitch - 1);
+        const int highest = min(maze_height - 1, (last - 1) / pitch);
+        const int drop = min((int) maze_rows.size(), lowest - maze_first);
+        if (drop > 0)
+        {
+            maze_rows.erase(maze_rows.begin(), maze_rows.begin() + drop);
+            maze_first += drop;
+        }
+        while (maze_first + (int) maze_rows.size() <= highest)
+        {
+            maze_rows.push_back(MazeRows::Row());
+            maze.next(maze_rows.back());
+        }
+    }
+
+    // Writes row y, with no newline, to out. scratch is for the islands.
+    void row(int y, char* out, vector<double>& scratch) const
+    {
+        switch (o.type)
+        {
+            case MAP_RANDOM:
+                random_cells(y, 0, o.width, o.density, out);
+                break;
+            case MAP_ROOMS:
+                rooms_row(y, out);
+                break;
+            case MAP_MAZE:
+                maze_row(y, out);
+                break;
+            case MAP_ISLANDS:
+                islands_row(y, out, scratch);
+                break;
+        }
+    }
+
+private:
+    const MapOptions& o;
+    int pitch;
+    int maze_width;
+    int maze_height;
+    MazeRows maze;
+    // The maze rows made so far which are still needed, from maze_first on.
+    vector<MazeRows::Row> maze_rows;
+    int maze_first;
+    int door;
+    vector<vector<double>> weights;
+
+    // Where the door is in wall wall of the line of rooms line, for walls
+    // going each way, along the rooms (whose first cell is 1) which are
+    // length long. It's -1 if there's no room for one.
+    int door_start(int way, int wall, int line, int length) const
+    {
+        // The rooms at the bottom and right may be cut off.
+        const int inside = min(o.size, length - line * o.size) - 1;
+        if (inside < door)
+        {
+            return inside > 0 ? 1 : -1;
+        }
+        return 1 + cell_hash(line_key(o.seed, 1 + way, wall), line) %
+                   (inside - door + 1);
+    }
+
+    // Blocks cells first to last-1 of row y with probability density.
+    void random_cells(int y, int first, int last, double density,
+                      char* out) const
+    {
+        const uint64_t key = line_key(o.seed, 0, y);
+        for (int x = first; x < last; x++)
+        {
+            out[x] = unit(cell_hash(key, x)) < density
+                     ? BLOCKED : TRAVERSABLE;
+        }
+    }
+
+    bool in_door(int offset, int start) const
+    {
+        return start != -1 && offset >= start && offset < start + door;
+    }
+
+    // Walls go along every size-th row and column, except at the edges of
+    // the map, which are walls already.
+    void rooms_row(int y, char* out) const
+    {
+        const int room_y = y / o.size;
+        const int offset_y = y % o.size;
+        if (offset_y == 0 && y > 0)
+        {
+            for (int x = 0; x < o.width; x++)
+            {
+                const int room_x = x / o.size;
+                const int offset_x = x % o.size;
+                const bool open = offset_x != 0 && in_door(
+                    offset_x, door_start(1, room_y, room_x, o.width));
+                out[x] = open ? TRAVERSABLE : BLOCKED;
+            }
+            return;
+        }
+        for (int x = 0; x < o.width; x++)
+        {
+            const int offset_x = x % o.size;
+            if (offset_x == 0 && x > 0)
+            {
+                const bool open = in_door(
+                    offset_y,
+                    door_start(0, x / o.size, room_y, o.height));
+                out[x] = open ? TRAVERSABLE : BLOCKED;
+            }
+            else
+            {
+                random_cells(y, x, x + 1, o.room_density, out);
+            }
+        }
+    }
+
+    void maze_row(int y, char* out) const
+    {
+        fill(out, out + o.width, BLOCKED);
+        const int maze_y = y / pitch;
+        const bool wall_row = y % pitch == 0;
+        if (maze_width == 0 || maze_y > maze_height ||
+            (maze_y == maze_height && !wall_row) ||
+            (wall_row && (maze_y == 0 || maze_y == maze_height)))
+        {
+            return;
+        }
+        if (wall_row)
+        {
+            const MazeRows::Row& above =
+                maze_rows[maze_y - 1 - maze_first];
+            for (int x = 1; x < maze_width * pitch; x++)
+            {
+                if (x % pitch != 0 && !above.down[x / pitch])
+                {
+                    out[x] = TRAVERSABLE;
+                }
+            }
+            return;
+        }
+        const MazeRows::Row& row = maze_rows[maze_y - maze_first];
+        for (int x = 1; x < maze_width * pitch; x++)
+        {
+            if (x % pitch != 0 || !row.right[x / pitch - 1])
+            {
+                out[x] = TRAVERSABLE;
+            }
+        }
+    }
+
+    // Fractal value noise, cut into bands which are blocked and traversable
+    // in turn, so each band is a ring around the ones inside it.
+    void islands_row(int y, char* out, vector<double>& scratch) const
+    {
+        // The noise along the row, then down each lattice column at this
+        // row.
+        scratch.assign(2 * o.width + 2, 0.0);
+        double* noise = scratch.data();
+        double* column = noise + o.width;
+        double amplitude = 1;
+        double total = 0;
+        for (int octave = 0; octave < ISLAND_OCTAVES; octave++)
+        {
+            const vector<double>& weight = weights[octave];
+            const int size = weight.size();
+            const double t = weight[y % size];
+            const uint64_t above = line_key(o.seed, 3 + octave, y / size);
+            const uint64_t below = line_key(o.seed, 3 + octave,
+                                            y / size + 1);
+            const int columns = o.width / size + 2;
+            for (int i = 0; i < columns; i++)
+            {
+                const double a = unit(cell_hash(above, i));
+                const double b = unit(cell_hash(below, i));
+                column[i] = amplitude * (a + (b - a) * t);
+            }
+            for (int i = 0, x = 0; x < o.width; i++)
+            {
+                const int stop = min(o.width, x + size);
+                for (int offset = 0; x < stop; x++, offset++)
+                {
+                    noise[x] += column[i] +
+                                (column[i+1] - column[i]) * weight[offset];
+                }
+            }
+            total += amplitude;
+            amplitude /= 2;
+        }
+        // The noise is mostly near the middle, so the bands are spread
+        // over the middle half.
+        for (int x = 0; x < o.width; x++)
+        {
+            const double v = (noise[x] / total - 0.25) * 2;
+            const int band = max(0.0, min(v, 0.999)) * (2 * o.levels);
+            out[x] = band % 2 ? BLOCKED : TRAVERSABLE;
+        }
+    }
+};
+
+}
+
+bool parse_map_type(const string& name, MapType& type)
+{
+    const char* const names[] = {"random", "rooms", "maze", "islands"};
+    const MapType types[] = {MAP_RANDOM, MAP_ROOMS, MAP_MAZE, MAP_ISLANDS};
+    for (int i = 0; i < 4; i++)
+    {
+        if (name == names[i])
+        {
+            type = types[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool generate_gridmap(const MapOptions& options, int threads,
+                      ostream& outfile, string& error)
+{
+    if (options.width < 1 || options.height < 1)
+    {
+        error = "Width and height must be positive";
+        return false;
+    }
+    if (!(options.density >= 0 && options.density <= 1) ||
+        !(options.room_density >= 0 && options.room_density <= 1))
+    {
+        error = "Density must be between 0 and 1";
+        return false;
+    }
+    // Rooms need space for a wall and a cell.
+    if (options.size < (options.type == MAP_ROOMS ? 2 : 1) ||
+        options.levels < 1)
+    {
+        error = "Size or levels too small";
+        return false;
+    }
+    // A maze needs room for one corridor and the walls on either side of it,
+    // or it would be all wall.
+    if (options.type == MAP_MAZE &&
+        (options.width < options.size + 2 ||
+         options.height < options.size + 2))
+    {
+        error = "Width and height must be at least size + 2 (" +
+                to_string(options.size + 2) + ") for a maze";
+        return false;
+    }
+
+    outfile << "type octile\nheight " << options.height << "\nwidth "
+            << options.width << "\nmap\n";
+    Generator generator(options);
+    const int chunk_rows = max(1, CHUNK_BYTES / (options.width + 1));
+    const int batch_rows = chunk_rows * CHUNKS_PER_WRITE;
+    vector<string> buffers(CHUNKS_PER_WRITE);
+    for (int first = 0; first < options.height; first += batch_rows)
+    {
+        const int last = min(options.height, first + batch_rows);
+        generator.prepare(first, last);
+        const int chunks = (last - first + chunk_rows - 1) / chunk_rows;
+        parallel_for(chunks, threads, [&](int i)
+        {
+            StatsPhase phase("generate");
+            const int begin = first + i * chunk_rows;
+            const int end = min(last, begin + chunk_rows);
+            string& text = buffers[i];
+            text.assign((size_t) (end - begin) * (options.width + 1), '\n');
+            vector<double> scratch;
+            for (int y = begin; y < end; y++)
+            {
+                generator.row(y, &text[(size_t) (y - begin) *
+                                       (options.width + 1)], scratch);
+            }
+        });
+        StatsPhase phase("write");
+        for (int i = 0; i < chunks; i++)
+        {
+            outfile.write(buffers[i].data(), buffers[i].size());
+        }
+    }
+    return true;
+}
+
+}
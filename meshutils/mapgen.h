@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// The kinds of map generate_gridmap can make.
+enum MapType
+{
+    // Each cell is blocked at random, like the random512-* maps.
+    MAP_RANDOM,
+    // A grid of square rooms with a door in each wall, like the room32-*
+    // maps, with cells inside the rooms blocked at random.
+    MAP_ROOMS,
+    // A perfect maze (exactly one way between any two cells), like the
+    // maze512-* maps.
+    MAP_MAZE,
+    // Smooth random islands, with lakes in them, and islands in those, and
+    // so on, which make polygons with lots of holes.
+    MAP_ISLANDS
+};
+
+struct MapOptions
+{
+    MapType type;
+    int width;
+    int height;
+    // How much of the map is blocked (random).
+    double density;
+    // How much of each room is blocked (rooms).
+    double room_density;
+    // The distance from one room wall to the next (rooms), the width of the
+    // corridors (maze) or the size of the biggest islands (islands).
+    int size;
+    // How many times islands and lakes nest (islands).
+    int levels;
+    // The same options and seed always give the same map.
+    uint64_t seed;
+
+    MapOptions()
+        : type(MAP_RANDOM), width(512), height(512), density(0.2),
+          room_density(0), size(32), levels(3), seed(0)
+    {
+    }
+};
+
+// Gets the type out of random, rooms, maze or islands. Returns false if name
+// isn't one of those.
+bool parse_map_type(const string& name, MapType& type);
+
+// Writes an octile map (like the ones in maps) as it is made, a batch of rows
+// at a time, so maps far too big to fit in memory can be made. The rows of
+// each batch are made on up to threads threads (0 for one per core), and
+// come out the same whatever threads is.
+// Returns false and sets error, writing nothing, if the options can't make a
+// map (such as a maze with no room for a single corridor).
+bool generate_gridmap(const MapOptions& options, int threads,
+                      ostream& outfile, string& error);
+
+}
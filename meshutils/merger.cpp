@@ -0,0 +1,1528 @@
+// Merging polygons, taken from meshmerger.
+#include "merger.h"
+#include "stats.h"
+#include <memory>
+#include <cassert>
+#include <numeric>
+#include <climits>
+#include <cmath>
+#include <queue>
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+
+namespace meshutils
+{
+
+namespace
+{
+
+// We need union find!
+struct UnionFind
+{
+    vector<int> parent;
+
+    UnionFind(int n) : parent(n)
+    {
+        iota(parent.begin(), parent.end(), 0);
+    }
+
+    int find(int x)
+    {
+        if (x == -1)
+        {
+            return -1;
+        }
+        if (parent[x] != x)
+        {
+            parent[x] = find(parent[x]);
+        }
+        return parent[x];
+    }
+
+    // can't use "union" as that's a keyword!
+    // also: don't use union by rank as we need find(x) == x after merge.
+    void merge(int x, int y)
+    {
+        x = find(x);
+        y = find(y);
+        parent[y] = x;
+    }
+};
+
+// We need a circular linked list of sorts.
+// This is going to be used a lot - for polys around point and for merging the
+// two polygon arrays together.
+// We'll just use a std::shared_ptr to handle our memory...
+struct ListNode
+{
+    ListNode* next;
+    int val;
+
+    ListNode* go(int n) const
+    {
+        ListNode* out = next;
+        for (int i = 1; i < n; i++)
+        {
+            out = out->next;
+        }
+        return out;
+    }
+};
+
+typedef ListNode* ListNodePtr;
+
+struct Point
+{
+    double x, y;
+
+    Point operator+(const Point& other) const
+    {
+        return {x + other.x, y + other.y};
+    }
+
+    Point operator-(const Point& other) const
+    {
+        return {x - other.x, y - other.y};
+    }
+
+    double operator*(const Point& other) const
+    {
+        return x * other.y - y * other.x;
+    }
+};
+
+struct Vertex
+{
+    Point p;
+    int num_polygons;
+    ListNodePtr polygons;
+};
+
+struct Polygon
+{
+    int num_vertices;
+    int num_traversable;
+    double area;
+    double perimeter;
+    // Search effort spent in this polygon, from the profile.
+    double heat;
+    ListNodePtr vertices;
+    // Stores the original polygons.
+    // To get the actual polygon, do polygon_unions.find on the polygon you get.
+    ListNodePtr polygons;
+};
+
+struct SearchNode
+{
+    // Index of poly.
+    int index;
+    // Priority of the best tentative merge.
+    double priority;
+
+    // Comparison.
+    // Always take the "biggest" search node in a priority queue.
+    bool operator<(const SearchNode& other) const
+    {
+        return priority < other.priority;
+    }
+
+    bool operator>(const SearchNode& other) const
+    {
+        return priority > other.priority;
+    }
+};
+
+inline bool cw(const Point& a, const Point& b, const Point& c)
+{
+    return (b - a) * (c - b) < -1e-8;
+}
+
+// Merge objectives for smart_merge.
+// Each takes the two polygons we want to merge and the length of the edge they
+// share, and returns how much we want to do that merge.
+// smart_merge does the merge with the highest priority first, and never does
+// a merge with a priority of 0 or less.
+typedef double (*MergePriority)(const Polygon& a, const Polygon& b,
+                                double shared_length);
+
+// Make the biggest polygon we can.
+double area_priority(const Polygon& a, const Polygon& b, double)
+{
+    return a.area + b.area;
+}
+
+// How much expanding a search node into a polygon costs, compared to looking
+// at one of the polygon's edges.
+const double EXPANSION_COST = 4;
+
+// Rough estimate of how much search effort a polygon costs.
+// The number of random straight lines which cross a convex polygon is
+// proportional to its perimeter (Cauchy-Crofton), so we use that for how often
+// a search goes through it. Each time it does, we expand it: we look at every
+// edge and generate a successor for every traversable edge.
+// Dead ends get pruned without being expanded unless they have the goal, so
+// we say they're free.
+double search_cost(int num_vertices, int num_traversable, double perimeter)
+{
+    if (num_traversable <= 1)
+    {
+        return 0;
+    }
+    return perimeter * (EXPANSION_COST + num_vertices + num_traversable);
+}
+
+double search_cost(const Polygon& p)
+{
+    return search_cost(p.num_vertices, p.num_traversable, p.perimeter);
+}
+
+// Make the estimated search cost go down as much as we can.
+// Merging in the order the estimate goes down leaves long thin polygons on
+// grid meshes, which can't be merged with their neighbours as they share more
+// than one edge with them. So merges still go biggest first, like
+// area_priority, but ones which make the estimate go down get up to twice the
+// priority, and ones which make it go up get less.
+// No merge is turned down, as the estimate is too rough for that: every merge
+// still saves a search expanding one more node.
+double cost_priority(const Polygon& a, const Polygon& b, double shared_length)
+{
+    const double cost = search_cost(a) + search_cost(b);
+    const double merged_cost = search_cost(
+        a.num_vertices + b.num_vertices - 2,
+        a.num_traversable + b.num_traversable - 2,
+        a.perimeter + b.perimeter - 2 * shared_length);
+    // How much of the cost the merge saves. At most 1.
+    const double saved = cost > 0 ? (cost - merged_cost) / cost : 0;
+    return (a.area + b.area) * (saved > 0 ? 1 + saved : 1 / (1 - saved));
+}
+
+// Indexed by MergeObjective.
+const MergePriority PRIORITIES[] = {area_priority, cost_priority};
+
+}
+
+const char* const OBJECTIVE_NAMES[NUM_OBJECTIVES] = {"area", "cost"};
+
+namespace
+{
+
+// Everything about the mesh we're merging.
+struct Merger
+{
+    const MergeOptions& options;
+    // Where the stages are timed (which may not be options.times, see
+    // merge_mesh).
+    PhaseTimes* times;
+    // Always counted, as it's only a few increments.
+    MergeCounters counters;
+    // options.trace, until the merging is done.
+    ostream* trace;
+
+    vector<ListNodePtr> list_nodes;
+
+    // We'll keep all vertices, but we may throw them out in the end if
+    // num_polygons is 0.
+    // We'll figure it out once we're finished.
+    vector<Vertex> mesh_vertices;
+
+    // We'll also keep all polygons, but we'll throw them out like above.
+    vector<Polygon> mesh_polygons;
+
+    UnionFind polygon_unions;
+
+    Merger(const MergeOptions& options, PhaseTimes* times)
+        : options(options), times(times), trace(options.trace),
+          polygon_unions(0) {}
+    ~Merger()
+    {
+        for (auto x : list_nodes)
+        {
+            delete x;
+        }
+    }
+
+    // Traces "event;polygon;other" (see MergeOptions::trace), leaving out
+    // the polygons which aren't given.
+    void trace_event(const char* event, int polygon = -1, int other = -1)
+    {
+        if (trace == nullptr)
+        {
+            return;
+        }
+        *trace << event;
+        if (polygon != -1)
+        {
+            *trace << ";" << polygon;
+        }
+        if (other != -1)
+        {
+            *trace << ";" << other;
+        }
+        *trace << "\n";
+    }
+
+    ListNodePtr make_node(ListNodePtr next, int val)
+    {
+        ListNodePtr out = new ListNode {next, val};
+        list_nodes.push_back(out);
+        return out;
+    }
+
+    double get_area(ListNodePtr vertices);
+    double edge_length(int a, int b);
+    double get_perimeter(ListNodePtr vertices);
+    void read_mesh(const NavMesh& mesh);
+
+    bool can_merge(int x, ListNodePtr v, ListNodePtr p, bool convex = true);
+    void unlink_merged_polygon(int v, int x, int merge_index);
+    void merge(int x, ListNodePtr v, ListNodePtr p, bool convex = true);
+    void check_correct();
+
+    void merge_deadend();
+    double get_priority(const Polygon& a, const Polygon& b,
+                        double shared_length);
+    void smart_merge(bool keep_deadends = true);
+    void hertel_mehlhorn_merge(bool keep_deadends = true);
+    bool is_simple_union(const vector<vector<int>>& region_vertices,
+                         const vector<vector<int>>& region_neighbours,
+                         unsigned mask, bool& convex);
+    void optimal_merge_region(const vector<int>& region);
+    void optimal_merge(int region_limit, bool keep_deadends = true);
+
+    int count_polygons();
+    template <typename Stage>
+    void run_stage(const string& name, Stage stage);
+    void run_merge();
+    void report_counters();
+
+    MeshStats get_stats();
+    int get_vertex_mapping(vector<int>& vertex_mapping);
+    int get_polygon_mapping(vector<int>& polygon_mapping);
+    void get_mesh(NavMesh& out);
+};
+
+// Actually returns double the area of the polygon...
+// Assume that mesh_vertices is populated and is valid.
+double Merger::get_area(ListNodePtr vertices)
+{
+    // first point x second point + second point x third point + ...
+    double out = 0;
+
+    ListNodePtr start_vertex = vertices;
+    bool is_first = true;
+
+    while (is_first || start_vertex != vertices)
+    {
+        is_first = false;
+        out += mesh_vertices[vertices->val].p *
+               mesh_vertices[vertices->next->val].p;
+        vertices = vertices->next;
+    }
+
+    return out;
+}
+
+double Merger::edge_length(int a, int b)
+{
+    const Point d = mesh_vertices[b].p - mesh_vertices[a].p;
+    return sqrt(d.x * d.x + d.y * d.y);
+}
+
+double Merger::get_perimeter(ListNodePtr vertices)
+{
+    double out = 0;
+
+    ListNodePtr start_vertex = vertices;
+    bool is_first = true;
+
+    while (is_first || start_vertex != vertices)
+    {
+        is_first = false;
+        out += edge_length(vertices->val, vertices->next->val);
+        vertices = vertices->next;
+    }
+
+    return out;
+}
+
+// taken from structs/mesh.cpp
+// The mesh has already been checked by read_text_mesh.
+void Merger::read_mesh(const NavMesh& mesh)
+{
+    const vector<double>& polygon_heat = options.polygon_heat;
+    const int V = mesh.num_vertices();
+    const int P = mesh.num_polygons();
+
+    mesh_vertices.resize(V);
+    mesh_polygons.resize(P);
+    polygon_unions = UnionFind(P);
+
+    // Makes a circular list of [first, last).
+    auto make_list = [this](const int* first, const int* last)
+    {
+        ListNodePtr head = make_node(nullptr, *first);
+        ListNodePtr cur_node = head;
+        for (const int* it = first + 1; it != last; it++)
+        {
+            cur_node->next = make_node(nullptr, *it);
+            cur_node = cur_node->next;
+        }
+        cur_node->next = head;
+        return head;
+    };
+
+    for (int i = 0; i < V; i++)
+    {
+        Vertex& v = mesh_vertices[i];
+        v.p.x = mesh.vertex_xy[2*i];
+        v.p.y = mesh.vertex_xy[2*i+1];
+        const int start = mesh.vertex_offsets[i];
+        const int end = mesh.vertex_offsets[i+1];
+        v.num_polygons = end - start;
+        // Guaranteed to have 2 or more.
+        v.polygons = make_list(&mesh.vertex_polygons[start],
+                               &mesh.vertex_polygons[end]);
+    }
+
+    for (int i = 0; i < P; i++)
+    {
+        Polygon& p = mesh_polygons[i];
+        const int start = mesh.polygon_offsets[i];
+        const int end = mesh.polygon_offsets[i+1];
+        p.num_vertices = end - start;
+        p.vertices = make_list(&mesh.polygon_vertices[start],
+                               &mesh.polygon_vertices[end]);
+        p.polygons = make_list(&mesh.polygon_neighbours[start],
+                               &mesh.polygon_neighbours[end]);
+        p.num_traversable = 0;
+        for (int j = start; j < end; j++)
+        {
+            if (mesh.polygon_neighbours[j] != -1)
+            {
+                p.num_traversable++;
+            }
+        }
+
+        p.area = get_area(p.vertices);
+        p.perimeter = get_perimeter(p.vertices);
+        p.heat = polygon_heat.empty() ? 0 : polygon_heat[i];
+        assert(p.area > 0);
+    }
+}
+
+// Can polygon x merge with the polygon adjacent to the edge
+// (v->next, v->next->next)?
+// (The reason for this is because we don't have back pointers, and we need
+// to have the vertex before the edge starts).
+// Assume that v and p are "aligned", that is, they have been offset by the
+// same amount.
+// This also means that the actual polygon used will be p->next->next.
+// Also assume that x is a valid non-merged polygon.
+// If convex is false, the result doesn't have to be convex (optimal_merge
+// goes through polygons which aren't on the way to ones which are).
+bool Merger::can_merge(int x, ListNodePtr v, ListNodePtr p, bool convex)
+{
+    if (polygon_unions.find(x) != x)
+    {
+        return false;
+    }
+    const int merge_index = polygon_unions.find(p->go(2)->val);
+    if (merge_index == -1)
+    {
+        return false;
+    }
+    const Polygon& to_merge = mesh_polygons[merge_index];
+    if (to_merge.num_vertices == 0)
+    {
+        return false;
+    }
+
+    // If we share more than this one edge with to_merge, merging along just
+    // this edge would leave a zero-width spike (or a hole) in the result.
+    {
+        int shared = 0;
+        ListNodePtr cur_node_p = p;
+        bool first = true;
+        while (first || cur_node_p != p)
+        {
+            first = false;
+            if (polygon_unions.find(cur_node_p->val) == merge_index)
+            {
+                shared++;
+            }
+            cur_node_p = cur_node_p->next;
+        }
+        if (shared > 1)
+        {
+            counters.spike_failures++;
+            trace_event("spike_failure", x, merge_index);
+            return false;
+        }
+    }
+
+    // Define (v->next, v->next->next).
+    const int A = v->go(1)->val;
+    const int B = v->go(2)->val;
+
+    // We want to find (B, A) inside to_merge's vertices.
+    // In fact, we want to find the one BEFORE B. We'll call this merge_end.
+    // Assert that we have good data - that is, if B appears, A must be next.
+    // Also, we can't iterate for more than to_merge.num_vertices.
+    ListNodePtr merge_end_v = to_merge.vertices;
+    ListNodePtr merge_end_p = to_merge.polygons;
+    int counter;
+    counter = 0;
+    while (merge_end_v->next->val != B)
+    {
+        merge_end_v = merge_end_v->next;
+        merge_end_p = merge_end_p->next;
+        counter++;
+        assert(counter <= to_merge.num_vertices);
+    }
+    // Ensure that A comes after B.
+    assert(merge_end_v->go(2)->val == A);
+    // Ensure that the neighbouring polygon is x.
+    assert(polygon_unions.find(merge_end_p->go(2)->val) == x);
+
+    // The merge will change
+    // (v, A, B) to (v, A, [3 after merge_end_v]) and
+    // (A, B, [3 after v]) to (merge_end_v, B, [3 after v]).
+    // If the new ones are clockwise, we must return false.
+    #define P(ptr) mesh_vertices[(ptr)->val].p
+    if (convex && (cw(P(v), P(v->go(1)), P(merge_end_v->go(3))) ||
+        cw(P(merge_end_v), P(v->go(2)), P(v->go(3)))))
+    {
+        counters.cw_failures++;
+        trace_event("cw_failure", x, merge_index);
+        return false;
+    }
+
+    #undef P
+
+    return true;
+}
+
+// Removes the merge_index which sits next to x around vertex v.
+// Not every mesh agrees on which way around the vertex lists go, so x can be
+// on either side of it. x may also touch v more than once.
+void Merger::unlink_merged_polygon(int v, int x, int merge_index)
+{
+    Vertex& vertex = mesh_vertices[v];
+    ListNodePtr cur_node = vertex.polygons;
+    int counter = 0;
+    while (polygon_unions.find(cur_node->next->val) != merge_index ||
+           (polygon_unions.find(cur_node->val) != x &&
+            polygon_unions.find(cur_node->next->next->val) != x))
+    {
+        cur_node = cur_node->next;
+        counter++;
+        assert(counter <= vertex.num_polygons);
+    }
+    cur_node->next = cur_node->next->next;
+    // Set the vertex to be this just in case.
+    vertex.polygons = cur_node;
+    vertex.num_polygons--;
+}
+
+// Assuming can_merge like above, merge the polygons.
+void Merger::merge(int x, ListNodePtr v, ListNodePtr p, bool convex)
+{
+    assert(can_merge(x, v, p, convex));
+    counters.merges++;
+    // Note that because of the way we're merging,
+    // the resulting polygon will NOT always have a valid ListNodePtr, so
+    // we need to set it ourself.
+
+    const int merge_index = polygon_unions.find(p->go(2)->val);
+    trace_event("merge", x, merge_index);
+
+    Polygon& to_merge = mesh_polygons[polygon_unions.find(merge_index)];
+
+    const int A = v->go(1)->val;
+    const int B = v->go(2)->val;
+
+    ListNodePtr merge_end_v = to_merge.vertices;
+    ListNodePtr merge_end_p = to_merge.polygons;
+    while (merge_end_v->next->val != B)
+    {
+        merge_end_v = merge_end_v->next;
+        merge_end_p = merge_end_p->next;
+    }
+
+    // Our A should point to the thing which their A is pointing to.
+    // Their B should point to the thing which our B is pointing to.
+    ListNodePtr our_A_v_ptr = v->go(1);
+    ListNodePtr our_A_p_ptr = p->go(1);
+    ListNodePtr our_B_v_ptr = v->go(2);
+    ListNodePtr our_B_p_ptr = p->go(2);
+
+    ListNodePtr their_A_v_ptr = merge_end_v->go(2);
+    ListNodePtr their_A_p_ptr = merge_end_p->go(2);
+    ListNodePtr their_B_v_ptr = merge_end_v->go(1);
+    ListNodePtr their_B_p_ptr = merge_end_p->go(1);
+
+    our_A_v_ptr->next = their_A_v_ptr->next;
+    our_A_p_ptr->next = their_A_p_ptr->next;
+    their_B_v_ptr->next = our_B_v_ptr->next;
+    their_B_p_ptr->next = our_B_p_ptr->next;
+
+    // Set the our lists just in case something goes bad.
+    // That is: don't set it to our B.
+    Polygon& merged = mesh_polygons[x];
+    merged.vertices = our_A_v_ptr;
+    merged.polygons = our_A_p_ptr;
+
+
+    // Merge the numbers.
+    merged.num_vertices += to_merge.num_vertices - 2;
+    merged.num_traversable += to_merge.num_traversable - 2;
+    merged.area += to_merge.area;
+    merged.perimeter += to_merge.perimeter - 2 * edge_length(A, B);
+    merged.heat += to_merge.heat;
+
+    // "Delete" the old one.
+    to_merge = {0, 0, 0.0, 0.0, 0.0, nullptr, nullptr};
+
+    // We now need to delete these in A and B.
+    // A will go like (merge_index, x)
+    // B will go like (x, merge_index)
+    // We need to set both to just x.
+    unlink_merged_polygon(A, x, merge_index);
+    unlink_merged_polygon(B, x, merge_index);
+
+    // Do the union-find merge.
+    // THIS NEEDS TO BE LAST.
+    polygon_unions.merge(x, merge_index);
+}
+
+void Merger::check_correct()
+{
+    for (int i = 0; i < (int) mesh_vertices.size(); i++)
+    {
+        Vertex& v = mesh_vertices[i];
+        if (v.num_polygons == 0)
+        {
+            continue;
+        }
+
+        int count = 1;
+        ListNodePtr cur_node = v.polygons->next;
+        while (cur_node != v.polygons)
+        {
+            assert(count < v.num_polygons);
+            cur_node = cur_node->next;
+            count++;
+        }
+        assert(count == v.num_polygons);
+    }
+
+    for (int i = 0; i < (int) mesh_polygons.size(); i++)
+    {
+        Polygon& p = mesh_polygons[i];
+        if (polygon_unions.find(i) != i || p.num_vertices == 0)
+        {
+            // Has been merged.
+            continue;
+        }
+
+        {
+            #define P(ptr) mesh_vertices[(ptr)->val].p
+            int count = 1;
+
+            assert(!cw(P(p.vertices), P(p.vertices->next),
+                       P(p.vertices->next->next)));
+            can_merge(i, p.vertices, p.polygons);
+
+            ListNodePtr cur_node_v = p.vertices->next;
+            ListNodePtr cur_node_p = p.polygons->next;
+            while (cur_node_v != p.vertices)
+            {
+                assert(count < p.num_vertices);
+                assert(!cw(P(cur_node_v), P(cur_node_v->next),
+                           P(cur_node_v->next->next)));
+                can_merge(i, cur_node_v, cur_node_p);
+
+                cur_node_v = cur_node_v->next;
+                cur_node_p = cur_node_p->next;
+                count++;
+            }
+
+            assert(count == p.num_vertices);
+
+            #undef P
+        }
+
+        {
+            int count = 1;
+            ListNodePtr cur_node = p.polygons->next;
+            while (cur_node != p.polygons)
+            {
+                assert(count < p.num_vertices);
+                cur_node = cur_node->next;
+                count++;
+            }
+            assert(count == p.num_vertices);
+        }
+    }
+}
+
+void Merger::merge_deadend()
+{
+    bool merged = false;
+    do
+    {
+        // Each sweep shows up in --chrome-trace.
+        StatsPhase phase("merge_deadend sweep");
+        counters.deadend_sweeps++;
+        trace_event("deadend_sweep");
+        merged = false;
+        for (int i = 0; i < (int) mesh_polygons.size(); i++)
+        {
+            Polygon& p = mesh_polygons[i];
+            if (polygon_unions.find(i) != i || p.num_vertices == 0)
+            {
+                // Has been merged.
+                continue;
+            }
+            // We want dead ends here.
+            if (p.num_traversable != 1)
+            {
+                continue;
+            }
+
+            // Remember that the polygon we merge with is polygons->go(2).
+
+            {
+                const int merge_index = polygon_unions.find(
+                    p.polygons->go(2)->val);
+                if (merge_index != -1 &&
+                    mesh_polygons[merge_index].num_traversable <= 2 &&
+                    can_merge(i, p.vertices, p.polygons))
+                {
+                    merge(i, p.vertices, p.polygons);
+                    merged = true;
+                    continue;
+                }
+            }
+
+            ListNodePtr cur_node_v = p.vertices->next;
+            ListNodePtr cur_node_p = p.polygons->next;
+            while (cur_node_v != p.vertices)
+            {
+                const int merge_index = polygon_unions.find(
+                    cur_node_p->go(2)->val);
+                if (merge_index != -1 &&
+                    mesh_polygons[merge_index].num_traversable <= 2 &&
+                    can_merge(i, cur_node_v, cur_node_p))
+                {
+                    merge(i, cur_node_v, cur_node_p);
+                    merged = true;
+                    break;
+                }
+
+                cur_node_v = cur_node_v->next;
+                cur_node_p = cur_node_p->next;
+            }
+        }
+    } while (merged);
+}
+
+// The priority smart_merge actually uses.
+// If we have a profile, merges in the polygons where searches spend their time
+// get done first.
+double Merger::get_priority(const Polygon& a, const Polygon& b,
+                            double shared_length)
+{
+    const double priority = PRIORITIES[options.objective](a, b, shared_length);
+    if (priority <= 0)
+    {
+        return priority;
+    }
+    return priority * (1 + options.profile_weight * (a.heat + b.heat));
+}
+
+void Merger::smart_merge(bool keep_deadends)
+{
+    priority_queue<SearchNode> pq;
+    // As we aren't going to do pq updates, here's a shoddy workaround.
+    vector<double> best_merge(mesh_polygons.size(), -1);
+
+    // Pushes a polygon onto the pq as a node.
+    // Also updates best_merge.
+    auto push_polygon = [&](int i)
+    {
+        if (i == -1)
+        {
+            return;
+        }
+        Polygon& p = mesh_polygons[i];
+        if (p.num_vertices == 0)
+        {
+            // Has been merged.
+            return;
+        }
+
+        if (keep_deadends && p.num_traversable == 1)
+        {
+            // It's a dead end and we don't want to merge it.
+            return;
+        }
+
+        SearchNode this_node = {i, -1};
+
+        ListNodePtr cur_node_v = p.vertices;
+        ListNodePtr cur_node_p = p.polygons;
+        bool first = true;
+        while (first || cur_node_v != p.vertices)
+        {
+            first = false;
+            const int merge_index = polygon_unions.find(cur_node_p->go(2)->val);
+            if (merge_index != -1 &&
+                (!keep_deadends ||
+                 mesh_polygons[merge_index].num_traversable > 1) &&
+                can_merge(i, cur_node_v, cur_node_p))
+            {
+                this_node.priority = max(this_node.priority,
+                    get_priority(p, mesh_polygons[merge_index],
+                                   edge_length(cur_node_v->go(1)->val,
+                                               cur_node_v->go(2)->val)));
+            }
+
+            cur_node_v = cur_node_v->next;
+            cur_node_p = cur_node_p->next;
+        }
+
+        // Chuck it on the pq... if we found a valid merge.
+        if (this_node.priority > 0)
+        {
+            pq.push(this_node);
+            best_merge[i] = this_node.priority;
+        }
+        else
+        {
+            // We need to invalidate this if there isn't a valid merge.
+            best_merge[i] = -1;
+        }
+    };
+
+    for (int i = 0; i < (int) mesh_polygons.size(); i++)
+    {
+        push_polygon(i);
+    }
+
+
+    while (!pq.empty())
+    {
+        SearchNode node = pq.top(); pq.pop();
+        counters.heap_pops++;
+        trace_event("heap_pop", node.index);
+        if (abs(node.priority - best_merge[node.index]) > 1e-8)
+        {
+            // Not the right node.
+            counters.stale_skipped++;
+            trace_event("stale_skipped", node.index);
+            continue;
+        }
+        // We got an actual node!
+        const Polygon& p = mesh_polygons[node.index];
+        // Do the merge.
+        // NOW do the merge.
+        // We need to find it again, but that should be fine.
+        bool found = false;
+        {
+            ListNodePtr cur_node_v = p.vertices;
+            ListNodePtr cur_node_p = p.polygons;
+            bool first = true;
+            while (first || cur_node_v != p.vertices)
+            {
+                first = false;
+                const int merge_index = polygon_unions.find(
+                    cur_node_p->go(2)->val);
+                if (merge_index != -1 &&
+                    (!keep_deadends ||
+                     mesh_polygons[merge_index].num_traversable > 1) &&
+                    abs(get_priority(p, mesh_polygons[merge_index],
+                                     edge_length(cur_node_v->go(1)->val,
+                                                 cur_node_v->go(2)->val))
+                        - node.priority) < 1e-8 &&
+                    can_merge(node.index, cur_node_v, cur_node_p))
+                {
+                    // Wait - before that, we need to invalidate the thing
+                    // we merge with.
+                    best_merge[merge_index] = -1;
+                    merge(node.index, cur_node_v, cur_node_p);
+                    found = true;
+                    break;
+                }
+
+                cur_node_v = cur_node_v->next;
+                cur_node_p = cur_node_p->next;
+            }
+        }
+        if (!found)
+        {
+            // The polygon we wanted to merge with has changed since, so our
+            // priority is out of date. Try again with the right one.
+            counters.repushed++;
+            trace_event("repushed", node.index);
+            push_polygon(node.index);
+            continue;
+        }
+
+        // Update THIS merge.
+        push_polygon(node.index);
+        // Update the polygons around this merge.
+
+        ListNodePtr cur_node_p = p.polygons;
+        bool first = true;
+        while (first || cur_node_p != p.polygons)
+        {
+            first = false;
+            push_polygon(cur_node_p->val);
+            cur_node_p = cur_node_p->next;
+        }
+    }
+}
+
+// Hertel-Mehlhorn: remove every diagonal (shared edge) where the polygons on
+// either side still make a convex polygon.
+// Merging only ever makes the angles around a polygon bigger, so a diagonal
+// which can't be removed now can't be removed later either. This means that
+// one pass over every polygon is enough, unlike merging greedily until nothing
+// changes.
+// Which diagonals get removed depends on the order we go through the polygons
+// in, so go through the hottest ones first.
+void Merger::hertel_mehlhorn_merge(bool keep_deadends)
+{
+    vector<int> order(mesh_polygons.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [this](int a, int b)
+    {
+        return mesh_polygons[a].heat > mesh_polygons[b].heat;
+    });
+    for (int i : order)
+    {
+        Polygon& p = mesh_polygons[i];
+        if (polygon_unions.find(i) != i || p.num_vertices == 0)
+        {
+            // Has been merged.
+            continue;
+        }
+
+        if (keep_deadends && p.num_traversable == 1)
+        {
+            // It's a dead end and we want to keep it.
+            continue;
+        }
+
+        // Walk around the polygon until we've gone a full lap without merging.
+        // After a merge, cur_node_v is still in our list, but the edge after
+        // it is now one of the merged polygon's edges.
+        ListNodePtr cur_node_v = p.vertices;
+        ListNodePtr cur_node_p = p.polygons;
+        int since_merge = 0;
+        while (since_merge < p.num_vertices)
+        {
+            const int merge_index = polygon_unions.find(
+                cur_node_p->go(2)->val);
+            if (merge_index != -1 &&
+                (!keep_deadends ||
+                 mesh_polygons[merge_index].num_traversable > 1) &&
+                can_merge(i, cur_node_v, cur_node_p))
+            {
+                merge(i, cur_node_v, cur_node_p);
+                since_merge = 0;
+                continue;
+            }
+
+            cur_node_v = cur_node_v->next;
+            cur_node_p = cur_node_p->next;
+            since_merge++;
+        }
+    }
+}
+
+// Is the union of the polygons in mask (a subset of the region) a simple
+// polygon, and if so, is it convex?
+// The region stores each polygon's vertices and the region-local index of the
+// polygon across each edge (-1 if it is outside of the region).
+// The union is simple if its boundary edges make up exactly one loop, and
+// convex if that loop never turns clockwise.
+bool Merger::is_simple_union(const vector<vector<int>>& region_vertices,
+                             const vector<vector<int>>& region_neighbours,
+                             unsigned mask, bool& convex)
+{
+    // Boundary edges, stored as (start vertex, end vertex).
+    vector<pair<int, int>> edges;
+    for (int i = 0; i < (int) region_vertices.size(); i++)
+    {
+        if (!(mask & (1u << i)))
+        {
+            continue;
+        }
+        const vector<int>& vertices = region_vertices[i];
+        const vector<int>& neighbours = region_neighbours[i];
+        const int n = vertices.size();
+        for (int j = 0; j < n; j++)
+        {
+            // neighbours[j] shares the edge (vertices[j-1], vertices[j]).
+            const int neighbour = neighbours[j];
+            if (neighbour != -1 && (mask & (1u << neighbour)))
+            {
+                continue;
+            }
+            edges.push_back({vertices[(j + n - 1) % n], vertices[j]});
+        }
+    }
+    sort(edges.begin(), edges.end());
+    for (int i = 1; i < (int) edges.size(); i++)
+    {
+        if (edges[i].first == edges[i-1].first)
+        {
+            // Touches itself at a vertex.
+            return false;
+        }
+    }
+
+    auto next_vertex = [&](int v)
+    {
+        auto it = lower_bound(edges.begin(), edges.end(), make_pair(v, INT_MIN));
+        return (it == edges.end() || it->first != v) ? -1 : it->second;
+    };
+
+    convex = true;
+    const int start = edges.front().first;
+    int prev = start;
+    int cur = edges.front().second;
+    int count = 1;
+    while (true)
+    {
+        const int next = next_vertex(cur);
+        if (next == -1)
+        {
+            return false;
+        }
+        if (cw(mesh_vertices[prev].p, mesh_vertices[cur].p,
+               mesh_vertices[next].p))
+        {
+            convex = false;
+        }
+        if (cur == start)
+        {
+            break;
+        }
+        prev = cur;
+        cur = next;
+        count++;
+        if (count > (int) edges.size())
+        {
+            // Stuck in a loop which doesn't go through start.
+            return false;
+        }
+    }
+    // Did the loop use every boundary edge? If not, there's a hole.
+    return count == (int) edges.size();
+}
+
+// Finds the fewest convex polygons which the region can be merged into, and
+// merges them.
+// A block of polygons can become one polygon if its union is convex and we can
+// merge it one polygon at a time, where every polygon we merge in shares
+// exactly one edge with what we have so far. What we have so far only has to
+// be a simple polygon, so blocks which Hertel-Mehlhorn can't get to (as every
+// way of building them goes through a polygon which isn't convex) count too.
+// This means a block never has a vertex inside it.
+// This is exponential in the size of the region!
+void Merger::optimal_merge_region(const vector<int>& region)
+{
+    const int k = region.size();
+    if (k < 2)
+    {
+        return;
+    }
+
+    vector<vector<int>> region_vertices(k);
+    vector<vector<int>> region_neighbours(k);
+    for (int i = 0; i < k; i++)
+    {
+        const Polygon& p = mesh_polygons[region[i]];
+        ListNodePtr cur_node_v = p.vertices;
+        ListNodePtr cur_node_p = p.polygons;
+        for (int j = 0; j < p.num_vertices; j++)
+        {
+            const int neighbour = polygon_unions.find(cur_node_p->val);
+            const int local = find(region.begin(), region.end(), neighbour) -
+                              region.begin();
+            region_vertices[i].push_back(cur_node_v->val);
+            region_neighbours[i].push_back(local == k ? -1 : local);
+            cur_node_v = cur_node_v->next;
+            cur_node_p = cur_node_p->next;
+        }
+    }
+
+    const unsigned full = (1u << k) - 1;
+    // last_added[mask] is the polygon which was merged in last when building
+    // up mask, or -1 if mask can't be built.
+    vector<int> last_added(full + 1, -1);
+    // The masks which can be built and are convex, by their lowest polygon.
+    vector<vector<unsigned>> blocks(k);
+    for (unsigned mask = 1; mask <= full; mask++)
+    {
+        if ((mask & (mask - 1)) == 0)
+        {
+            // Only one polygon.
+            last_added[mask] = __builtin_ctz(mask);
+            blocks[__builtin_ctz(mask)].push_back(mask);
+            continue;
+        }
+        for (int q = 0; q < k; q++)
+        {
+            const unsigned rest = mask & ~(1u << q);
+            if (rest == mask || last_added[rest] == -1)
+            {
+                continue;
+            }
+            int shared = 0;
+            for (int neighbour : region_neighbours[q])
+            {
+                if (neighbour != -1 && (rest & (1u << neighbour)))
+                {
+                    shared++;
+                }
+            }
+            if (shared != 1)
+            {
+                continue;
+            }
+            bool convex;
+            if (is_simple_union(region_vertices, region_neighbours, mask,
+                                convex))
+            {
+                last_added[mask] = q;
+                if (convex)
+                {
+                    blocks[__builtin_ctz(mask)].push_back(mask);
+                }
+            }
+            // The shape of the union doesn't depend on q.
+            break;
+        }
+    }
+
+    // best[mask] is the fewest polygons we can partition mask into.
+    vector<int> best(full + 1, INT_MAX);
+    vector<unsigned> best_block(full + 1, 0);
+    best[0] = 0;
+    for (unsigned mask = 1; mask <= full; mask++)
+    {
+        // The lowest polygon has to be in some block, so only try those.
+        for (unsigned block : blocks[__builtin_ctz(mask)])
+        {
+            if ((block & ~mask) == 0 && best[mask & ~block] != INT_MAX &&
+                best[mask & ~block] + 1 < best[mask])
+            {
+                best[mask] = best[mask & ~block] + 1;
+                best_block[mask] = block;
+            }
+        }
+    }
+
+    // Now actually do the merges.
+    for (unsigned mask = full; mask != 0; mask &= ~best_block[mask])
+    {
+        unsigned block = best_block[mask];
+        vector<int> order;
+        while (block & (block - 1))
+        {
+            order.push_back(last_added[block]);
+            block &= ~(1u << last_added[block]);
+        }
+        const int x = region[__builtin_ctz(block)];
+        for (int i = (int) order.size() - 1; i >= 0; i--)
+        {
+            const int to_merge = region[order[i]];
+            const Polygon& p = mesh_polygons[x];
+            ListNodePtr cur_node_v = p.vertices;
+            ListNodePtr cur_node_p = p.polygons;
+            while (polygon_unions.find(cur_node_p->go(2)->val) != to_merge)
+            {
+                cur_node_v = cur_node_v->next;
+                cur_node_p = cur_node_p->next;
+            }
+            merge(x, cur_node_v, cur_node_p, false);
+        }
+    }
+}
+
+// Splits the mesh into connected regions of at most region_limit polygons and
+// merges each region optimally.
+// This has to go first: after a Hertel-Mehlhorn pass, hardly any blocks of
+// polygons have a convex union, so every region is already about as merged as
+// it can be.
+// Afterwards, do a Hertel-Mehlhorn pass to merge across the regions.
+// The regions' borders are fixed, and polygons which share more than one edge
+// can't be merged, so on meshes with collinear vertices (like gridmap2grid's)
+// this can end up with more polygons than Hertel-Mehlhorn on its own. See
+// merge_mesh.
+void Merger::optimal_merge(int region_limit, bool keep_deadends)
+{
+    auto is_candidate = [&](int i)
+    {
+        if (i == -1 || polygon_unions.find(i) != i)
+        {
+            return false;
+        }
+        const Polygon& p = mesh_polygons[i];
+        return p.num_vertices != 0 &&
+               (!keep_deadends || p.num_traversable != 1);
+    };
+
+    // Start the regions from the hottest polygons, like
+    // hertel_mehlhorn_merge.
+    vector<int> order(mesh_polygons.size());
+    iota(order.begin(), order.end(), 0);
+    stable_sort(order.begin(), order.end(), [this](int a, int b)
+    {
+        return mesh_polygons[a].heat > mesh_polygons[b].heat;
+    });
+    vector<bool> seen(mesh_polygons.size(), false);
+    for (int i : order)
+    {
+        if (seen[i] || !is_candidate(i))
+        {
+            continue;
+        }
+        // BFS until we have enough polygons.
+        vector<int> region;
+        queue<int> open;
+        open.push(i);
+        seen[i] = true;
+        while (!open.empty() && (int) region.size() < region_limit)
+        {
+            const int cur = open.front(); open.pop();
+            region.push_back(cur);
+            const Polygon& p = mesh_polygons[cur];
+            ListNodePtr cur_node_p = p.polygons;
+            for (int j = 0; j < p.num_vertices; j++)
+            {
+                const int neighbour = polygon_unions.find(cur_node_p->val);
+                if (is_candidate(neighbour) && !seen[neighbour])
+                {
+                    seen[neighbour] = true;
+                    open.push(neighbour);
+                }
+                cur_node_p = cur_node_p->next;
+            }
+        }
+        // Anything left over goes in a later region.
+        while (!open.empty())
+        {
+            seen[open.front()] = false;
+            open.pop();
+        }
+        optimal_merge_region(region);
+    }
+
+    hertel_mehlhorn_merge(keep_deadends);
+}
+
+int Merger::count_polygons()
+{
+    int out = 0;
+    for (const Polygon& p : mesh_polygons)
+    {
+        if (p.num_vertices != 0)
+        {
+            out++;
+        }
+    }
+    return out;
+}
+
+// Runs a merging stage, and if we're reporting, prints how many polygons it
+// removed and how quickly it did so.
+template <typename Stage>
+void Merger::run_stage(const string& name, Stage stage)
+{
+    ostream* report = options.report;
+    const int before = report ? count_polygons() : 0;
+    if (trace != nullptr)
+    {
+        *trace << "stage;" << name << "\n";
+    }
+    times->start(name);
+    const auto start = chrono::steady_clock::now();
+    stage();
+    times->stop();
+    if (report)
+    {
+        const double seconds = chrono::duration<double>(
+            chrono::steady_clock::now() - start).count();
+        const int removed = before - count_polygons();
+        *report << name << ";" << removed << ";" << seconds << ";"
+             << (seconds > 0 ? removed / seconds : 0) << endl;
+    }
+}
+
+MeshStats Merger::get_stats()
+{
+    MeshStats out = {0, 0, 0, 0, 0.0, 0.0};
+    long long sum_vertices = 0;
+    for (const Polygon& p : mesh_polygons)
+    {
+        if (p.num_vertices == 0)
+        {
+            continue;
+        }
+        out.polygons++;
+        if (p.num_traversable == 1)
+        {
+            out.deadends++;
+        }
+        out.sum_traversable += p.num_traversable;
+        out.max_vertices = max(out.max_vertices, p.num_vertices);
+        out.search_cost += search_cost(p);
+        sum_vertices += p.num_vertices;
+    }
+    if (out.polygons != 0)
+    {
+        out.mean_vertices = (double) sum_vertices / out.polygons;
+    }
+    return out;
+}
+
+void Merger::run_merge()
+{
+    run_stage("merge_deadend", [this]() { merge_deadend(); });
+    switch (options.strategy)
+    {
+        case STRATEGY_SMART:
+            run_stage("smart_merge", [this]() { smart_merge(true); });
+            break;
+        case STRATEGY_HM:
+            run_stage("hertel_mehlhorn_merge",
+                      [this]() { hertel_mehlhorn_merge(true); });
+            break;
+        case STRATEGY_OPTIMAL:
+            run_stage("optimal_merge", [this]()
+            {
+                optimal_merge(options.optimal_limit, true);
+            });
+            break;
+        case STRATEGY_BEST:
+            // merge_mesh runs STRATEGY_OPTIMAL and STRATEGY_HM instead.
+            assert(false);
+            break;
+    }
+}
+
+// Hands the counters to whoever asked for them.
+void Merger::report_counters()
+{
+    if (options.counters != nullptr)
+    {
+        *options.counters = counters;
+    }
+    stats_count("merge.cw_failures", counters.cw_failures);
+    stats_count("merge.spike_failures", counters.spike_failures);
+    stats_count("merge.merges", counters.merges);
+    stats_count("merge.deadend_sweeps", counters.deadend_sweeps);
+    stats_count("merge.heap_pops", counters.heap_pops);
+    stats_count("merge.stale_skipped", counters.stale_skipped);
+    stats_count("merge.repushed", counters.repushed);
+}
+
+// Maps old vertex indices to new ones, skipping the vertices which are no
+// longer used. Returns the number of vertices left.
+int Merger::get_vertex_mapping(vector<int>& vertex_mapping)
+{
+    vertex_mapping.resize(mesh_vertices.size());
+    int next_index = 0;
+    for (int i = 0; i < (int) mesh_vertices.size(); i++)
+    {
+        if (mesh_vertices[i].num_polygons != 0)
+        {
+            vertex_mapping[i] = next_index;
+            next_index++;
+        }
+        else
+        {
+            vertex_mapping[i] = INT_MAX;
+        }
+    }
+    return next_index;
+}
+
+// Same as above, but skipping the polygons which were merged away.
+int Merger::get_polygon_mapping(vector<int>& polygon_mapping)
+{
+    polygon_mapping.resize(mesh_polygons.size());
+    int next_index = 0;
+    for (int i = 0; i < (int) mesh_polygons.size(); i++)
+    {
+        if (mesh_polygons[i].num_vertices != 0)
+        {
+            polygon_mapping[i] = next_index;
+            next_index++;
+        }
+        else
+        {
+            polygon_mapping[i] = INT_MAX;
+        }
+    }
+    return next_index;
+}
+
+// The mesh without the polygons which were merged away and the vertices
+// which aren't used any more.
+void Merger::get_mesh(NavMesh& out)
+{
+    vector<int> vertex_mapping;
+    vector<int> polygon_mapping;
+    get_vertex_mapping(vertex_mapping);
+    get_polygon_mapping(polygon_mapping);
+
+    #define get_v(v) ((v) == -1 ? -1 : vertex_mapping[v])
+    #define get_p(p) ((p) == -1 ? -1 : polygon_mapping[polygon_unions.find(p)])
+
+    out = NavMesh();
+    vector<int> vertices;
+    vector<int> polygons;
+    for (int i = 0; i < (int) mesh_vertices.size(); i++)
+    {
+        Vertex& v = mesh_vertices[i];
+        if (v.num_polygons == 0)
+        {
+            continue;
+        }
+        polygons.clear();
+        ListNodePtr cur_node = v.polygons;
+        do
+        {
+            polygons.push_back(get_p(cur_node->val));
+            cur_node = cur_node->next;
+        } while (cur_node != v.polygons);
+        assert((int) polygons.size() == v.num_polygons);
+        out.add_vertex(v.p.x, v.p.y, polygons);
+    }
+
+    for (int i = 0; i < (int) mesh_polygons.size(); i++)
+    {
+        Polygon& p = mesh_polygons[i];
+        if (p.num_vertices == 0)
+        {
+            continue;
+        }
+        vertices.clear();
+        polygons.clear();
+        ListNodePtr cur_node = p.vertices;
+        do
+        {
+            vertices.push_back(get_v(cur_node->val));
+            cur_node = cur_node->next;
+        } while (cur_node != p.vertices);
+        cur_node = p.polygons;
+        do
+        {
+            polygons.push_back(get_p(cur_node->val));
+            cur_node = cur_node->next;
+        } while (cur_node != p.polygons);
+        out.add_polygon(vertices, polygons);
+    }
+
+    #undef get_p
+    #undef get_v
+}
+
+}
+
+bool merge_mesh(const NavMesh& mesh, const MergeOptions& options,
+                NavMesh& out, MeshStats* stats, string& error)
+{
+    const vector<double>& polygon_heat = options.polygon_heat;
+    if (!polygon_heat.empty() &&
+        (int) polygon_heat.size() != mesh.num_polygons())
+    {
+        error = "Profile does not match mesh (got " +
+                to_string(mesh.num_polygons()) +
+                " polygons but the profile has " +
+                to_string(polygon_heat.size()) + ")";
+        return false;
+    }
+    if (options.optimal_limit < 1 ||
+        options.optimal_limit > MAX_OPTIMAL_LIMIT)
+    {
+        error = "Optimal limit must be between 1 and " +
+                to_string(MAX_OPTIMAL_LIMIT);
+        return false;
+    }
+
+    // Phases are only kept if we were given somewhere to put them, but
+    // they're always timed for --stats.
+    PhaseTimes unused;
+    PhaseTimes* times = options.times ? options.times : &unused;
+
+    // STRATEGY_BEST runs both strategies, each reporting and tracing into
+    // its own buffer, so only the one which is kept gets passed on.
+    const bool best_of = options.strategy == STRATEGY_BEST;
+    ostringstream reports[2];
+    ostringstream traces[2];
+    MergeOptions strategy_options[2] = {options, options};
+    if (best_of)
+    {
+        strategy_options[0].strategy = STRATEGY_OPTIMAL;
+        strategy_options[1].strategy = STRATEGY_HM;
+        for (int i = 0; i < 2; i++)
+        {
+            if (options.report != nullptr)
+            {
+                strategy_options[i].report = &reports[i];
+            }
+            if (options.trace != nullptr)
+            {
+                strategy_options[i].trace = &traces[i];
+            }
+        }
+    }
+    Merger merger(strategy_options[0], times);
+    Merger hm_merger(strategy_options[1], times);
+    Merger* best = &merger;
+    for (int i = 0; i < (best_of ? 2 : 1); i++)
+    {
+        Merger& m = i == 0 ? merger : hm_merger;
+        times->start("read_mesh");
+        m.read_mesh(mesh);
+        times->stop();
+        m.run_merge();
+        // check_correct asks can_merge about everything again.
+        m.trace = nullptr;
+    }
+    if (best_of)
+    {
+        const int kept = hm_merger.count_polygons() < merger.count_polygons();
+        best = kept == 1 ? &hm_merger : &merger;
+        if (options.report != nullptr)
+        {
+            *options.report << reports[kept].str();
+        }
+        if (options.trace != nullptr)
+        {
+            *options.trace << traces[kept].str();
+        }
+    }
+    best->report_counters();
+
+    times->start("check_correct");
+    best->check_correct();
+    if (stats != nullptr)
+    {
+        *stats = best->get_stats();
+    }
+    times->start("get_mesh");
+    best->get_mesh(out);
+    times->stop();
+    return true;
+}
+
+}
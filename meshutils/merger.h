@@ -0,0 +1,127 @@
+#pragma once
+#include "navmesh.h"
+#include "timing.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Greedily merging the polygons of a mesh into bigger convex polygons, which
+// is what meshmerger does.
+// Dead end polygons are merged first, then the rest with one of the
+// strategies below, without ever merging anything into a dead end.
+
+enum MergeStrategy
+{
+    // merge_deadend, then smart_merge.
+    STRATEGY_SMART,
+    // merge_deadend, then hertel_mehlhorn_merge.
+    STRATEGY_HM,
+    // merge_deadend, then optimal_merge.
+    STRATEGY_OPTIMAL,
+    // STRATEGY_OPTIMAL and STRATEGY_HM, each on the whole mesh, keeping
+    // whichever leaves fewer polygons.
+    STRATEGY_BEST
+};
+
+// What smart_merge goes for. See merger.cpp.
+enum MergeObjective
+{
+    // The combined area of the two polygons.
+    OBJECTIVE_AREA,
+    // The combined area, weighted by how much the merge reduces the
+    // estimated search cost of the mesh.
+    OBJECTIVE_COST,
+    NUM_OBJECTIVES
+};
+
+// The name of each objective, as used by meshmerger's --objective.
+extern const char* const OBJECTIVE_NAMES[NUM_OBJECTIVES];
+
+const int MAX_OPTIMAL_LIMIT = 16;
+
+// What the merging did along the way, to see which part of it a map spends
+// its time in.
+struct MergeCounters
+{
+    // Merges can_merge turned down, as the result wouldn't be convex (the
+    // cw check), or as the polygons share more than one edge.
+    long long cw_failures;
+    long long spike_failures;
+    long long merges;
+    // Passes merge_deadend made over every polygon (the last one merges
+    // nothing).
+    long long deadend_sweeps;
+    // Entries smart_merge took off its heap, and how many of those were
+    // skipped as a newer one had replaced them, or had to be pushed again
+    // as the merge they wanted had gone.
+    long long heap_pops;
+    long long stale_skipped;
+    long long repushed;
+
+    MergeCounters()
+        : cw_failures(0), spike_failures(0), merges(0), deadend_sweeps(0),
+          heap_pops(0), stale_skipped(0), repushed(0) {}
+};
+
+struct MergeOptions
+{
+    MergeStrategy strategy;
+    MergeObjective objective;
+    // Biggest region optimal_merge will solve exactly.
+    // It takes 3^optimal_limit time per region, so keep this small.
+    int optimal_limit;
+    // Search effort spent in each polygon of the input mesh, from a heatmap,
+    // with the hottest polygon having a heat of 1.
+    // Empty if we don't have one.
+    vector<double> polygon_heat;
+    // How much to favour merges in hot polygons.
+    double profile_weight;
+    // If not null, "stage;polygons removed;seconds;polygons removed per
+    // second" is printed here for each stage.
+    ostream* report;
+    // If not null, reading the mesh, each stage, checking and writing the
+    // mesh out are timed into this.
+    PhaseTimes* times;
+    // If not null, gets what the merging did (only for the merge that was
+    // kept, for STRATEGY_BEST). These are also counted for --stats (see
+    // stats.h), if that's on.
+    MergeCounters* counters;
+    // If not null, a line is printed here as each thing above is counted:
+    // "merge;x;y", "cw_failure;x;y" or "spike_failure;x;y" for merging y
+    // into x, "deadend_sweep", and "heap_pop;x", "stale_skipped;x" or
+    // "repushed;x" for an entry for x. Polygons are numbered as in the input
+    // mesh. "stage;name" starts each stage. This is slow, so it's off unless
+    // asked for.
+    ostream* trace;
+
+    MergeOptions()
+        : strategy(STRATEGY_SMART), objective(OBJECTIVE_AREA),
+          optimal_limit(12), profile_weight(1), report(nullptr),
+          times(nullptr), counters(nullptr), trace(nullptr) {}
+};
+
+struct MeshStats
+{
+    int polygons;
+    int deadends;
+    int sum_traversable;
+    int max_vertices;
+    double mean_vertices;
+    double search_cost;
+};
+
+// Merges the polygons of mesh, and puts the result in out (which can be
+// mesh). Vertices which aren't used any more are removed, and everything
+// else keeps its order.
+// If stats isn't null, it gets the stats of the merged mesh.
+// mesh must be valid, like read_text_mesh with the default options checks.
+// Returns false and sets error if the options don't fit the mesh.
+bool merge_mesh(const NavMesh& mesh, const MergeOptions& options,
+                NavMesh& out, MeshStats* stats, string& error);
+
+}
@@ -0,0 +1,57 @@
+#pragma once
+#include <vector>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// A mesh (see spec/mesh/2.txt) stored as flat arrays.
+// The polygons around vertex i are
+// vertex_polygons[vertex_offsets[i]] to vertex_polygons[vertex_offsets[i+1]-1],
+// and the vertices and neighbours of polygon i are stored in the same way
+// using polygon_offsets.
+struct NavMesh
+{
+    // x0, y0, x1, y1, ...
+    vector<double> vertex_xy;
+    vector<int> vertex_offsets;
+    vector<int> vertex_polygons;
+
+    vector<int> polygon_offsets;
+    vector<int> polygon_vertices;
+    vector<int> polygon_neighbours;
+
+    NavMesh() : vertex_offsets(1, 0), polygon_offsets(1, 0) {}
+
+    int num_vertices() const
+    {
+        return vertex_offsets.size() - 1;
+    }
+
+    int num_polygons() const
+    {
+        return polygon_offsets.size() - 1;
+    }
+
+    void add_vertex(double x, double y, const vector<int>& polygons)
+    {
+        vertex_xy.push_back(x);
+        vertex_xy.push_back(y);
+        vertex_polygons.insert(vertex_polygons.end(),
+                               polygons.begin(), polygons.end());
+        vertex_offsets.push_back(vertex_polygons.size());
+    }
+
+    // neighbours[i] shares the edge (vertices[i-1], vertices[i]).
+    void add_polygon(const vector<int>& vertices, const vector<int>& neighbours)
+    {
+        polygon_vertices.insert(polygon_vertices.end(),
+                                vertices.begin(), vertices.end());
+        polygon_neighbours.insert(polygon_neighbours.end(),
+                                  neighbours.begin(), neighbours.end());
+        polygon_offsets.push_back(polygon_vertices.size());
+    }
+};
+
+}
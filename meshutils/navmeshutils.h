@@ -0,0 +1,36 @@
+#pragma once
+// Everything the tools do, for programs which want to convert and merge
+// meshes themselves. Nothing here uses globals, so several conversions can
+// run at once. Link with bin/libnavmeshutils.a (make libnavmeshutils) and
+// -pthread.
+//
+// A grid map goes through
+//     read_gridmap -> GridMap -> trace_polygons -> PolyMap
+// (gridmap2poly), and then fadeutils::triangulate (fadeutils/triangulate.h,
+// which needs Fade2D) -> NavMesh (poly2mesh). A GridMap can also be made
+// into a NavMesh straight away with make_rect_mesh or make_grid_mesh
+// (gridmap2rects and gridmap2grid). NavMeshes can be merged with merge_mesh
+// (meshmerger), read and written as text, binary or packed meshes, and
+// indexed for point location with PointLocator (meshindex), line of sight
+// with RayCaster (meshrays) and shortest paths with MeshSearch (meshbench).
+// check_mesh checks that they are valid (meshcheck), and compare_coverage
+// that they cover their map (meshcover). generate_gridmap makes random maps
+// to test all of these on (mapgen), and stats.h records where the time and
+// memory go (--stats=json).
+#include "navmesh.h"
+#include "gridmap.h"
+#include "mapgen.h"
+#include "rects.h"
+#include "merger.h"
+#include "reorder.h"
+#include "locate.h"
+#include "raycast.h"
+#include "search.h"
+#include "validate.h"
+#include "coverage.h"
+#include "textmesh.h"
+#include "binmesh.h"
+#include "packing.h"
+#include "compress.h"
+#include "edgebreaker.h"
+#include "stats.h"
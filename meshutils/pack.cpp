@@ -0,0 +1,279 @@
+#include "pack.h"
+#include <stdint.h>
+#include <string.h>
+
+namespace meshutils
+{
+
+namespace
+{
+
+typedef unsigned char uchar;
+
+// How -1 comes out in a "pack" file.
+const uint32_t magic = 0xffffff;
+
+void print_int(uint32_t n, ostream& s)
+{
+    const char z = static_cast<char>(0xFF);
+    const char bytes[] = {static_cast<char>((n>>16)&z), static_cast<char>((n>>8)&z), static_cast<char>((n>>0)&z)};
+    s.write(bytes, 3);
+}
+
+uint32_t remove_b(const char* n)
+{
+    return uint32_t((uchar)(n[0]) << 16 |
+                    (uchar)(n[1]) << 8  | (uchar)(n[2]) << 0);
+}
+
+// Writes a section as its tag, its length in bytes, then its contents.
+void write_section(const char* tag, const string& contents, ostream& outfile)
+{
+    string length;
+    write_varint(contents.size(), length);
+    outfile.write(tag, 4);
+    outfile.write(length.data(), length.size());
+    outfile.write(contents.data(), contents.size());
+}
+
+// A section of a packed file which we read from front to back, remembering
+// the first thing that went wrong.
+struct Section
+{
+    const char* pos;
+    const char* end;
+    string* error;
+
+    uint64_t read(uint64_t max)
+    {
+        uint64_t out = 0;
+        if (!error->empty())
+        {
+            return 0;
+        }
+        if (!read_varint(pos, end, out))
+        {
+            *error = "section too short";
+            return 0;
+        }
+        if (out > max)
+        {
+            *error = "number out of range";
+            return 0;
+        }
+        return out;
+    }
+
+    void finish()
+    {
+        if (error->empty() && pos != end)
+        {
+            *error = "section too long";
+        }
+    }
+};
+
+}
+
+void pack_v1(istream& meshfile, ostream& packedfile)
+{
+    int temp;
+    packedfile.write("pack", 4);
+    while (meshfile >> temp)
+    {
+        print_int(temp, packedfile);
+    }
+}
+
+void unpack_v1(istream& packedfile, ostream& meshfile)
+{
+    char x[3];
+    meshfile << "mesh" << endl;
+    uint32_t temp;
+    while (packedfile.read(x, 3))
+    {
+        temp = remove_b(x);
+        if (temp == magic)
+        {
+            meshfile << "-1" << "\n";
+        }
+        else
+        {
+            meshfile << temp << "\n";
+        }
+    }
+}
+
+void pack_v2(const ExactMesh& in, ostream& packedfile)
+{
+    const NavMesh& mesh = in.mesh;
+    string header;
+    write_varint(in.version, header);
+    write_varint(mesh.num_vertices(), header);
+    write_varint(mesh.num_polygons(), header);
+    write_varint(in.fixed_point ? 0 : 1, header);
+    write_varint(in.scale, header);
+
+    string vertices;
+    if (in.fixed_point)
+    {
+        for (int64_t x : in.fixed_xy)
+        {
+            write_varint(zigzag(x), vertices);
+        }
+    }
+    else
+    {
+        vertices.append(reinterpret_cast<const char*>(mesh.vertex_xy.data()),
+                        mesh.vertex_xy.size() * 8);
+    }
+
+    // Store polygons plus 1 so -1 takes one byte.
+    string vertex_polygons;
+    for (int i = 0; i < mesh.num_vertices(); i++)
+    {
+        const int start = mesh.vertex_offsets[i];
+        const int end = mesh.vertex_offsets[i+1];
+        write_varint(end - start, vertex_polygons);
+        for (int j = start; j < end; j++)
+        {
+            write_varint(mesh.vertex_polygons[j] + 1, vertex_polygons);
+        }
+    }
+
+    string polygons;
+    for (int i = 0; i < mesh.num_polygons(); i++)
+    {
+        const int start = mesh.polygon_offsets[i];
+        const int end = mesh.polygon_offsets[i+1];
+        write_varint(end - start, polygons);
+        for (int j = start; j < end; j++)
+        {
+            write_varint(mesh.polygon_vertices[j], polygons);
+        }
+        for (int j = start; j < end; j++)
+        {
+            write_varint(mesh.polygon_neighbours[j] + 1, polygons);
+        }
+    }
+
+    packedfile.write("pak2", 4);
+    write_section("head", header, packedfile);
+    write_section("vert", vertices, packedfile);
+    write_section("vpol", vertex_polygons, packedfile);
+    write_section("poly", polygons, packedfile);
+}
+
+bool unpack_v2(const string& data, ExactMesh& out, string& error)
+{
+    error.clear();
+    if (data.size() < 4 || data.compare(0, 4, "pak2") != 0)
+    {
+        error = "Header is not pak2";
+        return false;
+    }
+    Section head = {nullptr, nullptr, &error};
+    Section vert = {nullptr, nullptr, &error};
+    Section vpol = {nullptr, nullptr, &error};
+    Section poly = {nullptr, nullptr, &error};
+    const char* pos = data.data() + 4;
+    const char* const end = data.data() + data.size();
+    while (pos != end)
+    {
+        if (end - pos < 4)
+        {
+            error = "bad section tag";
+            return false;
+        }
+        const string tag(pos, 4);
+        pos += 4;
+        uint64_t length;
+        if (!read_varint(pos, end, length) || length > uint64_t(end - pos))
+        {
+            error = "bad section length";
+            return false;
+        }
+        const Section section = {pos, pos + length, &error};
+        pos += length;
+        // Skip any sections we don't know about.
+        if (tag == "head")
+        {
+            head = section;
+        }
+        else if (tag == "vert")
+        {
+            vert = section;
+        }
+        else if (tag == "vpol")
+        {
+            vpol = section;
+        }
+        else if (tag == "poly")
+        {
+            poly = section;
+        }
+    }
+    if (!head.pos || !vert.pos || !vpol.pos || !poly.pos)
+    {
+        error = "missing section";
+        return false;
+    }
+
+    out.version = head.read(2);
+    const int V = head.read(INT32_MAX);
+    const int P = head.read(INT32_MAX);
+    out.fixed_point = head.read(1) == 0;
+    out.scale = head.read(MAX_SCALE);
+    // Newer files might have more in their header, so don't call finish.
+
+    vector<int> polygons;
+    vector<int> vertices;
+    for (int i = 0; i < V && error.empty(); i++)
+    {
+        double xy[2] = {0, 0};
+        for (int j = 0; j < 2; j++)
+        {
+            if (out.fixed_point)
+            {
+                out.fixed_xy.push_back(unzigzag(vert.read(UINT64_MAX)));
+            }
+            else
+            {
+                if (vert.end - vert.pos < 8)
+                {
+                    error = "section too short";
+                    return false;
+                }
+                memcpy(&xy[j], vert.pos, 8);
+                vert.pos += 8;
+            }
+        }
+        polygons.resize(vpol.read(P));
+        for (int& p : polygons)
+        {
+            p = (int) vpol.read(P) - 1;
+        }
+        out.mesh.add_vertex(xy[0], xy[1], polygons);
+    }
+    for (int i = 0; i < P && error.empty(); i++)
+    {
+        const int n = poly.read(V);
+        vertices.resize(n);
+        polygons.resize(n);
+        for (int& v : vertices)
+        {
+            v = poly.read(V - 1);
+        }
+        for (int& p : polygons)
+        {
+            p = (int) poly.read(P) - 1;
+        }
+        out.mesh.add_polygon(vertices, polygons);
+    }
+    vert.finish();
+    vpol.finish();
+    poly.finish();
+    return error.empty();
+}
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "packing.h"
+#include <iostream>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// The uncompressed packed formats.
+
+// The original format ("pack"): every number of a text mesh as a 3 byte
+// integer, so it only works for meshes with integer coordinates.
+// Packs every number left in meshfile, which should be just past the "mesh"
+// header.
+void pack_v1(istream& meshfile, ostream& packedfile);
+// Unpacks everything left in packedfile, which should be just past the
+// "pack" header, back to a text mesh.
+void unpack_v1(istream& packedfile, ostream& meshfile);
+
+// Varints and exact coordinates ("pak2"). See spec/packed/2.txt.
+// The numbers in every list of mesh must be no more than the number of
+// vertices or polygons.
+void pack_v2(const ExactMesh& mesh, ostream& packedfile);
+// Decodes a whole "pak2" file.
+// Returns false and sets error if it is invalid.
+bool unpack_v2(const string& data, ExactMesh& out, string& error);
+
+}
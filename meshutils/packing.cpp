@@ -0,0 +1,197 @@
+#include "packing.h"
+#include <climits>
+#include <cctype>
+
+namespace meshutils
+{
+
+void write_varint(uint64_t n, string& out)
+{
+    while (n >= 0x80)
+    {
+        out.push_back(static_cast<char>((n & 0x7F) | 0x80));
+        n >>= 7;
+    }
+    out.push_back(static_cast<char>(n));
+}
+
+bool read_varint(const char*& pos, const char* end, uint64_t& out)
+{
+    out = 0;
+    for (int shift = 0; shift < 70; shift += 7)
+    {
+        if (pos == end)
+        {
+            return false;
+        }
+        const unsigned char byte = *pos;
+        pos++;
+        out |= uint64_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parse_decimal(const char* token, const char* end, int64_t& mantissa,
+                   int& exponent)
+{
+    const size_t size = end - token;
+    // Any more significant digits and we might overflow.
+    const int MAX_DIGITS = 18;
+    size_t i = 0;
+    bool negative = false;
+    if (i < size && (token[i] == '-' || token[i] == '+'))
+    {
+        negative = token[i] == '-';
+        i++;
+    }
+    uint64_t m = 0;
+    int e = 0;
+    int digits = 0;
+    bool any = false;
+
+    // Handles one digit of the number, before or after the decimal point.
+    auto add_digit = [&](char c, bool fraction)
+    {
+        any = true;
+        if (m == 0 && c == '0')
+        {
+            // Leading zero.
+            if (fraction)
+            {
+                e--;
+            }
+            return true;
+        }
+        if (digits == MAX_DIGITS)
+        {
+            // We can only drop zeros.
+            if (c != '0')
+            {
+                return false;
+            }
+            if (!fraction)
+            {
+                e++;
+            }
+            return true;
+        }
+        m = m * 10 + (c - '0');
+        digits++;
+        if (fraction)
+        {
+            e--;
+        }
+        return true;
+    };
+
+    while (i < size && isdigit(token[i]))
+    {
+        if (!add_digit(token[i], false))
+        {
+            return false;
+        }
+        i++;
+    }
+    if (i < size && token[i] == '.')
+    {
+        i++;
+        while (i < size && isdigit(token[i]))
+        {
+            if (!add_digit(token[i], true))
+            {
+                return false;
+            }
+            i++;
+        }
+    }
+    if (!any)
+    {
+        return false;
+    }
+    if (i < size && (token[i] == 'e' || token[i] == 'E'))
+    {
+        i++;
+        bool negative_exponent = false;
+        if (i < size && (token[i] == '-' || token[i] == '+'))
+        {
+            negative_exponent = token[i] == '-';
+            i++;
+        }
+        if (i == size)
+        {
+            return false;
+        }
+        int written = 0;
+        while (i < size && isdigit(token[i]))
+        {
+            written = written * 10 + (token[i] - '0');
+            if (written > 1000)
+            {
+                return false;
+            }
+            i++;
+        }
+        e += negative_exponent ? -written : written;
+    }
+    if (i != size)
+    {
+        return false;
+    }
+    mantissa = negative ? -int64_t(m) : int64_t(m);
+    exponent = e;
+    return true;
+}
+
+bool to_fixed(int64_t mantissa, int exponent, int scale, int64_t& out)
+{
+    int shift = exponent + scale;
+    while (shift < 0)
+    {
+        if (mantissa % 10 != 0)
+        {
+            return false;
+        }
+        mantissa /= 10;
+        shift++;
+    }
+    while (shift > 0 && mantissa != 0)
+    {
+        if (mantissa > LLONG_MAX / 10 || mantissa < LLONG_MIN / 10)
+        {
+            return false;
+        }
+        mantissa *= 10;
+        shift--;
+    }
+    out = mantissa;
+    return true;
+}
+
+string format_fixed(int64_t value, int scale)
+{
+    uint64_t power = 1;
+    for (int i = 0; i < scale; i++)
+    {
+        power *= 10;
+    }
+    // Careful not to overflow on LLONG_MIN.
+    const uint64_t magnitude = value < 0 ? uint64_t(-(value + 1)) + 1
+                                         : uint64_t(value);
+    string out = value < 0 ? "-" : "";
+    out += to_string(magnitude / power);
+    const uint64_t fraction = magnitude % power;
+    if (fraction != 0)
+    {
+        const string digits = to_string(fraction);
+        out += '.';
+        out.append(scale - digits.size(), '0');
+        out += digits;
+    }
+    return out;
+}
+
+}
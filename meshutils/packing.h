@@ -0,0 +1,81 @@
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "navmesh.h"
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Helpers for the packed mesh formats. See spec/packed.
+
+// Zigzag encoding maps small negative numbers to small positive numbers:
+// 0, -1, 1, -2, ... becomes 0, 1, 2, 3, ...
+inline uint64_t zigzag(int64_t n)
+{
+    return (uint64_t(n) << 1) ^ uint64_t(n >> 63);
+}
+
+inline int64_t unzigzag(uint64_t n)
+{
+    return int64_t(n >> 1) ^ -int64_t(n & 1);
+}
+
+// The zigzag encoding of value - previous, wrapping around on overflow.
+inline uint64_t delta(int64_t value, int64_t previous)
+{
+    return zigzag(int64_t(uint64_t(value) - uint64_t(previous)));
+}
+
+inline int64_t undelta(uint64_t coded, int64_t previous)
+{
+    return int64_t(uint64_t(previous) + uint64_t(unzigzag(coded)));
+}
+
+// LEB128: 7 bits per byte, least significant first, with the top bit set on
+// every byte except the last.
+void write_varint(uint64_t n, string& out);
+// Reads a varint starting at pos, and moves pos past it.
+// Returns false if it runs past end or is longer than 10 bytes.
+bool read_varint(const char*& pos, const char* end, uint64_t& out);
+
+// Parses a decimal number like "-12.5", "3" or "1e+06" exactly into
+// mantissa * 10^exponent.
+// Returns false if it isn't a number or has too many digits to fit.
+bool parse_decimal(const char* token, const char* end, int64_t& mantissa,
+                   int& exponent);
+inline bool parse_decimal(const string& token, int64_t& mantissa,
+                          int& exponent)
+{
+    return parse_decimal(token.data(), token.data() + token.size(), mantissa,
+                         exponent);
+}
+// Converts mantissa * 10^exponent to a fixed-point number with scale decimal
+// places, or returns false if it wouldn't be exact or doesn't fit.
+bool to_fixed(int64_t mantissa, int exponent, int scale, int64_t& out);
+// Prints a fixed-point number with scale decimal places, or without any if
+// it is a whole number.
+string format_fixed(int64_t value, int scale);
+
+// Biggest number of decimal places a fixed-point number can have.
+const int MAX_SCALE = 18;
+
+// A mesh from a text file, with its coordinates kept exactly.
+struct ExactMesh
+{
+    // The version of the text mesh.
+    int version;
+    // If fixed_point, the exact coordinates are fixed_xy with scale decimal
+    // places, and mesh.vertex_xy is only approximate.
+    // Otherwise they are mesh.vertex_xy, and fixed_xy is empty.
+    bool fixed_point;
+    int scale;
+    vector<int64_t> fixed_xy;
+    NavMesh mesh;
+
+    ExactMesh() : version(2), fixed_point(true), scale(0) {}
+};
+
+}
@@ -0,0 +1,105 @@
+#include "parallel.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace meshutils
+{
+
+void parallel_for(int n, int threads, const function<void(int)>& fn)
+{
+    if (threads <= 0)
+    {
+        threads = thread::hardware_concurrency();
+    }
+    threads = max(1, min(threads, n));
+    atomic<int> next(0);
+    auto worker = [&]()
+    {
+        for (int i = next++; i < n; i = next++)
+        {
+            fn(i);
+        }
+    };
+    vector<thread> pool;
+    for (int i = 1; i < threads; i++)
+    {
+        pool.emplace_back(worker);
+    }
+    worker();
+    for (thread& t : pool)
+    {
+        t.join();
+    }
+}
+
+void work_stealing_for(const vector<int>& jobs, int threads,
+                       const function<void(int)>& fn)
+{
+    if (threads <= 0)
+    {
+        threads = thread::hardware_concurrency();
+    }
+    threads = max(1, min(threads, (int) jobs.size()));
+    struct Queue
+    {
+        mutex lock;
+        deque<int> jobs;
+    };
+    vector<Queue> queues(threads);
+    for (int i = 0; i < (int) jobs.size(); i++)
+    {
+        queues[i % threads].jobs.push_back(jobs[i]);
+    }
+
+    // Takes the front (biggest) job of queue q, if it has one.
+    auto take = [&](int q, int& job)
+    {
+        lock_guard<mutex> guard(queues[q].lock);
+        if (queues[q].jobs.empty())
+        {
+            return false;
+        }
+        job = queues[q].jobs.front();
+        queues[q].jobs.pop_front();
+        return true;
+    };
+    auto worker = [&](int id)
+    {
+        int job;
+        while (true)
+        {
+            if (take(id, job))
+            {
+                fn(job);
+                continue;
+            }
+            // Nothing is ever added, so if every queue is empty we're done.
+            bool stole = false;
+            for (int i = 1; i < threads && !stole; i++)
+            {
+                stole = take((id + i) % threads, job);
+            }
+            if (!stole)
+            {
+                return;
+            }
+            fn(job);
+        }
+    };
+    vector<thread> pool;
+    for (int i = 1; i < threads; i++)
+    {
+        pool.emplace_back(worker, i);
+    }
+    worker(0);
+    for (thread& t : pool)
+    {
+        t.join();
+    }
+}
+
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <functional>
+#include <vector>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Calls fn(0) to fn(n-1), using up to threads threads (0 for one per core).
+// Calls are handed out in order to whichever thread is free, so they can
+// finish in any order.
+void parallel_for(int n, int threads, const function<void(int)>& fn);
+
+// Calls fn(job) for each job, using up to threads threads (0 for one per
+// core), for jobs which take very different amounts of time.
+// jobs should be biggest first. They are dealt out to each thread's own
+// queue, and a thread which runs out steals the next (biggest) job from
+// another thread's queue, so the big jobs start first and nobody sits idle
+// while there is work left.
+void work_stealing_for(const vector<int>& jobs, int threads,
+                       const function<void(int)>& fn);
+
+}
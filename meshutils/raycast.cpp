@@ -0,0 +1,254 @@
+#include "raycast.h"
+#include "parallel.h"
+#include <algorithm>
+
+namespace meshutils
+{
+
+namespace
+{
+
+// Queries are done in chunks this big, so threads don't fight over them.
+const int BATCH_CHUNK = 256;
+
+}
+
+void RayCaster::build(const NavMesh& mesh)
+{
+    locator.build(mesh);
+    vertex_xy = mesh.vertex_xy;
+    vertex_offsets = mesh.vertex_offsets;
+    vertex_polygons = mesh.vertex_polygons;
+
+    const int P = mesh.num_polygons();
+    ring_offsets.assign(1, 0);
+    ring_vertices.clear();
+    ring_neighbours.clear();
+    for (int p = 0; p < P; p++)
+    {
+        const int begin = mesh.polygon_offsets[p];
+        const int n = mesh.polygon_offsets[p+1] - begin;
+        const int* v = &mesh.polygon_vertices[begin];
+        const int* neighbours = &mesh.polygon_neighbours[begin];
+        // Twice the signed area, to check which way round it goes.
+        double area = 0;
+        for (int i = 0; i < n; i++)
+        {
+            const int a = v[i];
+            const int b = v[(i + 1) % n];
+            area += vertex_xy[2*a] * vertex_xy[2*b+1] -
+                    vertex_xy[2*b] * vertex_xy[2*a+1];
+        }
+        // neighbours[i] is across (v[i-1], v[i]), so the edge from v[i] to
+        // v[i+1] has neighbours[i+1]. Going the other way round, the edge
+        // from v[n-1-i] to v[n-2-i] has neighbours[n-1-i].
+        for (int i = 0; i < n; i++)
+        {
+            if (area >= 0)
+            {
+                ring_vertices.push_back(v[i]);
+                ring_neighbours.push_back(neighbours[(i + 1) % n]);
+            }
+            else
+            {
+                ring_vertices.push_back(v[n-1-i]);
+                ring_neighbours.push_back(neighbours[n-1-i]);
+            }
+        }
+        ring_vertices.push_back(ring_vertices[ring_offsets.back()]);
+        ring_neighbours.push_back(-1);
+        ring_offsets.push_back(ring_vertices.size());
+    }
+    ring_xy.resize(2 * ring_vertices.size());
+    for (size_t k = 0; k < ring_vertices.size(); k++)
+    {
+        ring_xy[2*k] = vertex_xy[2*ring_vertices[k]];
+        ring_xy[2*k+1] = vertex_xy[2*ring_vertices[k]+1];
+    }
+}
+
+int RayCaster::polygon_after(int w, int p, double dx, double dy) const
+{
+    const double wx = vertex_xy[2*w];
+    const double wy = vertex_xy[2*w+1];
+    for (int i = vertex_offsets[w]; i < vertex_offsets[w+1]; i++)
+    {
+        const int q = vertex_polygons[i];
+        if (q == -1 || q == p)
+        {
+            continue;
+        }
+        const int begin = ring_offsets[q];
+        const int end = ring_offsets[q+1] - 1;
+        int k = begin;
+        while (k < end && ring_vertices[k] != w)
+        {
+            k++;
+        }
+        if (k == end)
+        {
+            continue;
+        }
+        // The corner of q at w goes counterclockwise from the next vertex
+        // round to the previous one.
+        const int prev = k == begin ? end - 1 : k - 1;
+        const double* next_xy = &ring_xy[2*(k+1)];
+        const double* prev_xy = &ring_xy[2*prev];
+        if ((next_xy[0] - wx) * dy - (next_xy[1] - wy) * dx >= 0 &&
+            dx * (prev_xy[1] - wy) - dy * (prev_xy[0] - wx) >= 0)
+        {
+            return q;
+        }
+    }
+    return -1;
+}
+
+bool RayCaster::walk(double ax, double ay, double dx, double dy,
+                     const double* b, double& hit) const
+{
+    hit = 0;
+    int p = locator.locate(ax, ay);
+    if (p == -1)
+    {
+        return false;
+    }
+    const double dd = dx * dx + dy * dy;
+    if (dd == 0)
+    {
+        return b != nullptr;
+    }
+    // Each polygon is only gone through once, unless rounding goes wrong.
+    const int num_polygons = ring_offsets.size() - 1;
+    for (int step = 0; step <= num_polygons; step++)
+    {
+        const int begin = ring_offsets[p];
+        const int end = ring_offsets[p+1] - 1;
+        const double* v = &ring_xy[2*begin];
+        const int n = end - begin;
+        if (b != nullptr)
+        {
+            bool inside = true;
+            for (int k = 0; k < n; k++)
+            {
+                const double cross = (v[2*k+2] - v[2*k]) * (b[1] - v[2*k+1]) -
+                                     (v[2*k+3] - v[2*k+1]) * (b[0] - v[2*k]);
+                inside &= cross >= 0;
+            }
+            if (inside)
+            {
+                return true;
+            }
+        }
+
+        // Which side of the line each vertex is on, as the polygon goes
+        // counterclockwise. The line leaves where it goes from the right
+        // (negative) to the left, either through an edge or a vertex on the
+        // line. If it doesn't go through the polygon it just touches it, and
+        // leaves from the furthest vertex on the line.
+        int exit_edge = -1;
+        int exit_vertex = -1;
+        double exit_along = 0;
+        double side = dx * (v[1] - ay) - dy * (v[0] - ax);
+        for (int k = 0; k < n; k++)
+        {
+            const double next_side = dx * (v[2*k+3] - ay) -
+                                      dy * (v[2*k+2] - ax);
+            if (side < 0 && next_side > 0)
+            {
+                exit_edge = k;
+                break;
+            }
+            if (side == 0)
+            {
+                const double along = (v[2*k] - ax) * dx + (v[2*k+1] - ay) * dy;
+                if (exit_vertex == -1 || along > exit_along)
+                {
+                    exit_vertex = k;
+                    exit_along = along;
+                }
+            }
+            side = next_side;
+        }
+
+        if (exit_edge != -1)
+        {
+            const int k = exit_edge;
+            const int q = ring_neighbours[begin+k];
+            if (q == -1)
+            {
+                const double s0 = dx * (v[2*k+1] - ay) - dy * (v[2*k] - ax);
+                const double s1 = dx * (v[2*k+3] - ay) - dy * (v[2*k+2] - ax);
+                const double f = s0 / (s0 - s1);
+                const double x = v[2*k] + f * (v[2*k+2] - v[2*k]);
+                const double y = v[2*k+1] + f * (v[2*k+3] - v[2*k+1]);
+                hit = ((x - ax) * dx + (y - ay) * dy) / dd;
+                return false;
+            }
+            p = q;
+        }
+        else if (exit_vertex != -1)
+        {
+            const int q = polygon_after(ring_vertices[begin+exit_vertex], p,
+                                        dx, dy);
+            if (q == -1)
+            {
+                hit = exit_along / dd;
+                return false;
+            }
+            p = q;
+        }
+        else
+        {
+            // Rounding must have put the line outside p.
+            return false;
+        }
+    }
+    return false;
+}
+
+bool RayCaster::line_of_sight(double ax, double ay, double bx,
+                              double by) const
+{
+    const double b[2] = {bx, by};
+    double hit;
+    return walk(ax, ay, bx - ax, by - ay, b, hit);
+}
+
+double RayCaster::raycast(double x, double y, double dx, double dy) const
+{
+    double hit;
+    walk(x, y, dx, dy, nullptr, hit);
+    return hit;
+}
+
+void RayCaster::line_of_sight_batch(const double* segments, int n,
+                                    char* out, int threads) const
+{
+    const int chunks = (n + BATCH_CHUNK - 1) / BATCH_CHUNK;
+    parallel_for(chunks, threads, [&](int chunk)
+    {
+        const int end = min(n, (chunk + 1) * BATCH_CHUNK);
+        for (int i = chunk * BATCH_CHUNK; i < end; i++)
+        {
+            const double* s = segments + 4 * i;
+            out[i] = line_of_sight(s[0], s[1], s[2], s[3]);
+        }
+    });
+}
+
+void RayCaster::raycast_batch(const double* rays, int n, double* out,
+                              int threads) const
+{
+    const int chunks = (n + BATCH_CHUNK - 1) / BATCH_CHUNK;
+    parallel_for(chunks, threads, [&](int chunk)
+    {
+        const int end = min(n, (chunk + 1) * BATCH_CHUNK);
+        for (int i = chunk * BATCH_CHUNK; i < end; i++)
+        {
+            const double* r = rays + 4 * i;
+            out[i] = raycast(r[0], r[1], r[2], r[3]);
+        }
+    });
+}
+
+}
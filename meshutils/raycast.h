@@ -0,0 +1,73 @@
+#pragma once
+#include "navmesh.h"
+#include "locate.h"
+#include <vector>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Answers line of sight and raycast queries on a mesh by walking from
+// polygon to polygon along the line until it gets where it's going or hits a
+// -1 neighbour.
+// A point can be seen if every point on the line to it is in (or on the edge
+// of) a polygon, so lines can go along obstacle edges and through vertices
+// where two obstacles touch.
+// Signs are worked out exactly (as long as the products of coordinates are),
+// so meshes with integer or half-integer coordinates have no rounding
+// problems.
+class RayCaster
+{
+public:
+    RayCaster() {}
+
+    // Builds the edge arrays and a PointLocator for the mesh.
+    void build(const NavMesh& mesh);
+
+    // Whether (bx, by) can be seen from (ax, ay).
+    bool line_of_sight(double ax, double ay, double bx, double by) const;
+    // How far along the ray from (x, y) in direction (dx, dy) it first hits
+    // an obstacle (or the edge of the mesh), as a multiple of (dx, dy).
+    // 0 if (x, y) isn't in the mesh.
+    double raycast(double x, double y, double dx, double dy) const;
+
+    // Each of these does n queries, using up to threads threads (0 for one
+    // per core).
+    // segments is ax, ay, bx, by for each query, and out is 1 if it can be
+    // seen or 0 if not.
+    void line_of_sight_batch(const double* segments, int n, char* out,
+                             int threads = 0) const;
+    // rays is x, y, dx, dy for each query, and out is what raycast gives.
+    void raycast_batch(const double* rays, int n, double* out,
+                       int threads = 0) const;
+
+private:
+    PointLocator locator;
+
+    // The vertices of polygon i, counterclockwise, are
+    // ring_vertices[ring_offsets[i]] to ring_vertices[ring_offsets[i+1]-2],
+    // with the first one repeated at ring_offsets[i+1]-1. ring_xy has their
+    // coordinates, and ring_neighbours[k] is the polygon on the other side of
+    // the edge from ring point k to k+1.
+    vector<int> ring_offsets;
+    vector<int> ring_vertices;
+    vector<double> ring_xy;
+    vector<int> ring_neighbours;
+    // From the mesh, for going through vertices.
+    vector<double> vertex_xy;
+    vector<int> vertex_offsets;
+    vector<int> vertex_polygons;
+
+    // Walks from (ax, ay) along the line in direction (dx, dy). If b is
+    // given, stops once it gets to b and returns true. Otherwise (or if it is
+    // blocked first) returns false and sets hit to how far along (as a
+    // multiple of (dx, dy)) it was blocked.
+    bool walk(double ax, double ay, double dx, double dy, const double* b,
+              double& hit) const;
+    // The polygon around vertex w which the line in direction (dx, dy) goes
+    // into after w, other than p, or -1 if there isn't one.
+    int polygon_after(int w, int p, double dx, double dy) const;
+};
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include "gridmap.h"
+#include "navmesh.h"
+#include "timing.h"
+
+namespace meshutils
+{
+
+// Meshes made straight from the grid, without Fade2D. Every vertex is on a
+// grid corner.
+
+// Greedily covers the traversable cells with rectangles, like gridmap2rects.
+// The best rectangle is taken first, going by min(width, height) * area, to
+// favour square-like rectangles.
+// If times isn't null, each phase is timed into it.
+void make_rect_mesh(const GridMap& map, NavMesh& out,
+                    PhaseTimes* times = nullptr);
+
+// Makes each traversable cell its own square, like gridmap2grid.
+void make_grid_mesh(const GridMap& map, NavMesh& out,
+                    PhaseTimes* times = nullptr);
+
+}
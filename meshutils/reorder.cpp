@@ -0,0 +1,176 @@
+#include "reorder.h"
+#include <algorithm>
+#include <cstdint>
+
+namespace meshutils
+{
+
+namespace
+{
+
+// Points are snapped to a 2^CURVE_BITS by 2^CURVE_BITS grid over the mesh.
+const int CURVE_BITS = 16;
+
+uint64_t morton_index(uint32_t x, uint32_t y)
+{
+    uint64_t out = 0;
+    for (int i = 0; i < CURVE_BITS; i++)
+    {
+        out |= uint64_t((x >> i) & 1) << (2 * i);
+        out |= uint64_t((y >> i) & 1) << (2 * i + 1);
+    }
+    return out;
+}
+
+// The usual xy to d conversion: each step picks a quadrant, then rotates and
+// flips the rest so the curve joins up.
+uint64_t hilbert_index(uint32_t x, uint32_t y)
+{
+    const uint32_t n = 1u << CURVE_BITS;
+    uint64_t out = 0;
+    for (uint32_t s = n / 2; s > 0; s /= 2)
+    {
+        const uint32_t rx = (x & s) != 0;
+        const uint32_t ry = (y & s) != 0;
+        out += uint64_t(s) * s * ((3 * rx) ^ ry);
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            swap(x, y);
+        }
+    }
+    return out;
+}
+
+// The order to put points in, and where each point ends up.
+void curve_order(const vector<double>& xy, CurveOrder curve,
+                 double min_x, double min_y, double scale,
+                 vector<int>& order, vector<int>& new_index)
+{
+    const int n = xy.size() / 2;
+    vector<uint64_t> keys(n);
+    for (int i = 0; i < n; i++)
+    {
+        const uint32_t x = (xy[2*i] - min_x) * scale;
+        const uint32_t y = (xy[2*i+1] - min_y) * scale;
+        keys[i] = curve == CURVE_HILBERT ? hilbert_index(x, y)
+                                         : morton_index(x, y);
+    }
+    order.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        order[i] = i;
+    }
+    stable_sort(order.begin(), order.end(), [&](int a, int b)
+    {
+        return keys[a] < keys[b];
+    });
+    new_index.resize(n);
+    for (int i = 0; i < n; i++)
+    {
+        new_index[order[i]] = i;
+    }
+}
+
+}
+
+void reorder_mesh(NavMesh& mesh, CurveOrder curve)
+{
+    const int V = mesh.num_vertices();
+    const int P = mesh.num_polygons();
+    if (curve == CURVE_NONE || V == 0)
+    {
+        return;
+    }
+
+    double min_x = mesh.vertex_xy[0], max_x = min_x;
+    double min_y = mesh.vertex_xy[1], max_y = min_y;
+    for (int i = 0; i < V; i++)
+    {
+        min_x = min(min_x, mesh.vertex_xy[2*i]);
+        max_x = max(max_x, mesh.vertex_xy[2*i]);
+        min_y = min(min_y, mesh.vertex_xy[2*i+1]);
+        max_y = max(max_y, mesh.vertex_xy[2*i+1]);
+    }
+    // The same scale both ways, so the cells are square.
+    const double size = max(max_x - min_x, max_y - min_y);
+    const double scale = size > 0 ? ((1u << CURVE_BITS) - 1) / size : 0;
+
+    vector<double> centres(2 * P);
+    for (int i = 0; i < P; i++)
+    {
+        const int start = mesh.polygon_offsets[i];
+        const int end = mesh.polygon_offsets[i+1];
+        double x = 0, y = 0;
+        for (int j = start; j < end; j++)
+        {
+            x += mesh.vertex_xy[2*mesh.polygon_vertices[j]];
+            y += mesh.vertex_xy[2*mesh.polygon_vertices[j]+1];
+        }
+        centres[2*i] = x / (end - start);
+        centres[2*i+1] = y / (end - start);
+    }
+
+    vector<int> vertex_order, new_vertex;
+    vector<int> polygon_order, new_polygon;
+    curve_order(mesh.vertex_xy, curve, min_x, min_y, scale, vertex_order,
+                new_vertex);
+    curve_order(centres, curve, min_x, min_y, scale, polygon_order,
+                new_polygon);
+
+    #define get_v(v) ((v) == -1 ? -1 : new_vertex[v])
+    #define get_p(p) ((p) == -1 ? -1 : new_polygon[p])
+
+    NavMesh out;
+    vector<int> vertices;
+    vector<int> polygons;
+    for (int old : vertex_order)
+    {
+        polygons.clear();
+        for (int j = mesh.vertex_offsets[old];
+             j < mesh.vertex_offsets[old+1]; j++)
+        {
+            polygons.push_back(get_p(mesh.vertex_polygons[j]));
+        }
+        out.add_vertex(mesh.vertex_xy[2*old], mesh.vertex_xy[2*old+1],
+                       polygons);
+    }
+    for (int old : polygon_order)
+    {
+        vertices.clear();
+        polygons.clear();
+        for (int j = mesh.polygon_offsets[old];
+             j < mesh.polygon_offsets[old+1]; j++)
+        {
+            vertices.push_back(get_v(mesh.polygon_vertices[j]));
+            polygons.push_back(get_p(mesh.polygon_neighbours[j]));
+        }
+        out.add_polygon(vertices, polygons);
+    }
+
+    #undef get_p
+    #undef get_v
+
+    mesh = out;
+}
+
+bool parse_reorder_arg(const string& arg, CurveOrder& curve)
+{
+    if (arg == "--reorder=hilbert")
+    {
+        curve = CURVE_HILBERT;
+        return true;
+    }
+    if (arg == "--reorder=morton")
+    {
+        curve = CURVE_MORTON;
+        return true;
+    }
+    return false;
+}
+
+}
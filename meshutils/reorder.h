@@ -0,0 +1,32 @@
+#pragma once
+#include "navmesh.h"
+#include <string>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Orders to renumber a mesh in, so polygons which are near each other on the
+// map are near each other in memory too.
+enum CurveOrder
+{
+    // Leave it as it is.
+    CURVE_NONE,
+    // Along a Hilbert curve, which never jumps between distant cells.
+    CURVE_HILBERT,
+    // Along a Z-order (Morton) curve, which is cheaper to work out but
+    // jumps at the edge of every power of two.
+    CURVE_MORTON
+};
+
+// Renumbers the vertices (by position) and polygons (by the mean of their
+// vertices) along the curve, and fixes up every reference to them. Ties keep
+// their old order. Nothing else about the mesh changes.
+void reorder_mesh(NavMesh& mesh, CurveOrder curve);
+
+// Gets the curve out of --reorder=hilbert or --reorder=morton. Returns false
+// if arg isn't one of those.
+bool parse_reorder_arg(const string& arg, CurveOrder& curve);
+
+}
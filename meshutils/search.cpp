@@ -0,0 +1,636 @@
+#include "search.h"
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+namespace meshutils
+{
+
+namespace
+{
+
+// How close two points (or a point and a line) are before they are the same.
+const double EPSILON = 1e-8;
+
+// > 0 if c is to the left of the line from a to b, < 0 if it is to the
+// right.
+template <typename P>
+inline double orient(const P& a, const P& b, const P& c)
+{
+    return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+}
+
+template <typename P>
+inline double distance(const P& a, const P& b)
+{
+    return hypot(b.x - a.x, b.y - a.y);
+}
+
+template <typename P>
+inline bool same_point(const P& a, const P& b)
+{
+    return fabs(a.x - b.x) <= EPSILON && fabs(a.y - b.y) <= EPSILON;
+}
+
+// Where the line through a and b crosses the segment from c to d, given
+// which side of the line c and d are on.
+template <typename P>
+P intersect(const P& c, const P& d, double side_c, double side_d)
+{
+    const double t = side_c / (side_c - side_d);
+    return P{c.x + t * (d.x - c.x), c.y + t * (d.y - c.y)};
+}
+
+// Open list entries. Lowest f first, then highest g, like Polyanya.
+struct Entry
+{
+    double f;
+    double g;
+    int node;
+
+    bool operator<(const Entry& other) const
+    {
+        if (f != other.f)
+        {
+            return f > other.f;
+        }
+        return g < other.g;
+    }
+};
+
+}
+
+void MeshSearch::build(const NavMesh& in)
+{
+    mesh = in;
+    locator.build(mesh);
+    const int V = mesh.num_vertices();
+    const int P = mesh.num_polygons();
+    corner.assign(V, 0);
+    for (int v = 0; v < V; v++)
+    {
+        for (int i = mesh.vertex_offsets[v]; i < mesh.vertex_offsets[v+1];
+             i++)
+        {
+            if (mesh.vertex_polygons[i] == -1)
+            {
+                corner[v] = 1;
+            }
+        }
+    }
+    dead_end.assign(P, 0);
+    for (int p = 0; p < P; p++)
+    {
+        int traversable = 0;
+        for (int i = mesh.polygon_offsets[p]; i < mesh.polygon_offsets[p+1];
+             i++)
+        {
+            traversable += mesh.polygon_neighbours[i] != -1;
+        }
+        dead_end[p] = traversable == 1;
+    }
+    root_g.assign(V, 0);
+    root_search.assign(V, 0);
+    search_id = 0;
+}
+
+MeshSearch::Point MeshSearch::root_point(int root) const
+{
+    if (root == -1)
+    {
+        return start;
+    }
+    return Point{mesh.vertex_xy[2*root], mesh.vertex_xy[2*root+1]};
+}
+
+bool MeshSearch::contains(int polygon, const Point& p) const
+{
+    const int begin = mesh.polygon_offsets[polygon];
+    const int n = mesh.polygon_offsets[polygon+1] - begin;
+    for (int i = 0; i < n; i++)
+    {
+        const Point a = root_point(mesh.polygon_vertices[begin + i]);
+        const Point b = root_point(mesh.polygon_vertices[begin + (i+1) % n]);
+        if (orient(a, b, p) < 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void MeshSearch::polygons_at(double x, double y, vector<int>& out) const
+{
+    out.clear();
+    const int first = locator.locate(x, y);
+    if (first == -1)
+    {
+        return;
+    }
+    // Anything else it's in must share an edge or a vertex with the first.
+    vector<int> candidates(1, first);
+    for (int i = mesh.polygon_offsets[first];
+         i < mesh.polygon_offsets[first+1]; i++)
+    {
+        candidates.push_back(mesh.polygon_neighbours[i]);
+        const int v = mesh.polygon_vertices[i];
+        const auto fan = mesh.vertex_polygons.begin();
+        candidates.insert(candidates.end(), fan + mesh.vertex_offsets[v],
+                          fan + mesh.vertex_offsets[v+1]);
+    }
+    sort(candidates.begin(), candidates.end());
+    candidates.erase(unique(candidates.begin(), candidates.end()),
+                     candidates.end());
+    const Point p{x, y};
+    for (int polygon : candidates)
+    {
+        if (polygon != -1 && contains(polygon, p))
+        {
+            out.push_back(polygon);
+        }
+    }
+}
+
+double MeshSearch::heuristic(const Node& node) const
+{
+    const Point r = root_point(node.root);
+    const Point& left = node.left;
+    const Point& right = node.right;
+    // If the goal is on the same side of the interval as the root, the path
+    // has to come back through the interval, which is the same as going to
+    // the goal's reflection.
+    Point target = goal;
+    const double root_side = orient(right, left, r);
+    const double goal_side = orient(right, left, goal);
+    if ((root_side > EPSILON && goal_side > EPSILON) ||
+        (root_side < -EPSILON && goal_side < -EPSILON))
+    {
+        const double dx = left.x - right.x;
+        const double dy = left.y - right.y;
+        const double t = ((goal.x - right.x) * dx + (goal.y - right.y) * dy) /
+                         (dx * dx + dy * dy);
+        target = Point{2 * (right.x + t * dx) - goal.x,
+                       2 * (right.y + t * dy) - goal.y};
+    }
+    const double via_left = distance(r, left) + distance(left, target);
+    const double via_right = distance(r, right) + distance(right, target);
+    if (fabs(orient(r, right, left)) <= EPSILON)
+    {
+        return min(via_left, via_right);
+    }
+    if (orient(r, right, target) < 0)
+    {
+        return via_right;
+    }
+    if (orient(r, left, target) > 0)
+    {
+        return via_left;
+    }
+    return distance(r, target);
+}
+
+bool MeshSearch::keep_root(int v, double g)
+{
+    if (root_search[v] != search_id || g < root_g[v] - EPSILON)
+    {
+        root_search[v] = search_id;
+        root_g[v] = g;
+        return true;
+    }
+    return g <= root_g[v] + EPSILON;
+}
+
+void MeshSearch::add_successors(int parent, int root, double g,
+                                const vector<int>& chain, int first_edge,
+                                const Point& begin, int last_edge,
+                                const Point& end, vector<Node>& out)
+{
+    const Point r = root_point(root);
+    for (int k = max(first_edge, 0); k <= last_edge; k++)
+    {
+        const int right_vertex = mesh.polygon_vertices[chain[k]];
+        const int left_vertex = mesh.polygon_vertices[chain[k+1]];
+        const Point right = k == first_edge ? begin : root_point(right_vertex);
+        const Point left = k == last_edge ? end : root_point(left_vertex);
+        const int next = mesh.polygon_neighbours[chain[k+1]];
+        if (next == -1 || same_point(left, right))
+        {
+            continue;
+        }
+        if (dead_end[next] &&
+            find(goal_polygons.begin(), goal_polygons.end(), next) ==
+            goal_polygons.end())
+        {
+            continue;
+        }
+        // Intervals seen edge-on can only be gone through by turning at
+        // the near end, unless the root is one of their ends.
+        int turn = root;
+        double turn_g = g;
+        if (fabs(orient(r, right, left)) <= EPSILON &&
+            root != right_vertex && root != left_vertex)
+        {
+            const bool right_nearer = distance(r, right) < distance(r, left);
+            turn = right_nearer ? right_vertex : left_vertex;
+            const Point near = right_nearer ? right : left;
+            turn_g = g + distance(r, near);
+            if (!same_point(near, root_point(turn)) || !corner[turn] ||
+                !keep_root(turn, turn_g))
+            {
+                continue;
+            }
+        }
+        Node node;
+        node.parent = parent;
+        node.root = turn;
+        node.left = left;
+        node.right = right;
+        node.left_vertex = left_vertex;
+        node.right_vertex = right_vertex;
+        node.next_polygon = next;
+        node.g = turn_g;
+        node.f = turn_g + heuristic(node);
+        out.push_back(node);
+    }
+}
+
+void MeshSearch::get_successors(int n, vector<Node>& out)
+{
+    const Node node = nodes[n];
+    const int polygon = node.next_polygon;
+    const int begin = mesh.polygon_offsets[polygon];
+    const int m = mesh.polygon_offsets[polygon+1] - begin;
+    // The polygon goes counterclockwise, so the edge we came in through goes
+    // from left_vertex to right_vertex.
+    int j = 0;
+    while (j < m &&
+           !(mesh.polygon_vertices[begin + j] == node.left_vertex &&
+             mesh.polygon_vertices[begin + (j+1) % m] == node.right_vertex))
+    {
+        j++;
+    }
+    if (j == m)
+    {
+        return;
+    }
+    // The rest of the polygon, from right_vertex round to left_vertex, as
+    // indexes into polygon_vertices. Edge k goes from chain[k] to
+    // chain[k+1].
+    vector<int> chain(m);
+    for (int k = 0; k < m; k++)
+    {
+        chain[k] = begin + (j + 1 + k) % m;
+    }
+    const Point r = root_point(node.root);
+    const Point& left = node.left;
+    const Point& right = node.right;
+    const Point first = root_point(node.right_vertex);
+    const Point last = root_point(node.left_vertex);
+    const bool right_is_vertex = same_point(right, first);
+    const bool left_is_vertex = same_point(left, last);
+    const bool collinear = fabs(orient(r, right, left)) <= EPSILON;
+    const bool root_on_edge = node.root != -1 &&
+                              (node.root == node.left_vertex ||
+                               node.root == node.right_vertex);
+
+    if (find(goal_polygons.begin(), goal_polygons.end(), polygon) !=
+        goal_polygons.end())
+    {
+        // Go straight to the goal if it can be seen through the interval,
+        // or turn at whichever end of it is in the way.
+        Node final_node = node;
+        final_node.parent = n;
+        final_node.next_polygon = -1;
+        final_node.left = final_node.right = goal;
+        int turn = -1;
+        if (collinear && !root_on_edge)
+        {
+            double best = INFINITY;
+            if (right_is_vertex &&
+                distance(r, right) + distance(right, goal) < best)
+            {
+                best = distance(r, right) + distance(right, goal);
+                turn = node.right_vertex;
+            }
+            if (left_is_vertex &&
+                distance(r, left) + distance(left, goal) < best)
+            {
+                turn = node.left_vertex;
+            }
+            if (turn == -1)
+            {
+                return;
+            }
+        }
+        else if (!collinear && orient(r, right, goal) < -EPSILON)
+        {
+            if (!right_is_vertex)
+            {
+                return;
+            }
+            turn = node.right_vertex;
+        }
+        else if (!collinear && orient(r, left, goal) > EPSILON)
+        {
+            if (!left_is_vertex)
+            {
+                return;
+            }
+            turn = node.left_vertex;
+        }
+        if (turn != -1)
+        {
+            final_node.root = turn;
+            final_node.g += distance(r, root_point(turn));
+        }
+        final_node.f = final_node.g +
+                       distance(root_point(final_node.root), goal);
+        out.push_back(final_node);
+        return;
+    }
+
+    if (collinear)
+    {
+        // If the root is on the polygon, all of it can be seen. Otherwise
+        // the path has to turn at an end of the interval to get in.
+        if (root_on_edge)
+        {
+            add_successors(n, node.root, node.g, chain, 0,
+                           first, m - 2, last, out);
+            return;
+        }
+        if (right_is_vertex && corner[node.right_vertex])
+        {
+            const double g = node.g + distance(r, right);
+            if (keep_root(node.right_vertex, g))
+            {
+                add_successors(n, node.right_vertex, g, chain,
+                               0, first, m - 2, last, out);
+            }
+        }
+        if (left_is_vertex && corner[node.left_vertex])
+        {
+            const double g = node.g + distance(r, left);
+            if (keep_root(node.left_vertex, g))
+            {
+                add_successors(n, node.left_vertex, g, chain,
+                               0, first, m - 2, last, out);
+            }
+        }
+        return;
+    }
+
+    auto chain_point = [&](int k)
+    {
+        return root_point(mesh.polygon_vertices[chain[k]]);
+    };
+    // Where the ray from the root through the right end of the interval
+    // leaves the polygon: right_point, on edge right_edge. Everything before
+    // it on the chain is to the right of the ray.
+    // (When the right end is the first vertex, the ray can still leave
+    // further round, so this always looks.)
+    int right_edge = 0;
+    Point right_point = first;
+    for (int k = 0; k < m - 1; k++)
+    {
+        const Point next = chain_point(k + 1);
+        const double side = orient(r, right, next);
+        if (side >= -EPSILON)
+        {
+            if (side <= EPSILON)
+            {
+                right_edge = k + 1;
+                right_point = next;
+            }
+            else
+            {
+                right_edge = k;
+                right_point = intersect(chain_point(k), next,
+                                        orient(r, right, chain_point(k)),
+                                        side);
+            }
+            break;
+        }
+    }
+    // The same for the left end, going back from the end of the chain.
+    int left_edge = m - 2;
+    Point left_point = last;
+    for (int k = m - 2; k >= 0; k--)
+    {
+        const Point previous = chain_point(k);
+        const double side = orient(r, left, previous);
+        if (side <= EPSILON)
+        {
+            if (side >= -EPSILON)
+            {
+                left_edge = k - 1;
+                left_point = previous;
+            }
+            else
+            {
+                left_edge = k;
+                left_point = intersect(previous, chain_point(k + 1), side,
+                                       orient(r, left, chain_point(k + 1)));
+            }
+            break;
+        }
+    }
+
+    // Observable successors, which can be seen straight from the root.
+    if (right_edge <= left_edge)
+    {
+        add_successors(n, node.root, node.g, chain,
+                       right_edge, right_point, left_edge, left_point, out);
+    }
+    // Non-observable successors, which can only be got to by turning at a
+    // corner at an end of the interval.
+    if (right_is_vertex && corner[node.right_vertex])
+    {
+        const double g = node.g + distance(r, right);
+        if (keep_root(node.right_vertex, g))
+        {
+            add_successors(n, node.right_vertex, g, chain, 0,
+                           first, min(right_edge, m - 2), right_point, out);
+        }
+    }
+    if (left_is_vertex && corner[node.left_vertex])
+    {
+        const double g = node.g + distance(r, left);
+        if (keep_root(node.left_vertex, g))
+        {
+            add_successors(n, node.left_vertex, g, chain,
+                           left_edge, left_point, m - 2, last, out);
+        }
+    }
+}
+
+void MeshSearch::print_node(const char* label, const Node& node,
+                            ostream& trace) const
+{
+    const Point r = root_point(node.root);
+    trace << label << "root=(" << r.x << ", " << r.y << "); left=("
+          << node.left.x << ", " << node.left.y << "); right=("
+          << node.right.x << ", " << node.right.y << "); f=" << node.f
+          << ", g=" << node.g << "\n";
+}
+
+double MeshSearch::search(double sx, double sy, double gx, double gy,
+                          SearchStats& stats, vector<double>* path,
+                          ostream* trace)
+{
+    stats = SearchStats();
+    if (path != nullptr)
+    {
+        path->clear();
+    }
+    search_id++;
+    nodes.clear();
+    start = Point{sx, sy};
+    goal = Point{gx, gy};
+
+    vector<int> start_polygons;
+    polygons_at(sx, sy, start_polygons);
+    polygons_at(gx, gy, goal_polygons);
+    if (start_polygons.empty() || goal_polygons.empty())
+    {
+        return -1;
+    }
+    for (int polygon : start_polygons)
+    {
+        if (find(goal_polygons.begin(), goal_polygons.end(), polygon) !=
+            goal_polygons.end())
+        {
+            if (trace != nullptr)
+            {
+                *trace << "found end - terminating!\n";
+            }
+            if (path != nullptr)
+            {
+                *path = {sx, sy, gx, gy};
+            }
+            return distance(start, goal);
+        }
+    }
+
+    priority_queue<Entry> open;
+    auto push = [&](const Node& node, const char* label)
+    {
+        stats.pushed++;
+        nodes.push_back(node);
+        open.push(Entry{node.f, node.g, (int) nodes.size() - 1});
+        if (trace != nullptr)
+        {
+            print_node(label, node, *trace);
+        }
+    };
+
+    // Look out of every edge of every polygon the start is in.
+    for (int polygon : start_polygons)
+    {
+        const int begin = mesh.polygon_offsets[polygon];
+        const int m = mesh.polygon_offsets[polygon+1] - begin;
+        vector<int> chain(m + 1);
+        for (int k = 0; k <= m; k++)
+        {
+            chain[k] = begin + k % m;
+        }
+        vector<Node> initial;
+        add_successors(-1, -1, 0, chain, 0,
+                       root_point(mesh.polygon_vertices[begin]), m - 1,
+                       root_point(mesh.polygon_vertices[begin]), initial);
+        for (const Node& node : initial)
+        {
+            // Edges of other polygons the start is in are done from there.
+            if (find(start_polygons.begin(), start_polygons.end(),
+                     node.next_polygon) == start_polygons.end())
+            {
+                stats.generated++;
+                push(node, "generating init node: ");
+            }
+        }
+    }
+
+    vector<Node> successors;
+    while (!open.empty())
+    {
+        int n = open.top().node;
+        open.pop();
+        stats.popped++;
+        const Node& node = nodes[n];
+        if (node.next_polygon == -1)
+        {
+            if (trace != nullptr)
+            {
+                *trace << "found end - terminating!\n";
+            }
+            if (path != nullptr)
+            {
+                // Every root from the goal back to the start.
+                vector<int> roots;
+                for (int i = n; i != -1; i = nodes[i].parent)
+                {
+                    if (roots.empty() || roots.back() != nodes[i].root)
+                    {
+                        roots.push_back(nodes[i].root);
+                    }
+                }
+                for (int i = roots.size() - 1; i >= 0; i--)
+                {
+                    const Point p = root_point(roots[i]);
+                    path->push_back(p.x);
+                    path->push_back(p.y);
+                }
+                path->push_back(gx);
+                path->push_back(gy);
+            }
+            return node.f;
+        }
+        if (node.root != -1 && root_search[node.root] == search_id &&
+            node.g > root_g[node.root] + EPSILON)
+        {
+            stats.pruned++;
+            continue;
+        }
+        if (trace != nullptr)
+        {
+            print_node("popped off: ", node, *trace);
+        }
+
+        successors.clear();
+        get_successors(n, successors);
+        stats.expanded++;
+        stats.generated += successors.size();
+        // A node with only one successor is expanded straight away, as
+        // nothing else can get in first. Nothing points at the node being
+        // expanded yet, so if the root stays the same it can be replaced,
+        // which keeps long chains of thin polygons from filling nodes.
+        while (successors.size() == 1 && successors[0].next_polygon != -1)
+        {
+            if (successors[0].root == nodes[n].root)
+            {
+                successors[0].parent = nodes[n].parent;
+                nodes[n] = successors[0];
+            }
+            else
+            {
+                nodes.push_back(successors[0]);
+                n = nodes.size() - 1;
+            }
+            if (trace != nullptr)
+            {
+                print_node("\tintermediate: ", nodes[n], *trace);
+            }
+            successors.clear();
+            get_successors(n, successors);
+            stats.expanded++;
+            stats.generated += successors.size();
+        }
+        for (const Node& successor : successors)
+        {
+            push(successor, "\tpushing: ");
+        }
+    }
+    return -1;
+}
+
+}
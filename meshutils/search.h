@@ -0,0 +1,118 @@
+#pragma once
+#include "navmesh.h"
+#include "locate.h"
+#include <iostream>
+#include <vector>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// What a search did, like Polyanya counts it.
+struct SearchStats
+{
+    // Nodes whose successors were worked out (including intermediate ones,
+    // which are expanded straight away instead of being pushed).
+    int expanded;
+    // Successors worked out, including the initial nodes.
+    int generated;
+    int pushed;
+    int popped;
+    // Popped nodes which were thrown away, as a shorter path to their root
+    // had been found since they were pushed.
+    int pruned;
+
+    SearchStats()
+        : expanded(0), generated(0), pushed(0), popped(0), pruned(0) {}
+};
+
+// Polyanya (Cui, Harabor and Grastien 2017): an optimal any-angle search on
+// a mesh. Each search node is a root (the start or a vertex the path turns
+// at) and an interval of an edge which can be seen from it, and expanding a
+// node projects the interval across the polygon on the other side of the
+// edge.
+// Polygons must be counterclockwise, as the spec says. Paths can go along
+// obstacle edges and through vertices where obstacles touch.
+// This keeps its own state for a search, so each thread needs its own.
+class MeshSearch
+{
+public:
+    MeshSearch() : search_id(0) {}
+
+    void build(const NavMesh& mesh);
+
+    // The length of the shortest path from (sx, sy) to (gx, gy), or -1 if
+    // there isn't one (including if either isn't in the mesh).
+    // If path is given, it gets x0, y0, x1, y1, ... of each point of the
+    // path, from the start to the goal. If trace is given, what the search
+    // does is written to it in the same format as Polyanya's traces (see
+    // scripts/polyanya.trace).
+    double search(double sx, double sy, double gx, double gy,
+                  SearchStats& stats, vector<double>* path = nullptr,
+                  ostream* trace = nullptr);
+
+private:
+    struct Point
+    {
+        double x;
+        double y;
+    };
+    struct Node
+    {
+        // The node this was made from, in nodes, or -1.
+        int parent;
+        // The vertex the path last turned at, or -1 for the start.
+        int root;
+        // The interval, as seen from the root, on the edge from
+        // right_vertex to left_vertex (clockwise in next_polygon).
+        Point left;
+        Point right;
+        int left_vertex;
+        int right_vertex;
+        // The polygon the interval goes into, or -1 if this is the goal.
+        int next_polygon;
+        double f;
+        double g;
+    };
+
+    NavMesh mesh;
+    PointLocator locator;
+    // Vertices next to an obstacle, which are the only ones a shortest path
+    // can turn at.
+    vector<char> corner;
+    // Polygons with only one traversable neighbour.
+    vector<char> dead_end;
+
+    // The state of the current search.
+    Point start;
+    Point goal;
+    vector<int> goal_polygons;
+    vector<Node> nodes;
+    // The shortest path to each vertex found so far (as a root), and which
+    // search it was found in, so they don't need clearing.
+    vector<double> root_g;
+    vector<int> root_search;
+    int search_id;
+
+    // Every polygon (x, y) is in or on the edge of.
+    void polygons_at(double x, double y, vector<int>& out) const;
+    bool contains(int polygon, const Point& p) const;
+    Point root_point(int root) const;
+    double heuristic(const Node& node) const;
+    // Adds the successors of node n to out.
+    void get_successors(int n, vector<Node>& out);
+    // Adds a successor for each part of the edges of a polygon from begin
+    // (on edge first_edge of chain) to end (on edge last_edge), as for
+    // get_successors.
+    void add_successors(int parent, int root, double g,
+                        const vector<int>& chain, int first_edge,
+                        const Point& begin, int last_edge, const Point& end,
+                        vector<Node>& out);
+    // Whether a path to vertex v of length g should be kept.
+    bool keep_root(int v, double g);
+    void print_node(const char* label, const Node& node,
+                    ostream& trace) const;
+};
+
+}
@@ -0,0 +1,274 @@
+#include "stats.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace meshutils
+{
+
+namespace
+{
+
+struct Event
+{
+    string name;
+    int thread;
+    // Since recording started.
+    double start;
+    double seconds;
+    // Resident memory at the end, or -1 if we aren't writing a trace.
+    double rss_mib;
+};
+
+struct Recorder
+{
+    bool json;
+    string trace_filename;
+    chrono::steady_clock::time_point began;
+    mutex lock;
+    vector<Event> events;
+    // In the order they were first seen.
+    vector<pair<string, long long>> counters;
+    map<thread::id, int> threads;
+
+    Recorder() : json(false) {}
+};
+
+// Set by parse_stats_arg, before any threads start, so they can read it
+// without locking.
+Recorder recorder_storage;
+Recorder* recorder = nullptr;
+
+double since(chrono::steady_clock::time_point time)
+{
+    return chrono::duration<double>(time - recorder->began).count();
+}
+
+double rss_mib()
+{
+    long pages = 0, resident = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != nullptr)
+    {
+        if (fscanf(statm, "%ld %ld", &pages, &resident) != 2)
+        {
+            resident = 0;
+        }
+        fclose(statm);
+    }
+    return (double) resident * sysconf(_SC_PAGESIZE) / 1048576.0;
+}
+
+double peak_rss_mib()
+{
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    // Linux gives it in KiB.
+    return usage.ru_maxrss / 1024.0;
+}
+
+string format(const char* spec, double x)
+{
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), spec, x);
+    return buffer;
+}
+
+// Names are ours, but tool names come from argv[0].
+string quote(const string& s)
+{
+    string out = "\"";
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+        }
+        if ((unsigned char) c >= ' ')
+        {
+            out += c;
+        }
+    }
+    return out + "\"";
+}
+
+void print_json(const string& tool, ostream& out)
+{
+    // Phases which ran more than once (on several threads, say) are added
+    // up.
+    vector<string> names;
+    map<string, pair<int, double>> totals;
+    for (const Event& e : recorder->events)
+    {
+        if (totals.count(e.name) == 0)
+        {
+            names.push_back(e.name);
+        }
+        pair<int, double>& total = totals[e.name];
+        total.first++;
+        total.second += e.seconds;
+    }
+    long long allocations, allocated_bytes;
+    heap_totals(allocations, allocated_bytes);
+    out << "{\"tool\": " << quote(tool)
+        << ", \"seconds\": "
+        << format("%.6f", since(chrono::steady_clock::now()))
+        << ", \"peak_rss_mib\": " << format("%.1f", peak_rss_mib())
+        << ", \"allocations\": " << allocations
+        << ", \"allocated_mib\": "
+        << format("%.1f", allocated_bytes / 1048576.0)
+        << ", \"phases\": [";
+    for (size_t i = 0; i < names.size(); i++)
+    {
+        const pair<int, double>& total = totals[names[i]];
+        out << (i > 0 ? ", " : "") << "{\"name\": " << quote(names[i])
+            << ", \"calls\": " << total.first << ", \"seconds\": "
+            << format("%.6f", total.second) << "}";
+    }
+    out << "], \"counters\": {";
+    for (size_t i = 0; i < recorder->counters.size(); i++)
+    {
+        out << (i > 0 ? ", " : "") << quote(recorder->counters[i].first)
+            << ": " << recorder->counters[i].second;
+    }
+    out << "}}" << endl;
+}
+
+// In Chrome's Trace Event Format: a complete ("X") event for each phase, and
+// a counter ("C") event for the memory after it. Times are in microseconds.
+void write_trace(ostream& out)
+{
+    out << "{\"traceEvents\": [\n";
+    bool first = true;
+    for (const Event& e : recorder->events)
+    {
+        out << (first ? "" : ",\n") << "{\"name\": " << quote(e.name)
+            << ", \"ph\": \"X\", \"pid\": 0, \"tid\": " << e.thread
+            << ", \"ts\": " << format("%.3f", e.start * 1e6)
+            << ", \"dur\": " << format("%.3f", e.seconds * 1e6) << "}";
+        first = false;
+        if (e.rss_mib >= 0)
+        {
+            out << ",\n{\"name\": \"rss\", \"ph\": \"C\", \"pid\": 0, "
+                << "\"ts\": "
+                << format("%.3f", (e.start + e.seconds) * 1e6)
+                << ", \"args\": {\"MiB\": " << format("%.1f", e.rss_mib)
+                << "}}";
+        }
+    }
+    out << "\n], \"displayTimeUnit\": \"ms\"}" << endl;
+}
+
+}
+
+bool parse_stats_arg(const string& arg)
+{
+    if (arg == "--stats=json")
+    {
+        recorder_storage.json = true;
+    }
+    else if (arg.compare(0, 15, "--chrome-trace=") == 0 && arg.size() > 15)
+    {
+        recorder_storage.trace_filename = arg.substr(15);
+    }
+    else
+    {
+        return false;
+    }
+    if (recorder == nullptr)
+    {
+        recorder_storage.began = chrono::steady_clock::now();
+        recorder = &recorder_storage;
+    }
+    count_heap();
+    return true;
+}
+
+bool stats_enabled()
+{
+    return recorder != nullptr;
+}
+
+StatsPhase::StatsPhase(const char* name) : name(name)
+{
+    if (recorder != nullptr)
+    {
+        started = chrono::steady_clock::now();
+    }
+}
+
+StatsPhase::~StatsPhase()
+{
+    if (recorder != nullptr)
+    {
+        record_phase(name, started, chrono::steady_clock::now());
+    }
+}
+
+void record_phase(const string& name, chrono::steady_clock::time_point start,
+                  chrono::steady_clock::time_point end)
+{
+    if (recorder == nullptr)
+    {
+        return;
+    }
+    // Reading it is a system call, so only bother for traces.
+    const double rss = recorder->trace_filename.empty() ? -1 : rss_mib();
+    lock_guard<mutex> guard(recorder->lock);
+    const auto found = recorder->threads.insert(make_pair(
+        this_thread::get_id(), (int) recorder->threads.size()));
+    recorder->events.push_back({name, found.first->second, since(start),
+                                chrono::duration<double>(end - start).count(),
+                                rss});
+}
+
+void stats_count(const char* name, long long n)
+{
+    if (recorder == nullptr)
+    {
+        return;
+    }
+    lock_guard<mutex> guard(recorder->lock);
+    for (pair<string, long long>& counter : recorder->counters)
+    {
+        if (counter.first == name)
+        {
+            counter.second += n;
+            return;
+        }
+    }
+    recorder->counters.push_back(make_pair(string(name), n));
+}
+
+bool write_stats(const string& tool, string& error)
+{
+    if (recorder == nullptr)
+    {
+        return true;
+    }
+    lock_guard<mutex> guard(recorder->lock);
+    if (recorder->json)
+    {
+        print_json(tool.substr(tool.find_last_of('/') + 1), cerr);
+    }
+    if (!recorder->trace_filename.empty())
+    {
+        ofstream trace(recorder->trace_filename);
+        if (!trace.is_open())
+        {
+            error = "Unable to open " + recorder->trace_filename;
+            return false;
+        }
+        write_trace(trace);
+    }
+    return true;
+}
+
+}
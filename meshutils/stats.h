@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <string>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Where a tool's time and memory go. Every tool takes --stats=json, which
+// prints a summary as JSON to stderr when it finishes, and
+// --chrome-trace=FILE, which writes each phase (on each thread) and the
+// resident memory as it changes to FILE as Chrome trace events (open it in
+// chrome://tracing or https://ui.perfetto.dev).
+// Phases are timed by StatsPhase, and by PhaseTimes (so the conversions'
+// own phases show up too). Nothing is recorded unless one of the flags is
+// given, so they cost a branch otherwise.
+
+// Takes --stats=json and --chrome-trace=FILE, and turns recording on.
+// Returns false if arg isn't one of those.
+bool parse_stats_arg(const string& arg);
+
+bool stats_enabled();
+
+// Times from here to the end of the scope as a phase called name.
+class StatsPhase
+{
+public:
+    explicit StatsPhase(const char* name);
+    ~StatsPhase();
+
+private:
+    const char* name;
+    chrono::steady_clock::time_point started;
+};
+
+// Records a phase which has already finished, for other timers.
+void record_phase(const string& name, chrono::steady_clock::time_point start,
+                  chrono::steady_clock::time_point end);
+
+// Adds n to the counter called name.
+void stats_count(const char* name, long long n = 1);
+
+// Prints and writes what was recorded, as asked for. tool is the name the
+// summary gives. Returns false and sets error if the trace can't be
+// written. Tools call this just before they finish.
+bool write_stats(const string& tool, string& error);
+
+// The heap in use by the calling thread (allocated here, less what was freed
+// here), and the most it has been. Once counting is on, everything allocated
+// through operator new (including Fade2D) is counted, if the program links
+// meshutils/heapnew.o, as the tools do. Otherwise nothing is.
+struct ThreadHeap
+{
+    long long bytes;
+    long long peak;
+};
+
+// Turns counting on, which --stats=json and --chrome-trace=FILE also do.
+// Allocations made before this aren't counted, but their frees are, so
+// bytes can go below zero.
+void count_heap();
+
+ThreadHeap& thread_heap();
+
+// How many allocations have been counted, and how many bytes they were, over
+// every thread.
+void heap_totals(long long& allocations, long long& bytes);
+
+// Called by heapnew.cpp's operator new and delete.
+void heap_allocated(void* p);
+void heap_freed(void* p);
+
+}
@@ -0,0 +1,818 @@
+#include "textmesh.h"
+#include "parallel.h"
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <climits>
+#include <cmath>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace meshutils
+{
+
+namespace
+{
+
+// How many vertices or polygons each thread parses or formats at a time.
+const int CHUNK_SIZE = 8192;
+// How many chunks are formatted before writing them out.
+const int CHUNKS_PER_WRITE = 64;
+
+// Powers of 10 which doubles can hold exactly.
+const double POWERS_OF_10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+    1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Whitespace as far as istream is concerned (in the C locale).
+inline bool is_space(char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+// Reads whitespace separated tokens from [pos, end).
+struct Scanner
+{
+    const char* pos;
+    const char* end;
+
+    // Finds the next token, or returns false if there isn't one.
+    bool token(const char*& begin, const char*& finish)
+    {
+        while (pos != end && is_space(*pos))
+        {
+            pos++;
+        }
+        if (pos == end)
+        {
+            return false;
+        }
+        begin = pos;
+        while (pos != end && !is_space(*pos))
+        {
+            pos++;
+        }
+        finish = pos;
+        return true;
+    }
+
+    // Reads an int, like istream >> int.
+    bool read_int(int& out)
+    {
+        const char* begin;
+        const char* finish;
+        if (!token(begin, finish))
+        {
+            return false;
+        }
+        bool negative = false;
+        if (*begin == '-' || *begin == '+')
+        {
+            negative = *begin == '-';
+            begin++;
+        }
+        if (begin == finish)
+        {
+            return false;
+        }
+        int64_t value = 0;
+        for (const char* c = begin; c != finish; c++)
+        {
+            if (*c < '0' || *c > '9')
+            {
+                return false;
+            }
+            value = value * 10 + (*c - '0');
+            if (value > int64_t(INT_MAX) + 1)
+            {
+                return false;
+            }
+        }
+        value = negative ? -value : value;
+        if (value > INT_MAX)
+        {
+            return false;
+        }
+        out = value;
+        return true;
+    }
+
+    // Reads a double, like istream >> double. The token is kept in begin and
+    // finish so the exact value can be worked out later.
+    bool read_double(double& out, const char*& begin, const char*& finish)
+    {
+        if (!token(begin, finish))
+        {
+            return false;
+        }
+        // Most coordinates have few enough digits that they can be worked
+        // out exactly with one multiplication or division, which is what
+        // strtod would give.
+        int64_t mantissa;
+        int exponent;
+        if (parse_decimal(begin, finish, mantissa, exponent) &&
+            mantissa < (int64_t(1) << 53) && mantissa > -(int64_t(1) << 53) &&
+            exponent >= -22 && exponent <= 22)
+        {
+            if (mantissa == 0)
+            {
+                out = *begin == '-' ? -0.0 : 0.0;
+            }
+            else if (exponent < 0)
+            {
+                out = mantissa / POWERS_OF_10[-exponent];
+            }
+            else
+            {
+                out = mantissa * POWERS_OF_10[exponent];
+            }
+            return true;
+        }
+        // Otherwise, fall back to strtod, but only for what istream would
+        // accept (no "inf", "nan" or hex).
+        if (finish - begin > 1000)
+        {
+            return false;
+        }
+        for (const char* c = begin; c != finish; c++)
+        {
+            if (!strchr("0123456789+-.eE", *c))
+            {
+                return false;
+            }
+        }
+        const string copy(begin, finish);
+        char* copy_end;
+        out = strtod(copy.c_str(), &copy_end);
+        return *copy_end == '\0' && !copy.empty() && std::isfinite(out);
+    }
+
+    // Whether there's only whitespace left.
+    bool at_end()
+    {
+        const char* begin;
+        const char* finish;
+        return !token(begin, finish);
+    }
+};
+
+// The vertices or polygons parsed by one thread.
+struct Chunk
+{
+    // Vertex coordinates and their exact values, if wanted.
+    vector<double> xy;
+    vector<int64_t> mantissas;
+    vector<int> exponents;
+    bool exact;
+    // The number of polygons of each vertex, or the number of vertices of
+    // each polygon.
+    vector<int> counts;
+    // The polygons of each vertex, or the vertices then neighbours of each
+    // polygon.
+    vector<int> indices;
+    string error;
+
+    Chunk() : exact(true) {}
+};
+
+// The header, and what the vertices and polygons are checked against.
+struct Header
+{
+    int V;
+    int P;
+    const TextMeshOptions* options;
+};
+
+string where(const char* what, int index)
+{
+    return string(" (") + what + " " + to_string(index) + ")";
+}
+
+// Each of these reads one vertex or polygon from scanner, returning false
+// and setting chunk.error if it's invalid.
+
+bool parse_vertex(Scanner& scanner, const Header& header, int index,
+                  Chunk& chunk)
+{
+    double xy[2];
+    for (int j = 0; j < 2; j++)
+    {
+        const char* begin;
+        const char* finish;
+        if (!scanner.read_double(xy[j], begin, finish))
+        {
+            chunk.error = "Error getting vertex point" +
+                          where("vertex", index);
+            return false;
+        }
+        chunk.xy.push_back(xy[j]);
+        if (header.options->exact)
+        {
+            int64_t mantissa = 0;
+            int exponent = 0;
+            chunk.exact = chunk.exact &&
+                          parse_decimal(begin, finish, mantissa, exponent);
+            chunk.mantissas.push_back(mantissa);
+            chunk.exponents.push_back(exponent);
+        }
+    }
+    int n;
+    if (!scanner.read_int(n))
+    {
+        chunk.error = "Error getting vertex neighbours" +
+                      where("vertex", index);
+        return false;
+    }
+    if (n < header.options->min_vertex_polygons)
+    {
+        chunk.error = "Invalid number of neighbours around a point (got " +
+                      to_string(n) + ")" + where("vertex", index);
+        return false;
+    }
+    chunk.counts.push_back(n);
+    for (int j = 0; j < n; j++)
+    {
+        int polygon;
+        if (!scanner.read_int(polygon))
+        {
+            chunk.error = "Error getting a vertex's neighbouring polygon" +
+                          where("vertex", index);
+            return false;
+        }
+        if (header.options->check_indices &&
+            (polygon < -1 || polygon >= header.P))
+        {
+            chunk.error = "Invalid polygon index when getting vertex (got " +
+                          to_string(polygon) + ")" + where("vertex", index);
+            return false;
+        }
+        chunk.indices.push_back(polygon);
+    }
+    return true;
+}
+
+bool parse_polygon(Scanner& scanner, const Header& header, int index,
+                   Chunk& chunk)
+{
+    int n;
+    if (!scanner.read_int(n))
+    {
+        chunk.error = "Error getting number of vertices of polygon" +
+                      where("polygon", index);
+        return false;
+    }
+    if (n < 3)
+    {
+        chunk.error = "Invalid number of vertices in polygon (got " +
+                      to_string(n) + ")" + where("polygon", index);
+        return false;
+    }
+    chunk.counts.push_back(n);
+    for (int j = 0; j < 2 * n; j++)
+    {
+        const bool is_vertex = j < n;
+        int value;
+        if (!scanner.read_int(value))
+        {
+            chunk.error = is_vertex
+                ? "Error getting a polygon's vertex"
+                : "Error getting a polygon's neighbouring polygon";
+            chunk.error += where("polygon", index);
+            return false;
+        }
+        if (header.options->check_indices &&
+            (is_vertex ? value < 0 || value >= header.V
+                       : value < -1 || value >= header.P))
+        {
+            chunk.error = is_vertex
+                ? "Invalid vertex index when getting polygon"
+                : "Invalid polygon index when getting polygon";
+            chunk.error += " (got " + to_string(value) + ")" +
+                           where("polygon", index);
+            return false;
+        }
+        chunk.indices.push_back(value);
+    }
+    return true;
+}
+
+// Parses each vertex and polygon from its own line, in chunks. Returns false
+// if any of them are invalid or aren't on exactly one line.
+bool parse_lines(const vector<const char*>& lines, const char* end,
+                 const Header& header, vector<Chunk>& vertex_chunks,
+                 vector<Chunk>& polygon_chunks)
+{
+    const int vertex_parts = (header.V + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    const int polygon_parts = (header.P + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    vertex_chunks.assign(vertex_parts, Chunk());
+    polygon_chunks.assign(polygon_parts, Chunk());
+    vector<char> ok(vertex_parts + polygon_parts, true);
+    parallel_for(vertex_parts + polygon_parts, header.options->threads,
+                 [&](int part)
+    {
+        const bool is_vertex = part < vertex_parts;
+        const int first = (is_vertex ? part : part - vertex_parts) *
+                          CHUNK_SIZE;
+        const int count = min(CHUNK_SIZE,
+                              (is_vertex ? header.V : header.P) - first);
+        Chunk& chunk = is_vertex ? vertex_chunks[part]
+                                 : polygon_chunks[part - vertex_parts];
+        for (int i = first; i < first + count; i++)
+        {
+            const char* line = is_vertex ? lines[i]
+                                         : lines[size_t(header.V) + i];
+            const char* line_end = static_cast<const char*>(
+                memchr(line, '\n', end - line));
+            Scanner scanner = {line, line_end ? line_end : end};
+            const bool parsed = is_vertex
+                ? parse_vertex(scanner, header, i, chunk)
+                : parse_polygon(scanner, header, i, chunk);
+            if (!parsed || !scanner.at_end())
+            {
+                ok[part] = false;
+                return;
+            }
+        }
+    });
+    for (char part_ok : ok)
+    {
+        if (!part_ok)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Copies the chunks into out, in parallel.
+void assemble(const vector<Chunk>& vertex_chunks,
+              const vector<Chunk>& polygon_chunks, int threads, NavMesh& out)
+{
+    const int vertex_parts = vertex_chunks.size();
+    const int polygon_parts = polygon_chunks.size();
+    // Where each chunk goes: its first vertex or polygon, and its first
+    // index in the lists.
+    vector<size_t> first(vertex_parts + polygon_parts + 2, 0);
+    vector<size_t> first_index(vertex_parts + polygon_parts + 2, 0);
+    out.vertex_offsets.assign(1, 0);
+    out.polygon_offsets.assign(1, 0);
+    for (int part = 0; part < vertex_parts + polygon_parts; part++)
+    {
+        const bool is_vertex = part < vertex_parts;
+        const Chunk& chunk = is_vertex ? vertex_chunks[part]
+                                       : polygon_chunks[part - vertex_parts];
+        vector<int>& offsets = is_vertex ? out.vertex_offsets
+                                         : out.polygon_offsets;
+        first[part] = offsets.size() - 1;
+        first_index[part] = offsets.back();
+        for (int n : chunk.counts)
+        {
+            offsets.push_back(offsets.back() + n);
+        }
+    }
+    out.vertex_xy.resize(2 * (out.vertex_offsets.size() - 1));
+    out.vertex_polygons.resize(out.vertex_offsets.back());
+    out.polygon_vertices.resize(out.polygon_offsets.back());
+    out.polygon_neighbours.resize(out.polygon_offsets.back());
+    parallel_for(vertex_parts + polygon_parts, threads, [&](int part)
+    {
+        if (part < vertex_parts)
+        {
+            const Chunk& chunk = vertex_chunks[part];
+            copy(chunk.xy.begin(), chunk.xy.end(),
+                 out.vertex_xy.begin() + 2 * first[part]);
+            copy(chunk.indices.begin(), chunk.indices.end(),
+                 out.vertex_polygons.begin() + first_index[part]);
+            return;
+        }
+        const Chunk& chunk = polygon_chunks[part - vertex_parts];
+        size_t to = first_index[part];
+        size_t from = 0;
+        for (int n : chunk.counts)
+        {
+            copy(&chunk.indices[from], &chunk.indices[from] + n,
+                 &out.polygon_vertices[to]);
+            copy(&chunk.indices[from] + n, &chunk.indices[from] + 2 * n,
+                 &out.polygon_neighbours[to]);
+            to += n;
+            from += 2 * n;
+        }
+    });
+}
+
+// Uses fixed-point if every coordinate can be written exactly with the same
+// number of decimal places, otherwise uses doubles.
+void make_exact(const vector<Chunk>& vertex_chunks, int threads,
+                ExactMesh& out)
+{
+    out.fixed_point = true;
+    out.scale = 0;
+    for (const Chunk& chunk : vertex_chunks)
+    {
+        out.fixed_point = out.fixed_point && chunk.exact;
+        for (size_t i = 0; i < chunk.mantissas.size(); i++)
+        {
+            if (chunk.mantissas[i] != 0 && -chunk.exponents[i] > out.scale)
+            {
+                out.scale = -chunk.exponents[i];
+            }
+        }
+    }
+    out.fixed_point = out.fixed_point && out.scale <= MAX_SCALE;
+    if (out.fixed_point)
+    {
+        out.fixed_xy.resize(out.mesh.vertex_xy.size());
+        vector<char> ok(vertex_chunks.size(), true);
+        parallel_for(vertex_chunks.size(), threads, [&](int part)
+        {
+            const Chunk& chunk = vertex_chunks[part];
+            const size_t first = size_t(part) * CHUNK_SIZE * 2;
+            for (size_t i = 0; i < chunk.mantissas.size() && ok[part]; i++)
+            {
+                ok[part] = to_fixed(chunk.mantissas[i], chunk.exponents[i],
+                                    out.scale, out.fixed_xy[first + i]);
+            }
+        });
+        for (char part_ok : ok)
+        {
+            out.fixed_point = out.fixed_point && part_ok;
+        }
+    }
+    if (!out.fixed_point)
+    {
+        out.scale = 0;
+        out.fixed_xy.clear();
+    }
+}
+
+// Appends x formatted with printf, which is what ostream uses underneath.
+void append_printf(string& text, const char* format, int precision,
+                   double x)
+{
+    char buffer[64];
+    const int size = snprintf(buffer, sizeof(buffer), format, precision, x);
+    if (size < (int) sizeof(buffer))
+    {
+        text.append(buffer, size);
+        return;
+    }
+    // Only huge numbers with fixed need this.
+    const size_t start = text.size();
+    text.resize(start + size + 1);
+    snprintf(&text[start], size + 1, format, precision, x);
+    text.resize(start + size);
+}
+
+}
+
+vector<const char*> find_lines(const char* begin, const char* end,
+                               int threads)
+{
+    const size_t PART_SIZE = 1 << 22;
+    const int parts = (end - begin) / PART_SIZE + 1;
+    vector<vector<const char*>> found(parts);
+    parallel_for(parts, threads, [&](int i)
+    {
+        const char* part_begin = begin + i * PART_SIZE;
+        const char* part_end = min(end, part_begin + PART_SIZE);
+        // Lines belong to the part they start in.
+        const char* line = part_begin;
+        if (i != 0)
+        {
+            line = static_cast<const char*>(
+                memchr(part_begin - 1, '\n', part_end - part_begin + 1));
+            line = line ? line + 1 : part_end;
+        }
+        while (line < part_end)
+        {
+            const char* c = line;
+            while (c != end && *c != '\n' && is_space(*c))
+            {
+                c++;
+            }
+            if (c != end && *c != '\n')
+            {
+                found[i].push_back(line);
+            }
+            const char* newline = static_cast<const char*>(
+                memchr(c, '\n', end - c));
+            line = newline ? newline + 1 : end;
+        }
+    });
+    vector<const char*> lines;
+    for (const vector<const char*>& part : found)
+    {
+        lines.insert(lines.end(), part.begin(), part.end());
+    }
+    return lines;
+}
+
+bool parse_text_mesh(const char* begin, const char* end,
+                     const TextMeshOptions& options, ExactMesh& out,
+                     string& error)
+{
+    Scanner scanner = {begin, end};
+    const char* token;
+    const char* token_end;
+    if (!scanner.token(token, token_end))
+    {
+        error = "Error reading header";
+        return false;
+    }
+    const string header_text(token, token_end);
+    if (header_text != "mesh")
+    {
+        error = "Invalid header (expecting 'mesh', got '" + header_text + "')";
+        return false;
+    }
+    int version;
+    if (!scanner.read_int(version))
+    {
+        error = "Error getting version number";
+        return false;
+    }
+    if (version < options.min_version || version > options.max_version)
+    {
+        string expecting = to_string(options.max_version);
+        if (options.min_version != options.max_version)
+        {
+            expecting = to_string(options.min_version) + " to " + expecting;
+        }
+        error = "Invalid version (expecting " + expecting + ", got " +
+                to_string(version) + ")";
+        return false;
+    }
+    Header header = {0, 0, &options};
+    if (!scanner.read_int(header.V) || !scanner.read_int(header.P))
+    {
+        error = "Error getting V and P";
+        return false;
+    }
+    if (header.V < 1)
+    {
+        error = "Invalid number of vertices (got " + to_string(header.V) +
+                ")";
+        return false;
+    }
+    if (header.P < 1)
+    {
+        error = "Invalid number of polygons (got " + to_string(header.P) +
+                ")";
+        return false;
+    }
+
+    vector<Chunk> vertex_chunks;
+    vector<Chunk> polygon_chunks;
+    const vector<const char*> lines = find_lines(scanner.pos, end,
+                                                 options.threads);
+    if (lines.size() != size_t(header.V) + header.P ||
+        !parse_lines(lines, end, header, vertex_chunks, polygon_chunks))
+    {
+        // Go through it one token at a time instead, which also finds the
+        // first error.
+        vertex_chunks.assign(1, Chunk());
+        polygon_chunks.assign(1, Chunk());
+        for (int i = 0; i < header.V; i++)
+        {
+            if (!parse_vertex(scanner, header, i, vertex_chunks[0]))
+            {
+                error = vertex_chunks[0].error;
+                return false;
+            }
+        }
+        for (int i = 0; i < header.P; i++)
+        {
+            if (!parse_polygon(scanner, header, i, polygon_chunks[0]))
+            {
+                error = polygon_chunks[0].error;
+                return false;
+            }
+        }
+        if (!scanner.at_end())
+        {
+            error = "Error parsing mesh (read too much)";
+            return false;
+        }
+    }
+
+    out = ExactMesh();
+    out.version = version;
+    assemble(vertex_chunks, polygon_chunks, options.threads, out.mesh);
+    if (options.exact)
+    {
+        // The chunks are all CHUNK_SIZE vertices (except the last) if they
+        // were parsed in parallel, or there's just one.
+        make_exact(vertex_chunks, options.threads, out);
+    }
+    else
+    {
+        out.fixed_point = false;
+    }
+    return true;
+}
+
+bool read_text_mesh(const string& filename, const TextMeshOptions& options,
+                    ExactMesh& out, string& error)
+{
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd == -1)
+    {
+        error = "Unable to open file";
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        error = "Unable to open file";
+        return false;
+    }
+    const size_t size = info.st_size;
+    if (size == 0)
+    {
+        ::close(fd);
+        return parse_text_mesh(nullptr, nullptr, options, out, error);
+    }
+    void* data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED)
+    {
+        error = "Unable to mmap file";
+        return false;
+    }
+    const char* bytes = static_cast<const char*>(data);
+    const bool parsed = parse_text_mesh(bytes, bytes + size, options, out,
+                                        error);
+    munmap(data, size);
+    return parsed;
+}
+
+bool read_text_mesh(istream& infile, const TextMeshOptions& options,
+                    ExactMesh& out, string& error)
+{
+    string data;
+    char buffer[1 << 16];
+    while (infile.read(buffer, sizeof(buffer)) || infile.gcount() > 0)
+    {
+        data.append(buffer, infile.gcount());
+    }
+    return parse_text_mesh(data.data(), data.data() + data.size(), options,
+                           out, error);
+}
+
+bool read_numbers(istream& infile, vector<double>& out)
+{
+    string data;
+    char buffer[1 << 16];
+    while (infile.read(buffer, sizeof(buffer)) || infile.gcount() > 0)
+    {
+        data.append(buffer, infile.gcount());
+    }
+    const char* pos = data.c_str();
+    while (true)
+    {
+        char* end;
+        const double x = strtod(pos, &end);
+        if (end == pos)
+        {
+            break;
+        }
+        out.push_back(x);
+        pos = end;
+    }
+    while (*pos == ' ' || *pos == '\t' || *pos == '\n' || *pos == '\r')
+    {
+        pos++;
+    }
+    return *pos == '\0';
+}
+
+void TextBuffer::put_int(long long n)
+{
+    char digits[20];
+    char* pos = digits + sizeof(digits);
+    unsigned long long left = n < 0 ? 0ULL - n : n;
+    do
+    {
+        *--pos = '0' + left % 10;
+        left /= 10;
+    } while (left != 0);
+    if (n < 0)
+    {
+        put('-');
+    }
+    text.append(pos, digits + sizeof(digits));
+}
+
+void TextBuffer::put_double(double x)
+{
+    // %g writes whole numbers below 10^6 without a decimal point, which is
+    // most coordinates. -0 keeps its sign though.
+    if (x == trunc(x) && fabs(x) < 1e6 && !(x == 0 && signbit(x)))
+    {
+        put_int((long long) x);
+        return;
+    }
+    append_printf(text, "%.*g", 6, x);
+}
+
+void TextBuffer::put_fixed(double x, int precision)
+{
+    append_printf(text, "%.*f", precision, x);
+}
+
+void TextBuffer::put_coordinate(double x)
+{
+    if (x >= INT_MIN && x <= INT_MAX && x == (int) x)
+    {
+        put_int((int) x);
+    }
+    else
+    {
+        put_fixed(x, 10);
+    }
+}
+
+void write_chunks(int n, int threads,
+                  const function<void(int, int, TextBuffer&)>& fn,
+                  ostream& outfile)
+{
+    const int chunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    vector<TextBuffer> buffers(min(chunks, CHUNKS_PER_WRITE));
+    for (int first = 0; first < chunks; first += CHUNKS_PER_WRITE)
+    {
+        const int count = min(CHUNKS_PER_WRITE, chunks - first);
+        parallel_for(count, threads, [&](int i)
+        {
+            const int begin = (first + i) * CHUNK_SIZE;
+            buffers[i].text.clear();
+            fn(begin, min(n, begin + CHUNK_SIZE), buffers[i]);
+        });
+        for (int i = 0; i < count; i++)
+        {
+            outfile.write(buffers[i].text.data(), buffers[i].text.size());
+        }
+    }
+}
+
+void write_text_mesh(const NavMesh& mesh, int version, int threads,
+                     ostream& outfile)
+{
+    TextBuffer header;
+    header.put("mesh\n");
+    header.put_int(version);
+    header.put('\n');
+    header.put_int(mesh.num_vertices());
+    header.put(' ');
+    header.put_int(mesh.num_polygons());
+    header.put('\n');
+    outfile << header.text;
+
+    write_chunks(mesh.num_vertices(), threads,
+                 [&](int first, int last, TextBuffer& out)
+    {
+        for (int i = first; i < last; i++)
+        {
+            out.put_coordinate(mesh.vertex_xy[2*i]);
+            out.put(' ');
+            out.put_coordinate(mesh.vertex_xy[2*i+1]);
+            const int start = mesh.vertex_offsets[i];
+            const int end = mesh.vertex_offsets[i+1];
+            out.put(' ');
+            out.put_int(end - start);
+            for (int j = start; j < end; j++)
+            {
+                out.put(' ');
+                out.put_int(mesh.vertex_polygons[j]);
+            }
+            out.put('\n');
+        }
+    }, outfile);
+
+    write_chunks(mesh.num_polygons(), threads,
+                 [&](int first, int last, TextBuffer& out)
+    {
+        for (int i = first; i < last; i++)
+        {
+            const int start = mesh.polygon_offsets[i];
+            const int end = mesh.polygon_offsets[i+1];
+            out.put_int(end - start);
+            for (int j = start; j < end; j++)
+            {
+                out.put(' ');
+                out.put_int(mesh.polygon_vertices[j]);
+            }
+            for (int j = start; j < end; j++)
+            {
+                out.put(' ');
+                out.put_int(mesh.polygon_neighbours[j]);
+            }
+            out.put('\n');
+        }
+    }, outfile);
+}
+
+}
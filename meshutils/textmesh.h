@@ -0,0 +1,104 @@
+#pragma once
+#include "packing.h"
+#include <functional>
+#include <iostream>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Reading and writing text meshes (spec/mesh/2.txt).
+// The file is split into lines first, and if every vertex and polygon is on
+// its own line they are parsed in parallel. Otherwise it is read one token
+// at a time, as the format doesn't care about whitespace.
+
+// What read_text_mesh accepts. The defaults are what meshmerger (and
+// Polyanya) accept.
+struct TextMeshOptions
+{
+    int min_version;
+    int max_version;
+    // The fewest polygons a vertex can have in its list.
+    int min_vertex_polygons;
+    // Whether to work out the exact coordinates (see ExactMesh). Otherwise
+    // the mesh is left as doubles.
+    bool exact;
+    // Threads to parse with, 0 for one per core.
+    int threads;
+    // Whether to check that every vertex and polygon index is in range.
+    // meshcheck turns this off, so check_mesh can report them instead.
+    // Nothing else should read a mesh without it.
+    bool check_indices;
+
+    TextMeshOptions()
+        : min_version(2), max_version(2), min_vertex_polygons(2),
+          exact(false), threads(0), check_indices(true) {}
+};
+
+// Each returns false and sets error (saying what was wrong and where) if the
+// mesh is invalid.
+
+// Parses the mesh in [begin, end).
+bool parse_text_mesh(const char* begin, const char* end,
+                     const TextMeshOptions& options, ExactMesh& out,
+                     string& error);
+// mmaps the file and parses it.
+bool read_text_mesh(const string& filename, const TextMeshOptions& options,
+                    ExactMesh& out, string& error);
+// Reads everything left in infile and parses it.
+bool read_text_mesh(istream& infile, const TextMeshOptions& options,
+                    ExactMesh& out, string& error);
+
+// Reads whitespace separated numbers (like query points) until the end of
+// infile, and appends them to out. Returns false if there is anything else
+// there.
+bool read_numbers(istream& infile, vector<double>& out);
+
+// Finds the start of every line in [begin, end) with something on it, using
+// up to threads threads (0 for one per core).
+vector<const char*> find_lines(const char* begin, const char* end,
+                               int threads);
+
+// Writing text meshes.
+// Records are formatted into buffers on several threads, then written out
+// in order. Numbers come out the same as they would from ostream.
+
+// Text waiting to be written out.
+class TextBuffer
+{
+public:
+    string text;
+
+    void put(char c)
+    {
+        text.push_back(c);
+    }
+    void put(const char* s)
+    {
+        text.append(s);
+    }
+    void put_int(long long n);
+    // The same as ostream << x with the default settings.
+    void put_double(double x);
+    // The same as ostream << fixed << setprecision(precision) << x.
+    void put_fixed(double x, int precision);
+    // Whole numbers as integers, and anything else with 10 decimal places,
+    // like poly2mesh has always done.
+    void put_coordinate(double x);
+};
+
+// Splits records 0 to n-1 into chunks, and calls fn(begin, end, out) on up
+// to threads threads (0 for one per core) to append the text for records
+// begin to end-1 of each chunk to out. The chunks are written to outfile in
+// order.
+void write_chunks(int n, int threads,
+                  const function<void(int, int, TextBuffer&)>& fn,
+                  ostream& outfile);
+
+// Writes the mesh as a text mesh (spec/mesh/2.txt, or 1 if asked for),
+// with put_coordinate for the coordinates.
+void write_text_mesh(const NavMesh& mesh, int version, int threads,
+                     ostream& outfile);
+
+}
@@ -0,0 +1,37 @@
+#include "timing.h"
+#include "stats.h"
+
+namespace meshutils
+{
+
+void PhaseTimes::start(const string& name)
+{
+    stop();
+    phases.push_back(make_pair(name, 0.0));
+    running = true;
+    started = chrono::steady_clock::now();
+}
+
+void PhaseTimes::stop()
+{
+    if (running)
+    {
+        const auto now = chrono::steady_clock::now();
+        const chrono::duration<double> seconds = now - started;
+        phases.back().second = seconds.count();
+        record_phase(phases.back().first, started, now);
+        running = false;
+    }
+}
+
+double PhaseTimes::total() const
+{
+    double seconds = 0;
+    for (const pair<string, double>& phase : phases)
+    {
+        seconds += phase.second;
+    }
+    return seconds;
+}
+
+}
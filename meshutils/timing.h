@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// How long each phase of a conversion took, for benchmarks (convertbench).
+// Conversions which are given one call start() as each phase begins, and
+// stop() after the last. Each phase is also recorded for --stats (see
+// stats.h), if that's on.
+class PhaseTimes
+{
+public:
+    // The name and seconds of each phase, in the order they ran.
+    vector<pair<string, double>> phases;
+
+    PhaseTimes() : running(false) {}
+
+    // Ends the phase which is running, if any, and starts one called name.
+    void start(const string& name);
+    void stop();
+    // The total of every phase.
+    double total() const;
+
+private:
+    chrono::steady_clock::time_point started;
+    bool running;
+};
+
+}
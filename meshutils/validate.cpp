@@ -0,0 +1,461 @@
+#include "validate.h"
+#include "parallel.h"
+#include <algorithm>
+#include <cmath>
+
+namespace meshutils
+{
+
+const char* const CHECK_NAMES[NUM_CHECKS] =
+{
+    "ranges", "convex", "neighbours", "incidence", "rings"
+};
+
+long long MeshCheckReport::total() const
+{
+    long long out = 0;
+    for (int i = 0; i < NUM_CHECKS; i++)
+    {
+        out += violations[i];
+    }
+    return out;
+}
+
+namespace
+{
+
+// Polygons or vertices checked at a time by each thread.
+const int CHUNK_SIZE = 1 << 14;
+// How far clockwise three vertices of a polygon can turn and still count as
+// being in a line, the same as meshmerger allows.
+const double EPSILON = 1e-8;
+
+// What one chunk found.
+struct Found
+{
+    long long violations[NUM_CHECKS];
+    vector<string> messages;
+
+    Found() : violations() {}
+};
+
+// Where x is in [begin, end), or -1.
+int find_index(const int* begin, const int* end, int x)
+{
+    const int* found = find(begin, end, x);
+    return found == end ? -1 : found - begin;
+}
+
+string where(const char* what, int index)
+{
+    return string(what) + " " + to_string(index) + ": ";
+}
+
+string edge(int a, int b)
+{
+    return "(" + to_string(a) + ", " + to_string(b) + ")";
+}
+
+class Checker
+{
+public:
+    Checker(const NavMesh& mesh, int max_messages)
+        : mesh(mesh), max_messages(max_messages) {}
+
+    bool check_sizes(Found& found);
+    void check_polygon_ranges(int p, Found& found);
+    void check_vertex_ranges(int v, Found& found);
+    void check_polygon(int p, Found& found);
+    void check_vertex(int v, vector<int>& scratch, Found& found);
+
+private:
+    const NavMesh& mesh;
+    int max_messages;
+
+    void report(Found& found, MeshCheck check, const string& message)
+    {
+        found.violations[check]++;
+        if ((int) found.messages.size() < max_messages)
+        {
+            found.messages.push_back(message);
+        }
+    }
+
+    double x(int v) const
+    {
+        return mesh.vertex_xy[2*v];
+    }
+    double y(int v) const
+    {
+        return mesh.vertex_xy[2*v+1];
+    }
+
+    bool check_offsets(const vector<int>& offsets, size_t size,
+                       const char* what, Found& found);
+    void check_convex(int p, Found& found);
+    bool check_ring(int v, Found& found);
+};
+
+// The offsets have to be right before anything can be looked up with them.
+bool Checker::check_offsets(const vector<int>& offsets, size_t size,
+                            const char* what, Found& found)
+{
+    if (offsets.empty() || offsets[0] != 0 || offsets.back() != (int) size)
+    {
+        report(found, CHECK_RANGES, string(what) + " offsets don't start at "
+               "0 and end at the size of the list");
+        return false;
+    }
+    for (size_t i = 1; i < offsets.size(); i++)
+    {
+        if (offsets[i] < offsets[i-1])
+        {
+            report(found, CHECK_RANGES, where(what, i - 1) +
+                   "offsets go backwards");
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Checker::check_sizes(Found& found)
+{
+    if (!check_offsets(mesh.vertex_offsets, mesh.vertex_polygons.size(),
+                       "vertex", found) ||
+        !check_offsets(mesh.polygon_offsets, mesh.polygon_vertices.size(),
+                       "polygon", found))
+    {
+        return false;
+    }
+    if (mesh.vertex_xy.size() != 2 * (size_t) mesh.num_vertices() ||
+        mesh.polygon_neighbours.size() != mesh.polygon_vertices.size())
+    {
+        report(found, CHECK_RANGES, "vertex_xy or polygon_neighbours is "
+               "the wrong size");
+        return false;
+    }
+    return true;
+}
+
+void Checker::check_polygon_ranges(int p, Found& found)
+{
+    const int begin = mesh.polygon_offsets[p];
+    const int end = mesh.polygon_offsets[p+1];
+    if (end - begin < 3)
+    {
+        report(found, CHECK_RANGES, where("polygon", p) + "has " +
+               to_string(end - begin) + " vertices");
+        return;
+    }
+    for (int i = begin; i < end; i++)
+    {
+        const int v = mesh.polygon_vertices[i];
+        const int q = mesh.polygon_neighbours[i];
+        if (v < 0 || v >= mesh.num_vertices())
+        {
+            report(found, CHECK_RANGES, where("polygon", p) + "has vertex " +
+                   to_string(v) + ", which doesn't exist");
+        }
+        else if (find_index(&mesh.polygon_vertices[begin],
+                            &mesh.polygon_vertices[i], v) != -1)
+        {
+            report(found, CHECK_RANGES, where("polygon", p) + "has vertex " +
+                   to_string(v) + " more than once");
+        }
+        if (q < -1 || q >= mesh.num_polygons())
+        {
+            report(found, CHECK_RANGES, where("polygon", p) +
+                   "has neighbour " + to_string(q) + ", which doesn't exist");
+        }
+    }
+}
+
+void Checker::check_vertex_ranges(int v, Found& found)
+{
+    for (int i = mesh.vertex_offsets[v]; i < mesh.vertex_offsets[v+1]; i++)
+    {
+        const int q = mesh.vertex_polygons[i];
+        if (q < -1 || q >= mesh.num_polygons())
+        {
+            report(found, CHECK_RANGES, where("vertex", v) + "has polygon " +
+                   to_string(q) + ", which doesn't exist");
+        }
+    }
+}
+
+// Turning left (or going straight) at every vertex isn't quite enough, as
+// a star goes left everywhere but goes around twice. So this also adds up
+// how far it turns, which has to be exactly once around.
+void Checker::check_convex(int p, Found& found)
+{
+    const int begin = mesh.polygon_offsets[p];
+    const int n = mesh.polygon_offsets[p+1] - begin;
+    const int* vertices = &mesh.polygon_vertices[begin];
+    double area = 0;
+    double turned = 0;
+    for (int i = 0; i < n; i++)
+    {
+        const int a = vertices[(i + n - 1) % n];
+        const int b = vertices[i];
+        const int c = vertices[(i + 1) % n];
+        const double abx = x(b) - x(a), aby = y(b) - y(a);
+        const double bcx = x(c) - x(b), bcy = y(c) - y(b);
+        const double cross = abx * bcy - aby * bcx;
+        if (cross < -EPSILON)
+        {
+            report(found, CHECK_CONVEX, where("polygon", p) +
+                   "turns clockwise at vertex " + to_string(b));
+            return;
+        }
+        turned += atan2(cross, abx * bcx + aby * bcy);
+        area += x(a) * y(b) - x(b) * y(a);
+    }
+    if (area <= EPSILON)
+    {
+        report(found, CHECK_CONVEX, where("polygon", p) +
+               "has no area, or goes clockwise");
+    }
+    else if (fabs(turned - 2 * M_PI) > 1e-6)
+    {
+        report(found, CHECK_CONVEX, where("polygon", p) +
+               "goes around " + to_string(turned / (2 * M_PI)) + " times");
+    }
+}
+
+void Checker::check_polygon(int p, Found& found)
+{
+    check_convex(p, found);
+
+    const int begin = mesh.polygon_offsets[p];
+    const int n = mesh.polygon_offsets[p+1] - begin;
+    const int* vertices = &mesh.polygon_vertices[begin];
+    const int* neighbours = &mesh.polygon_neighbours[begin];
+    for (int i = 0; i < n; i++)
+    {
+        // neighbours[i] is across (vertices[i-1], vertices[i]).
+        const int a = vertices[(i + n - 1) % n];
+        const int b = vertices[i];
+        const int q = neighbours[i];
+
+        if (find_index(&mesh.vertex_polygons[mesh.vertex_offsets[b]],
+                       &mesh.vertex_polygons[mesh.vertex_offsets[b+1]],
+                       p) == -1)
+        {
+            report(found, CHECK_INCIDENCE, where("polygon", p) +
+                   "has vertex " + to_string(b) + ", which doesn't have it");
+        }
+
+        if (q == -1)
+        {
+            continue;
+        }
+        if (q == p)
+        {
+            report(found, CHECK_NEIGHBOURS, where("polygon", p) +
+                   "is its own neighbour across " + edge(a, b));
+            continue;
+        }
+        // q should have the same edge the other way around.
+        const int q_begin = mesh.polygon_offsets[q];
+        const int q_n = mesh.polygon_offsets[q+1] - q_begin;
+        const int j = find_index(&mesh.polygon_vertices[q_begin],
+                                 &mesh.polygon_vertices[q_begin + q_n], a);
+        if (j == -1 ||
+            mesh.polygon_vertices[q_begin + (j + q_n - 1) % q_n] != b)
+        {
+            report(found, CHECK_NEIGHBOURS, where("polygon", p) +
+                   "has polygon " + to_string(q) + " across " + edge(a, b) +
+                   ", which doesn't have that edge");
+        }
+        else if (mesh.polygon_neighbours[q_begin + j] != p)
+        {
+            report(found, CHECK_NEIGHBOURS, where("polygon", p) +
+                   "has polygon " + to_string(q) + " across " + edge(a, b) +
+                   ", which has " +
+                   to_string(mesh.polygon_neighbours[q_begin + j]));
+        }
+    }
+}
+
+// Each polygon around v has two edges at v, and the polygons across them
+// should be the ones before and after it in v's list. Which one comes
+// after depends on which way around the list goes, which isn't the same
+// in every mesh (Fade2D's go counterclockwise, and ours go clockwise), so
+// it only has to be the same all the way around.
+// Assumes v has passed the incidence check.
+bool Checker::check_ring(int v, Found& found)
+{
+    const int begin = mesh.vertex_offsets[v];
+    const int d = mesh.vertex_offsets[v+1] - begin;
+    const int* polygons = &mesh.vertex_polygons[begin];
+    // 1 if the polygon after each one is across its edge leaving v, -1 if
+    // it's across its edge coming into v, 0 if we don't know yet.
+    int direction = 0;
+    for (int k = 0; k < d; k++)
+    {
+        const int a = polygons[k];
+        const int b = polygons[(k + 1) % d];
+        if (a == -1 && b == -1)
+        {
+            report(found, CHECK_RINGS, where("vertex", v) +
+                   "has two -1s next to each other");
+            return false;
+        }
+        // Look at it from whichever one is a polygon. Going the other way
+        // around from b, a is across b's edge coming in if we're going
+        // forwards.
+        const int from = a != -1 ? a : b;
+        const int other = a != -1 ? b : a;
+        const int p_begin = mesh.polygon_offsets[from];
+        const int n = mesh.polygon_offsets[from+1] - p_begin;
+        const int j = find_index(&mesh.polygon_vertices[p_begin],
+                                 &mesh.polygon_vertices[p_begin + n], v);
+        const int coming_in = mesh.polygon_neighbours[p_begin + j];
+        const int leaving = mesh.polygon_neighbours[p_begin + (j + 1) % n];
+        bool forwards = other == (a != -1 ? leaving : coming_in);
+        bool backwards = other == (a != -1 ? coming_in : leaving);
+        if (!forwards && !backwards)
+        {
+            report(found, CHECK_RINGS, where("vertex", v) + "has " +
+                   to_string(a) + " next to " + to_string(b) +
+                   ", which don't share an edge there");
+            return false;
+        }
+        if (forwards != backwards)
+        {
+            const int way = forwards ? 1 : -1;
+            if (direction == -way)
+            {
+                report(found, CHECK_RINGS, where("vertex", v) +
+                       "has polygons going both ways around it");
+                return false;
+            }
+            direction = way;
+        }
+    }
+    return true;
+}
+
+void Checker::check_vertex(int v, vector<int>& scratch, Found& found)
+{
+    const int begin = mesh.vertex_offsets[v];
+    const int end = mesh.vertex_offsets[v+1];
+    bool incident = true;
+    scratch.clear();
+    for (int i = begin; i < end; i++)
+    {
+        const int q = mesh.vertex_polygons[i];
+        if (q == -1)
+        {
+            continue;
+        }
+        scratch.push_back(q);
+        const int q_begin = mesh.polygon_offsets[q];
+        if (find_index(&mesh.polygon_vertices[q_begin],
+                       &mesh.polygon_vertices[mesh.polygon_offsets[q+1]],
+                       v) == -1)
+        {
+            report(found, CHECK_INCIDENCE, where("vertex", v) +
+                   "has polygon " + to_string(q) + ", which doesn't have it");
+            incident = false;
+        }
+    }
+    sort(scratch.begin(), scratch.end());
+    for (size_t i = 1; i < scratch.size(); i++)
+    {
+        if (scratch[i] == scratch[i-1])
+        {
+            report(found, CHECK_INCIDENCE, where("vertex", v) +
+                   "has polygon " + to_string(scratch[i]) +
+                   " more than once");
+            incident = false;
+        }
+    }
+    if (incident && end > begin)
+    {
+        check_ring(v, found);
+    }
+}
+
+// Runs check(i, scratch, found) for i from 0 to n-1, in chunks on up to
+// threads threads, and adds what they found to out in order.
+template <typename Check>
+void check_all(int n, int threads, int max_messages, Check check,
+               MeshCheckReport& out)
+{
+    const int chunks = (n + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    vector<Found> found(chunks);
+    parallel_for(chunks, threads, [&](int chunk)
+    {
+        vector<int> scratch;
+        const int end = min(n, (chunk + 1) * CHUNK_SIZE);
+        for (int i = chunk * CHUNK_SIZE; i < end; i++)
+        {
+            check(i, scratch, found[chunk]);
+        }
+    });
+    for (const Found& f : found)
+    {
+        for (int i = 0; i < NUM_CHECKS; i++)
+        {
+            out.violations[i] += f.violations[i];
+        }
+        for (const string& message : f.messages)
+        {
+            if ((int) out.messages.size() < max_messages)
+            {
+                out.messages.push_back(message);
+            }
+        }
+    }
+}
+
+}
+
+bool check_mesh(const NavMesh& mesh, int threads, int max_messages,
+                MeshCheckReport& out)
+{
+    out = MeshCheckReport();
+    fill(out.violations, out.violations + NUM_CHECKS, 0);
+    Checker checker(mesh, max_messages);
+    {
+        Found found;
+        const bool sized = checker.check_sizes(found);
+        out.violations[CHECK_RANGES] += found.violations[CHECK_RANGES];
+        out.messages = found.messages;
+        if (!sized)
+        {
+            return false;
+        }
+    }
+
+    // Everything else looks things up by these, so they go first.
+    check_all(mesh.num_polygons(), threads, max_messages,
+              [&](int p, vector<int>&, Found& found)
+    {
+        checker.check_polygon_ranges(p, found);
+    }, out);
+    check_all(mesh.num_vertices(), threads, max_messages,
+              [&](int v, vector<int>&, Found& found)
+    {
+        checker.check_vertex_ranges(v, found);
+    }, out);
+    if (out.total() > 0)
+    {
+        return false;
+    }
+
+    check_all(mesh.num_polygons(), threads, max_messages,
+              [&](int p, vector<int>&, Found& found)
+    {
+        checker.check_polygon(p, found);
+    }, out);
+    check_all(mesh.num_vertices(), threads, max_messages,
+              [&](int v, vector<int>& scratch, Found& found)
+    {
+        checker.check_vertex(v, scratch, found);
+    }, out);
+    return out.total() == 0;
+}
+
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "navmesh.h"
+#include <string>
+#include <vector>
+
+namespace meshutils
+{
+
+using namespace std;
+
+// Checking that a mesh is what Polyanya (and spec/mesh/2.txt) expects, which
+// is what meshcheck does.
+
+enum MeshCheck
+{
+    // The offsets and sizes agree, every index is in range, and no polygon
+    // has fewer than 3 vertices or the same vertex twice. The other checks
+    // only run if this passes.
+    CHECK_RANGES,
+    // Every polygon goes counterclockwise, is convex (three vertices in a
+    // row can be in a line) and goes around once.
+    CHECK_CONVEX,
+    // If polygon p says q is across edge (a, b), q has an edge (b, a) which
+    // says p is across it.
+    CHECK_NEIGHBOURS,
+    // Every polygon around a vertex has it as a vertex, and every polygon
+    // with the vertex is around it, once.
+    CHECK_INCIDENCE,
+    // The polygons (and -1s) around each vertex go around it in order,
+    // each one sharing an edge with the next, all the same way around, and
+    // with no two -1s next to each other.
+    CHECK_RINGS,
+    NUM_CHECKS
+};
+
+// The name of each check, as meshcheck prints them.
+extern const char* const CHECK_NAMES[NUM_CHECKS];
+
+struct MeshCheckReport
+{
+    // How many problems each check found.
+    long long violations[NUM_CHECKS];
+    // What the first few problems were, and where (in the order they are in
+    // the mesh, polygons first).
+    vector<string> messages;
+
+    long long total() const;
+};
+
+// Checks mesh on up to threads threads (0 for one per core), keeping up to
+// max_messages messages. Returns true if there were no problems.
+bool check_mesh(const NavMesh& mesh, int threads, int max_messages,
+                MeshCheckReport& out);
+
+}
@@ -1,6 +1,10 @@
-#include "polymap.h"
-#include <map>
-#include <iomanip>
+#include "triangulate.h"
+#include "binmesh.h"
+#include "textmesh.h"
+#include "cache.h"
+#include "reorder.h"
+#include "stats.h"
+#include <fstream>
 
 #define FORMAT_VERSION 2
 
@@ -8,156 +12,115 @@
 using namespace std;
 using namespace GEOM_FADE2D;
 
-typedef vector<Point2> Polygon;
-Zone2 *traversable;
-vector<Point2*> vertices;
-vector<Triangle2*> triangles;
-// Fade2D doesn't have a nice "is this triangle in this zone?" function so we
-// will have to make our own. Additionally, Fade2D has its own point index
-// feature, but it doesn't have a triangle index feature.
-// This map will satisfy both of these uses.
-map<Triangle2*, int> triangle_to_index;
+// Output the binary format (spec/mesh/3.txt) instead of text.
+bool binary = false;
+meshutils::CurveOrder curve = meshutils::CURVE_NONE;
 
-Fade_2D dt;
-
-void init()
+void print_usage(const char* name)
 {
-    traversable = fadeutils::create_traversable_zone(cin, dt);
-
-    // Initialise vertices;
-    dt.getVertexPointers(vertices);
-    for (int i = 0; i < (int)vertices.size(); i++)
-    {
-        vertices[i]->setCustomIndex(i);
-    }
-    // Initialise triangles.
-    traversable->getTriangles(triangles);
-    for (int i = 0; i < (int)triangles.size(); i++)
-    {
-        triangle_to_index[triangles[i]] = i;
-    }
+    cerr << "usage: " << name << " [--binary] "
+         << "[--reorder=hilbert|morton] [--cache=FOLDER] "
+         << "[--stats=json] [--chrome-trace=FILE] [mesh file]" << endl;
 }
 
-void print_header()
+int main(int argc, char* argv[])
 {
-    cout << "mesh" << endl;
-    cout << FORMAT_VERSION << endl;
-    // Assume that all the vertices in the triangulation are interesting.
-    cout << vertices.size() << " " << triangles.size() << endl;
-}
-
-void print_vertices()
-{
-    cout << fixed << setprecision(10);
-    for (auto vertex : vertices)
+    string cache_folder;
+    vector<string> options;
+    // Where the mesh goes, if not stdout.
+    string filename;
+    for (int i = 1; i < argc; i++)
     {
-        double x, y;
-        vertex->xy(x, y);
-        if (x == (int) x)
-        {
-            cout << (int) x;
-        }
-        else
-        {
-            cout << x;
-        }
-        cout << " ";
-        if (y == (int) y)
+        const string arg = argv[i];
+        if (meshutils::parse_cache_arg(arg, cache_folder) ||
+            meshutils::parse_stats_arg(arg))
         {
-            cout << (int) y;
+            continue;
         }
-        else
+        if (filename.empty() && arg.compare(0, 2, "--") != 0)
         {
-            cout << y;
+            filename = arg;
+            continue;
         }
-
-        vector<int> neighbours;
-        typedef TriangleAroundVertexIterator TAVI;
-        TAVI start(vertex);
-        bool first = true;
-        for (TAVI it(start); (it != start) || first; ++it)
+        options.push_back(arg);
+        if (arg == "--binary")
         {
-            first = false;
-            Triangle2 *cur_triangle = *it;
-
-            // triangle not in traversable area
-            if (cur_triangle == NULL ||
-                triangle_to_index.count(cur_triangle) == 0)
-            {
-                if (neighbours.empty() || neighbours.back() != -1)
-                {
-                    neighbours.push_back(-1);
-                }
-            }
-            else
-            {
-                neighbours.push_back(triangle_to_index[cur_triangle]);
-            }
+            binary = true;
         }
-
-        // Most -1s should be removed already, but it is possible that
-        // the first AND last element are -1s.
-        assert(!neighbours.empty());
-        if (neighbours.front() == -1 && neighbours.back() == -1)
+        else if (meshutils::parse_reorder_arg(arg, curve))
         {
-            neighbours.pop_back();
+            // That set curve.
         }
-
-        cout << " " << neighbours.size();
-
-        for (auto index : neighbours)
+        else
         {
-            cout << " " << index;
+            print_usage(argv[0]);
+            return 1;
         }
-        cout << endl;
     }
-}
-
-void print_polys()
-{
-    for (auto triangle : triangles)
+    // Fade2D prints its license to stdout before main runs, which would
+    // come before the binary header.
+    if (binary && filename.empty())
+    {
+        cerr << "--binary needs a mesh file, as Fade2D prints its license "
+             << "to stdout" << endl;
+        print_usage(argv[0]);
+        return 1;
+    }
+    ofstream outfile;
+    if (!filename.empty())
     {
-        cout << 3;
-        // Vertices.
-        // Go 0 1 2.
-        const int vertex_index[] = {0, 1, 2};
-        for (int i : vertex_index)
+        outfile.open(filename, ios::binary);
+        if (!outfile.is_open())
         {
-            cout << " " << triangle->getCorner(i)->getCustomIndex();
+            cerr << "Unable to open " << filename << endl;
+            return 1;
         }
-
-        // Triangles.
-        // Go 2 0 1 in version 1, 1 2 0 in version 2.
-        const int triangle_index[] =
-        #if FORMAT_VERSION == 1
-            {2, 0, 1}
-        #else
-            {1, 2, 0}
-        #endif
-        ;
-        for (int i : triangle_index)
+    }
+    ostream& out = filename.empty() ? cout : outfile;
+    // The Fade2D license has already been printed, so it isn't cached. Only
+    // stdout is, so nothing is when the mesh goes to a file.
+    meshutils::ToolCache cache(filename.empty() ? cache_folder : "",
+                               options);
+    if (cache.replay())
+    {
+        return 0;
+    }
+    string error;
+    Fade_2D dt;
+    Zone2* traversable;
+    {
+        meshutils::StatsPhase phase("triangulate");
+        traversable = fadeutils::create_traversable_zone(cache.input(), dt);
+    }
+    meshutils::NavMesh mesh;
+    {
+        meshutils::StatsPhase phase("make mesh");
+        fadeutils::make_mesh(dt, traversable, FORMAT_VERSION, mesh);
+    }
+    {
+        meshutils::StatsPhase phase("reorder");
+        meshutils::reorder_mesh(mesh, curve);
+    }
+    {
+        meshutils::StatsPhase phase("write");
+        if (binary)
         {
-            cout << " ";
-            Triangle2 *cur_triangle = triangle->getOppositeTriangle(i);
-            if (cur_triangle == NULL ||
-                triangle_to_index.count(cur_triangle) == 0)
-            {
-                cout << -1;
-            }
-            else
+            if (!meshutils::write_binary_mesh(mesh, out, error))
             {
-                cout << triangle_to_index[cur_triangle];
+                cerr << error << endl;
+                return 1;
             }
         }
-        cout << endl;
+        else
+        {
+            meshutils::write_text_mesh(mesh, FORMAT_VERSION, 0, out);
+        }
+    }
+    cache.store();
+    if (!meshutils::write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
     }
-}
-
-int main()
-{
-    init();
-    print_header();
-    print_vertices();
-    print_polys();
     return 0;
 }
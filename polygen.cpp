@@ -0,0 +1,103 @@
+// Makes random polymaps (see spec/poly), to test poly2mesh on maps bigger
+// (or with more holes) than the ones we have. See fadeutils/polygen.h for
+// what goes in them.
+// Writes the polymap to the file given. It can't go to stdout, as Fade
+// prints its license there before main runs.
+#include <stdlib.h>
+#include <fstream>
+#include "polygen.h"
+#include "stats.h"
+
+using namespace std;
+
+void print_usage(const char* name)
+{
+    cerr << "usage: " << name << " [--size=X] [--polygons=N] [--nests=N] "
+         << "[--depth=N] [--vertices=N] [--coast=N] [--seed=N] "
+         << "[--stats=json] [--chrome-trace=FILE] <polymap file>" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    fadeutils::PolyGenOptions options;
+    string filename;
+    for (int i = 1; i < argc; i++)
+    {
+        const string arg = argv[i];
+        if (arg.compare(0, 7, "--size=") == 0)
+        {
+            options.size = atof(arg.c_str() + 7);
+        }
+        else if (arg.compare(0, 11, "--polygons=") == 0)
+        {
+            options.polygons = atoi(arg.c_str() + 11);
+        }
+        else if (arg.compare(0, 8, "--nests=") == 0)
+        {
+            options.nests = atoi(arg.c_str() + 8);
+        }
+        else if (arg.compare(0, 8, "--depth=") == 0)
+        {
+            options.depth = atoi(arg.c_str() + 8);
+        }
+        else if (arg.compare(0, 11, "--vertices=") == 0)
+        {
+            options.vertices = atoi(arg.c_str() + 11);
+        }
+        else if (arg.compare(0, 8, "--coast=") == 0)
+        {
+            options.coast = atoi(arg.c_str() + 8);
+        }
+        else if (arg.compare(0, 7, "--seed=") == 0)
+        {
+            options.seed = strtoul(arg.c_str() + 7, nullptr, 10);
+        }
+        else if (meshutils::parse_stats_arg(arg))
+        {
+            // That turned recording on.
+        }
+        else if (filename.empty() && arg.compare(0, 2, "--") != 0)
+        {
+            filename = arg;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (filename.empty())
+    {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (!(options.size > 0) || options.polygons < 0 || options.nests < 0 ||
+        options.depth < 1 || options.vertices < 3 ||
+        (options.coast != 0 && options.coast < fadeutils::MIN_COAST))
+    {
+        cerr << "Invalid options" << endl;
+        return 1;
+    }
+    ofstream outfile(filename);
+    if (!outfile.is_open())
+    {
+        cerr << "Unable to open " << filename << endl;
+        return 1;
+    }
+    meshutils::PolyMap polymap;
+    {
+        meshutils::StatsPhase phase("generate");
+        fadeutils::generate_polymap(options, polymap);
+    }
+    {
+        meshutils::StatsPhase phase("write");
+        meshutils::write_polymap(polymap, outfile);
+    }
+    string error;
+    if (!meshutils::write_stats(argv[0], error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    return 0;
+}
@@ -1,3 +1,5 @@
 #!/bin/bash
+# Set MESH_CACHE to a folder to reuse conversions of maps seen before.
 bin="${0%/*}/../bin"
-$bin/gridmap2poly | $bin/poly2mesh | grep -e "^[^-* ].*"
+cache="${MESH_CACHE:+--cache=$MESH_CACHE}"
+$bin/gridmap2poly $cache | $bin/poly2mesh $cache | grep -e "^[^-* ].*"
@@ -0,0 +1,123 @@
+#!/usr/bin/python3
+# Aggregates Polyanya search traces (like polyanya.trace) into a heatmap of how
+# many search nodes were expanded in each polygon of a mesh.
+# The heatmap can then be given to meshmerger with --profile.
+import math
+import re
+import sys
+
+POPPED = re.compile(r"popped off: root=\(([^,]+), ([^)]+)\); "
+                    r"left=\(([^,]+), ([^)]+)\); right=\(([^,]+), ([^)]+)\)")
+
+# How far past the interval we look for the polygon being expanded.
+EPSILON = 1e-6
+
+
+def read_mesh(fname):
+    with open(fname) as f:
+        tokens = f.read().split()
+    if tokens[0] != "mesh" or tokens[1] != "2":
+        raise Exception("expecting a version 2 mesh")
+    V, P = int(tokens[2]), int(tokens[3])
+    i = 4
+    vertices = []
+    for _ in range(V):
+        x, y, n = float(tokens[i]), float(tokens[i+1]), int(tokens[i+2])
+        vertices.append((x, y))
+        i += 3 + n
+    polygons = []
+    for _ in range(P):
+        n = int(tokens[i])
+        polygons.append([vertices[int(v)] for v in tokens[i+1:i+1+n]])
+        i += 1 + 2*n
+    return polygons
+
+
+def contains(poly, p):
+    n = len(poly)
+    for i in range(n):
+        a, b = poly[i-1], poly[i]
+        if (b[0]-a[0]) * (p[1]-a[1]) - (b[1]-a[1]) * (p[0]-a[0]) < 0:
+            return False
+    return True
+
+
+class Locator:
+    # Buckets each polygon by its bounding box, so we don't have to test every
+    # polygon for every point.
+    def __init__(self, polygons):
+        self.polygons = polygons
+        xs = [p[0] for poly in polygons for p in poly]
+        ys = [p[1] for poly in polygons for p in poly]
+        self.min_x, self.min_y = min(xs), min(ys)
+        self.size = max(max(xs) - self.min_x, max(ys) - self.min_y,
+                        1) / math.sqrt(len(polygons)) + EPSILON
+        self.buckets = {}
+        for index, poly in enumerate(polygons):
+            lo = self.bucket(min(p[0] for p in poly), min(p[1] for p in poly))
+            hi = self.bucket(max(p[0] for p in poly), max(p[1] for p in poly))
+            for bx in range(lo[0], hi[0] + 1):
+                for by in range(lo[1], hi[1] + 1):
+                    self.buckets.setdefault((bx, by), []).append(index)
+
+    def bucket(self, x, y):
+        return (int((x - self.min_x) // self.size),
+                int((y - self.min_y) // self.size))
+
+    def locate(self, p):
+        for index in self.buckets.get(self.bucket(*p), []):
+            if contains(self.polygons[index], p):
+                return index
+        return -1
+
+
+def expanded_point(root, left, right):
+    # The polygon being expanded is on the other side of the interval from the
+    # root. Returns None if the root is on the interval's line.
+    dx, dy = right[0] - left[0], right[1] - left[1]
+    length = math.hypot(dx, dy)
+    mid = ((left[0] + right[0]) / 2, (left[1] + right[1]) / 2)
+    if length == 0:
+        return None
+    nx, ny = -dy / length, dx / length
+    side = nx * (mid[0] - root[0]) + ny * (mid[1] - root[1])
+    if abs(side) < 1e-12:
+        return None
+    if side < 0:
+        nx, ny = -nx, -ny
+    return (mid[0] + nx * EPSILON, mid[1] + ny * EPSILON)
+
+
+def main():
+    if len(sys.argv) < 3:
+        print("usage:", sys.argv[0], "mesh trace [trace ...]")
+        return
+
+    polygons = read_mesh(sys.argv[1])
+    locator = Locator(polygons)
+    heat = [0] * len(polygons)
+    skipped = 0
+    for fname in sys.argv[2:]:
+        with open(fname) as f:
+            for line in f:
+                match = POPPED.search(line)
+                if not match:
+                    continue
+                nums = [float(x) for x in match.groups()]
+                p = expanded_point(nums[0:2], nums[2:4], nums[4:6])
+                index = -1 if p is None else locator.locate(p)
+                if index == -1:
+                    skipped += 1
+                else:
+                    heat[index] += 1
+
+    if skipped:
+        print("skipped", skipped, "expansions", file=sys.stderr)
+    print("heat")
+    print(1)
+    print(len(polygons))
+    for h in heat:
+        print(h)
+
+if __name__ == "__main__":
+    main()